@@ -22,11 +22,15 @@
  * - target discovery: app + tools/<name>
  * - list targets: tack list
  * - robust process execution (no system() for builds)
- * - parallel compilation: -j N
+ * - parallel compilation: -j N|auto, GNU make jobserver client/server
  * - strict mode: --strict enables -Wunsupported (default suppresses it)
  *
  * Env:
  *   TACK_CC: override compiler (default "tcc")
+ *   TACK_JOBS: default for -j (N or auto)
+ *   TACK_CACHE=1, TACK_CACHE_DIR, TACK_CACHE_SIZE: local object cache (see --cache)
+ *   TACK_REMOTE_CACHE=URL, TACK_REMOTE_CACHE_MODE=read|write: shared HTTP cache behind it
+ *   TACK_DIST_HOSTS="host[/slots] ...": distributed compile over ssh (tack worker)
  *
  * Quickstart (Windows):
  *   tcc -run src/tack.c init
@@ -36,18 +40,27 @@
  *   tcc -run src/tack.c build release --target tool:foo
  */
 
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE /* glibc: keep POSIX/BSD declarations (kill, d_type) under -std=c89 */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #ifdef _WIN32
   #include <windows.h>
   #include <direct.h>
   #include <process.h>
+  #include <io.h>
+  #include <fcntl.h>
+  #include <sys/utime.h>
   #define PATH_SEP '\\'
   #define STAT_FN _stat
   #define STAT_ST struct _stat
@@ -55,6 +68,20 @@
   #include <dirent.h>
   #include <unistd.h>
   #include <sys/wait.h>
+  #include <sys/time.h>
+  #include <sys/resource.h>
+  #include <fcntl.h>
+  #include <utime.h>
+  #include <signal.h>
+  #include <poll.h>
+  /* posix_spawnp unless built with -DTACK_USE_FORK (or the platform lacks it) */
+  #if defined(_POSIX_SPAWN) && _POSIX_SPAWN > 0 && !defined(TACK_USE_FORK)
+    #include <spawn.h>
+    #define TACK_POSIX_SPAWN 1
+  #endif
+  #ifdef __linux__
+    #include <sys/inotify.h>
+  #endif
   #define PATH_SEP '/'
   #define STAT_FN stat
   #define STAT_ST struct stat
@@ -93,11 +120,22 @@ static int g_no_config = 0;
 static int g_no_code_config = 0; /* ignore tackfile.c but still load INI */
 static const char *g_config_path_cli = 0;
 static int g_no_auto_tools_cli = 0;
+static int g_hash_deps = 0; /* --hash-deps: compare dep contents instead of mtimes */
+static int g_direct_cli = 0; /* --direct: same as [project] direct = yes */
 
 static int g_config_loaded = 0;
 static char g_config_path[TACK_MAX_CONFIG_PATH + 1] = {0};
 static char *g_config_default_target = 0; /* owned; freed at exit */
 static int g_config_disable_auto_tools = 0;
+static int g_config_core_archive = 0; /* [project] core_archive: link core via libcore.a */
+static char *g_config_core_pch = 0;  /* [project] core_pch: precompiled header for core (owned) */
+static char *g_config_test_env = 0;  /* [project] test_env: env vars test results depend on (owned) */
+static char *g_config_test_data = 0; /* [project] test_data: files/dirs tests read (owned) */
+static char *g_config_pgo_train = 0; /* [project] pgo_train: release-pgo training command (owned, required) */
+static char *g_config_linker = 0; /* [project] linker: mold|lld|gold|bfd via -fuse-ld= (owned) */
+static int g_config_split_dwarf = 0; /* [project] split_dwarf: -gsplit-dwarf in debug builds */
+static int g_config_direct = 0; /* [project] direct: tcc single-invocation builds when cheaper */
+static int g_config_compdb = 0; /* [project] compdb: keep build/compile_commands.json current */
 
 static const char *g_cc_default = "tcc";
 static const char *g_build_dir  = "build";
@@ -132,9 +170,13 @@ static const char *g_warn_flags_base[] = {
 /* Optional strict: re-enable unsupported warnings */
 static const char *g_warn_flags_strict_add[] = { "-Wunsupported", 0 };
 
-/* Profiles */
-typedef enum { PROF_DEBUG = 0, PROF_RELEASE = 1 } Profile;
-static const char *profile_name(Profile p) { return (p == PROF_RELEASE) ? "release" : "debug"; }
+/* Profiles. release-lto adds link-time optimization; release-pgo first builds the
+ * instrumented release-pgo-gen, trains it and then compiles with the profile. */
+typedef enum {
+  PROF_DEBUG = 0, PROF_RELEASE = 1, PROF_RELEASE_LTO = 2, PROF_RELEASE_PGO = 3, PROF_PGO_GEN = 4
+} Profile;
+static const char * const profile_names[] = { "debug", "release", "release-lto", "release-pgo", "release-pgo-gen" };
+static const char *profile_name(Profile p) { return profile_names[p]; }
 
 /* Depfiles */
 #define USE_DEPFILES 1
@@ -162,6 +204,76 @@ static char *xstrdup(const char *s) {
   return p;
 }
 
+/* --------------------------- arenas --------------------------- */
+
+/* Bump allocation for phase-scoped data: the config (INI tokens, snapshot lists),
+ * the scan (subdir paths) and one build plan (job argv, labels, -D strings).
+ * Nothing inside is freed on its own; the phase drops it with arena_reset/arena_free. */
+#define TACK_ARENA_BLOCK 16384
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t used, cap;
+} ArenaBlock;
+
+typedef struct {
+  ArenaBlock *head;  /* block being filled; oversized requests sit behind it */
+} Arena;
+
+static void arena_init(Arena *a) { a->head = 0; }
+
+static void *arena_alloc(Arena *a, size_t n) {
+  ArenaBlock *b = a->head;
+  char *p;
+
+  n = (n + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if (n > TACK_ARENA_BLOCK / 4) {
+    /* own block, linked behind the current one so its free space stays usable */
+    b = (ArenaBlock*)xmalloc(sizeof(ArenaBlock) + n);
+    b->used = n; b->cap = n;
+    if (a->head) { b->next = a->head->next; a->head->next = b; }
+    else { b->next = 0; a->head = b; }
+    return b + 1;
+  }
+  if (!b || b->cap - b->used < n) {
+    b = (ArenaBlock*)xmalloc(sizeof(ArenaBlock) + TACK_ARENA_BLOCK);
+    b->used = 0; b->cap = TACK_ARENA_BLOCK;
+    b->next = a->head;
+    a->head = b;
+  }
+  p = (char*)(b + 1) + b->used;
+  b->used += n;
+  return p;
+}
+
+static char *arena_strndup(Arena *a, const char *s, size_t n) {
+  char *p = (char*)arena_alloc(a, n + 1);
+  memcpy(p, s, n);
+  p[n] = '\0';
+  return p;
+}
+
+static char *arena_strdup(Arena *a, const char *s) { return arena_strndup(a, s, strlen(s)); }
+
+/* forget everything but keep one regular block for the next round */
+static void arena_reset(Arena *a) {
+  ArenaBlock *b = a->head, *keep = 0;
+  while (b) {
+    ArenaBlock *next = b->next;
+    if (!keep && b->cap == TACK_ARENA_BLOCK) keep = b;
+    else free(b);
+    b = next;
+  }
+  if (keep) { keep->used = 0; keep->next = 0; }
+  a->head = keep;
+}
+
+static void arena_free(Arena *a) {
+  arena_reset(a);
+  free(a->head);
+  a->head = 0;
+}
+
 /* --------------------------- safe strings (fail-fast) --------------------------- */
 
 static void tack_die(const char *msg) {
@@ -259,10 +371,163 @@ static int file_exists(const char *path) {
   return STAT_FN(path, &st) == 0;
 }
 
+/* --------------------------- stat cache --------------------------- */
+/* Hashed path -> (mtime, size) cache: every path is stat'ed at most once per run, no
+ * matter how many objects include it. Outputs written by jobs are forgotten when the
+ * job finishes (stat_cache_forget), so later checks see fresh values.
+ */
+
+typedef struct {
+  char *path;          /* owned; 0 = empty slot */
+  unsigned long hash;
+  long mtime;          /* -1 = missing */
+  long size;
+} StatEntry;
+
+typedef struct {
+  StatEntry *items;
+  unsigned long cap;   /* power of two */
+  unsigned long count;
+} StatCache;
+
+static StatCache g_stat_cache;
+
+/* 32-bit FNV-1a (kept in unsigned long for C89; masked for 64-bit longs) */
+static unsigned long tack_fnv1a(const void *data, size_t n, unsigned long h) {
+  const unsigned char *p = (const unsigned char*)data;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    h ^= (unsigned long)p[i];
+    h = (h * 16777619UL) & 0xffffffffUL;
+  }
+  return h;
+}
+
+static unsigned long tack_hash_str(const char *s) {
+  return tack_fnv1a(s, strlen(s), 2166136261UL);
+}
+
+/* 64-bit signature as two independent 32-bit lanes (C89 has no 64-bit integer type):
+ * lane a = FNV-1a, lane b = multiply/xorshift mix */
+typedef struct { unsigned long a, b; } Hash64;
+
+static void h64_init(Hash64 *h) { h->a = 2166136261UL; h->b = 0x9747b28cUL; }
+
+static void h64_update(Hash64 *h, const void *data, size_t n) {
+  const unsigned char *p = (const unsigned char*)data;
+  size_t i;
+  unsigned long a = h->a, b = h->b;
+  for (i = 0; i < n; i++) {
+    a = ((a ^ (unsigned long)p[i]) * 16777619UL) & 0xffffffffUL;
+    b = ((b ^ (unsigned long)p[i]) * 0x5bd1e995UL) & 0xffffffffUL;
+    b ^= b >> 13;
+  }
+  h->a = a; h->b = b;
+}
+
+/* continue h with argv (a shared prefix hashed once, then each tail) */
+static void h64_argv_update(Hash64 *h, char **argv) {
+  int i;
+  for (i = 0; argv[i]; i++) h64_update(h, argv[i], strlen(argv[i]) + 1);
+}
+
+/* hash a 0-terminated argv (each arg followed by a NUL separator) */
+static void h64_argv(Hash64 *h, char **argv) {
+  h64_init(h);
+  h64_argv_update(h, argv);
+}
+
+static StatEntry *stat_cache_slot(const char *path, unsigned long h) {
+  unsigned long i = h & (g_stat_cache.cap - 1);
+  for (;;) {
+    StatEntry *e = &g_stat_cache.items[i];
+    if (!e->path) return e;
+    if (e->hash == h && streq(e->path, path)) return e;
+    i = (i + 1) & (g_stat_cache.cap - 1);
+  }
+}
+
+static void stat_cache_grow(void) {
+  StatEntry *old = g_stat_cache.items;
+  unsigned long oldcap = g_stat_cache.cap, i;
+  unsigned long ncap = oldcap ? oldcap * 2 : 1024;
+
+  g_stat_cache.items = (StatEntry*)xmalloc((size_t)ncap * sizeof(StatEntry));
+  memset(g_stat_cache.items, 0, (size_t)ncap * sizeof(StatEntry));
+  g_stat_cache.cap = ncap;
+
+  for (i = 0; i < oldcap; i++) {
+    if (old[i].path) *stat_cache_slot(old[i].path, old[i].hash) = old[i];
+  }
+  free(old);
+}
+
+static const StatEntry *stat_cache_get(const char *path) {
+  unsigned long h = tack_hash_str(path);
+  StatEntry *e;
+
+  if ((g_stat_cache.count + 1) * 10 > g_stat_cache.cap * 7) stat_cache_grow();
+
+  e = stat_cache_slot(path, h);
+  if (!e->path) {
+    STAT_ST st;
+    e->path = xstrdup(path);
+    e->hash = h;
+    if (STAT_FN(path, &st) != 0) {
+      e->mtime = -1;
+      e->size = -1;
+    } else {
+      e->mtime = (long)st.st_mtime;
+      e->size = (long)st.st_size;
+    }
+    g_stat_cache.count++;
+  }
+  return e;
+}
+
+/* drop one path (e.g. an output just written by a job) */
+static void stat_cache_forget(const char *path) {
+  unsigned long h, i, j;
+  StatEntry *e;
+
+  if (!g_stat_cache.cap) return;
+  h = tack_hash_str(path);
+  e = stat_cache_slot(path, h);
+  if (!e->path) return;
+
+  free(e->path);
+  e->path = 0;
+  g_stat_cache.count--;
+
+  /* re-insert the rest of the probe run so lookups stay correct */
+  i = (unsigned long)(e - g_stat_cache.items);
+  j = (i + 1) & (g_stat_cache.cap - 1);
+  while (g_stat_cache.items[j].path) {
+    StatEntry moved = g_stat_cache.items[j];
+    g_stat_cache.items[j].path = 0;
+    *stat_cache_slot(moved.path, moved.hash) = moved;
+    j = (j + 1) & (g_stat_cache.cap - 1);
+  }
+}
+
+/* drop everything (watch mode: files changed behind our back) */
+static void stat_cache_clear(void) {
+  unsigned long i;
+  for (i = 0; i < g_stat_cache.cap; i++) free(g_stat_cache.items[i].path);
+  free(g_stat_cache.items);
+  memset(&g_stat_cache, 0, sizeof(g_stat_cache));
+}
+
 static long file_mtime(const char *path) {
-  STAT_ST st;
-  if (STAT_FN(path, &st) != 0) return -1;
-  return (long)st.st_mtime;
+  return stat_cache_get(path)->mtime;
+}
+
+static int g_watch = 0; /* tack watch: long-running, edits can land in an output's second */
+
+/* is an input with mtime t newer than an output with mtime out_t? mtimes have 1 s
+ * resolution; in watch mode the same second counts as newer (rebuild rather than miss) */
+static int mtime_newer(long t, long out_t) {
+  return t > out_t || (g_watch && t == out_t);
 }
 
 static int is_dir_path(const char *path) {
@@ -327,6 +592,37 @@ static void path_join(char *out, size_t cap, const char *a, const char *b) {
   tack_cat(out, cap, b);
 }
 
+/* lexical form for comparing paths: "./src/app/../x.h" -> "src/x.h", '/' separators
+ * (no file system access, symlinks are not resolved) */
+static void path_normalize(char *out, size_t cap, const char *in) {
+  size_t n = 0, keep = 0;
+  const char *p = in;
+
+  if (cap == 0) tack_die("internal error: bad buffer");
+  if (*p == '/' || *p == '\\') { if (cap < 2) tack_die("path too long"); out[n++] = '/'; keep = n; p++; }
+  while (*p) {
+    const char *c = p;
+    size_t len;
+    while (*p && *p != '/' && *p != '\\') p++;
+    len = (size_t)(p - c);
+    if (*p) p++;
+    if (len == 0 || (len == 1 && c[0] == '.')) continue;
+    if (len == 2 && c[0] == '.' && c[1] == '.') {
+      size_t last = n; /* start of the last component */
+      while (last > keep && out[last - 1] != '/') last--;
+      if (n > keep && !(n - last == 2 && out[last] == '.' && out[last + 1] == '.')) {
+        n = last > keep ? last - 1 : keep; /* drop it */
+        continue;
+      }
+    }
+    if (n + (n > keep ? 1 : 0) + len + 1 > cap) tack_die("path too long");
+    if (n > keep) out[n++] = '/';
+    memcpy(out + n, c, len);
+    n += len;
+  }
+  out[n] = '\0';
+}
+
 /* Allocate joined path (supports long paths; caller frees). */
 static char *path_join_alloc(const char *a, const char *b) {
   size_t la, lb, need_sep;
@@ -386,9 +682,11 @@ typedef struct {
   char **items;
   int count;
   int cap;
+  Arena *arena;  /* 0: items are malloc'd; else copies live in the arena and sv_free drops only the array */
 } StrVec;
 
-static void sv_init(StrVec *v) { v->items = 0; v->count = 0; v->cap = 0; }
+static void sv_init(StrVec *v) { v->items = 0; v->count = 0; v->cap = 0; v->arena = 0; }
+static void sv_init_arena(StrVec *v, Arena *a) { sv_init(v); v->arena = a; }
 
 static void sv_push(StrVec *v, const char *s) {
   if (v->count + 1 > v->cap) {
@@ -396,10 +694,16 @@ static void sv_push(StrVec *v, const char *s) {
     v->items = (char**)xrealloc(v->items, (size_t)ncap * sizeof(char*));
     v->cap = ncap;
   }
-  v->items[v->count++] = xstrdup(s);
+  v->items[v->count++] = v->arena ? arena_strdup(v->arena, s) : xstrdup(s);
 }
 
+/* takes s (malloc'd or 0); an arena vector copies it and frees s right away */
 static void sv_push_own(StrVec *v, char *s) {
+  if (v->arena && s) {
+    char *c = arena_strdup(v->arena, s);
+    free(s);
+    s = c;
+  }
   if (v->count + 1 > v->cap) {
     int ncap = v->cap ? v->cap * 2 : 16;
     v->items = (char**)xrealloc(v->items, (size_t)ncap * sizeof(char*));
@@ -408,93 +712,414 @@ static void sv_push_own(StrVec *v, char *s) {
   v->items[v->count++] = s;
 }
 
+/* push a copy of s[0..n) */
+static void sv_push_n(StrVec *v, const char *s, size_t n) {
+  char *c;
+  if (v->arena) {
+    c = arena_strndup(v->arena, s, n);
+  } else {
+    c = (char*)xmalloc(n + 1);
+    memcpy(c, s, n);
+    c[n] = '\0';
+  }
+  sv_push_own(v, 0);
+  v->items[v->count - 1] = c;
+}
 
+/* empties v; an arena vector stays bound to its arena */
 static void sv_free(StrVec *v) {
   int i;
-  for (i = 0; i < v->count; i++) free(v->items[i]);
+  if (!v->arena) for (i = 0; i < v->count; i++) free(v->items[i]);
+  free(v->items);
+  v->items = 0; v->count = 0; v->cap = 0;
+}
+
+typedef struct {
+  int *items;
+  int count;
+  int cap;
+} IntVec;
+
+static void iv_init(IntVec *v) { v->items = 0; v->count = 0; v->cap = 0; }
+
+static void iv_push(IntVec *v, int x) {
+  if (v->count + 1 > v->cap) {
+    int ncap = v->cap ? v->cap * 2 : 16;
+    v->items = (int*)xrealloc(v->items, (size_t)ncap * sizeof(int));
+    v->cap = ncap;
+  }
+  v->items[v->count++] = x;
+}
+
+/* growable string (always 0-terminated once used) */
+typedef struct {
+  char *p;
+  size_t len;
+  size_t cap;
+} StrBuf;
+
+static void sb_init(StrBuf *b) { b->p = 0; b->len = 0; b->cap = 0; }
+static void sb_free(StrBuf *b) { free(b->p); sb_init(b); }
+static void sb_clear(StrBuf *b) { b->len = 0; if (b->p) b->p[0] = '\0'; }
+
+static void sb_putc(StrBuf *b, char c) {
+  if (b->len + 2 > b->cap) {
+    size_t ncap = b->cap ? b->cap * 2 : 256;
+    b->p = (char*)xrealloc(b->p, ncap);
+    b->cap = ncap;
+  }
+  b->p[b->len++] = c;
+  b->p[b->len] = '\0';
+}
+
+static void sb_puts(StrBuf *b, const char *s) { while (*s) sb_putc(b, *s++); }
+
+/* s as a quoted JSON string */
+static void sb_json_str(StrBuf *b, const char *s) {
+  sb_putc(b, '"');
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') { sb_putc(b, '\\'); sb_putc(b, (char)c); }
+    else if (c < 0x20) { char tmp[8]; sprintf(tmp, "\\u%04x", c); sb_puts(b, tmp); }
+    else sb_putc(b, (char)c);
+  }
+  sb_putc(b, '"');
+}
+
+static void iv_free(IntVec *v) {
   free(v->items);
   v->items = 0; v->count = 0; v->cap = 0;
 }
 
 /* --------------------------- recursive scanning --------------------------- */
+/* Directory listings are cached by directory mtime (creating, removing or renaming an
+ * entry changes it): a walk stats each directory once and only re-reads the ones that
+ * changed. Listings verified in this process are reused without any syscall, so the
+ * repeated walks of one invocation (targets, core, tests) cost one pass. The cache
+ * persists in build/.tack_scan:
+ *   "TACKSC\r\n" version ndirs { len path mtime(2) n { len name kind }* }*
+ * A listing read in the same second its directory changed is not trusted on disk
+ * (mtime resolution), it is simply re-read next time.
+ */
 
-static void scan_dir_recursive_suffix_skip_depth(StrVec *out, const char *dir, const char *suffix,
-                                                 const char *skip_dirname, int depth) {
+#define TACK_SCAN_MAGIC   "TACKSC\r\n"
+#define TACK_SCAN_VERSION 1UL
+
+#define SCAN_FILE  0
+#define SCAN_DIR   1   /* real directory: recursed into */
+#define SCAN_SKIP  2   /* symlinked/reparse directory: never followed */
+
+typedef struct {
+  char *path;          /* owned; 0 = empty slot */
+  unsigned long hash;
+  long mtime;          /* directory mtime the listing belongs to */
+  int verified;        /* checked against the directory in this process */
+  int racy;            /* read in the second the directory changed: do not persist */
+  StrVec names;
+  char *kinds;         /* SCAN_* per name */
+} ScanDir;
+
+typedef struct {
+  ScanDir *items;
+  unsigned long cap;   /* power of two */
+  unsigned long count;
+  int loaded;
+  int dirty;
+} ScanCache;
+
+static ScanCache g_scan;
+
+static void db_put_u32(FILE *f, unsigned long v);
+static int db_get_u32(FILE *f, unsigned long *v);
+static void db_put_long(FILE *f, long v);
+static int db_get_long(FILE *f, long *v);
+
+static ScanDir *scan_slot(const char *path, unsigned long h) {
+  unsigned long i = h & (g_scan.cap - 1);
+  for (;;) {
+    ScanDir *e = &g_scan.items[i];
+    if (!e->path) return e;
+    if (e->hash == h && streq(e->path, path)) return e;
+    i = (i + 1) & (g_scan.cap - 1);
+  }
+}
+
+static ScanDir *scan_get(const char *path) {
+  unsigned long h = tack_hash_str(path);
+  ScanDir *e;
+
+  if ((g_scan.count + 1) * 10 > g_scan.cap * 7) {
+    ScanDir *old = g_scan.items;
+    unsigned long oldcap = g_scan.cap, i;
+    unsigned long ncap = oldcap ? oldcap * 2 : 256;
+    g_scan.items = (ScanDir*)xmalloc((size_t)ncap * sizeof(ScanDir));
+    memset(g_scan.items, 0, (size_t)ncap * sizeof(ScanDir));
+    g_scan.cap = ncap;
+    for (i = 0; i < oldcap; i++) {
+      if (old[i].path) *scan_slot(old[i].path, old[i].hash) = old[i];
+    }
+    free(old);
+  }
+
+  e = scan_slot(path, h);
+  if (!e->path) {
+    e->path = xstrdup(path);
+    e->hash = h;
+    e->mtime = -1;
+    sv_init(&e->names);
+    g_scan.count++;
+  }
+  return e;
+}
+
+static void scan_clear_entry(ScanDir *e) {
+  sv_free(&e->names);
+  free(e->kinds);
+  e->kinds = 0;
+}
+
+static void scan_push(ScanDir *e, const char *name, int kind) {
+  sv_push(&e->names, name);
+  e->kinds = (char*)xrealloc(e->kinds, (size_t)e->names.count);
+  e->kinds[e->names.count - 1] = (char)kind;
+}
+
+static void scan_path(char *out, size_t cap) {
+  path_join(out, cap, g_build_dir, ".tack_scan");
+}
+
+static int scan_read(FILE *f) {
+  char magic[8];
+  unsigned long ver, n, i;
+
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TACK_SCAN_MAGIC, 8) != 0) return 1;
+  if (db_get_u32(f, &ver) || ver != TACK_SCAN_VERSION) return 1;
+  if (db_get_u32(f, &n)) return 1;
+  for (i = 0; i < n; i++) {
+    unsigned long len, nn, k;
+    char buf[TACK_MAX_TOKEN + 1];
+    ScanDir *e;
+    long mt;
+    if (db_get_u32(f, &len) || len > TACK_MAX_TOKEN) return 1;
+    if (fread(buf, 1, (size_t)len, f) != (size_t)len) return 1;
+    buf[len] = '\0';
+    if (db_get_long(f, &mt) || db_get_u32(f, &nn)) return 1;
+    e = scan_get(buf);
+    scan_clear_entry(e);
+    e->mtime = mt;
+    for (k = 0; k < nn; k++) {
+      unsigned long kind;
+      if (db_get_u32(f, &len) || len > TACK_MAX_TOKEN) return 1;
+      if (fread(buf, 1, (size_t)len, f) != (size_t)len) return 1;
+      buf[len] = '\0';
+      if (db_get_u32(f, &kind) || kind > SCAN_SKIP) return 1;
+      scan_push(e, buf, (int)kind);
+    }
+  }
+  return 0;
+}
+
+static void scan_reset(void) {
+  unsigned long i;
+  for (i = 0; i < g_scan.cap; i++) {
+    if (!g_scan.items[i].path) continue;
+    free(g_scan.items[i].path);
+    scan_clear_entry(&g_scan.items[i]);
+  }
+  free(g_scan.items);
+  memset(&g_scan, 0, sizeof(g_scan));
+}
+
+/* load build/.tack_scan once; anything unreadable just means "no listings" */
+static void scan_load(void) {
+  char path[1024];
+  FILE *f;
+
+  if (g_scan.loaded) return;
+  g_scan.loaded = 1;
+
+  scan_path(path, sizeof(path));
+  f = fopen(path, "rb");
+  if (!f) return;
+  if (scan_read(f) != 0) {
+    scan_reset();
+    g_scan.loaded = 1;
+  }
+  fclose(f);
+}
+
+/* write build/.tack_scan if a listing changed (never creates build/ on its own) */
+static void scan_save(void) {
+  char path[1024], tmp[1024];
+  FILE *f;
+  unsigned long i, n = 0;
+
+  if (!g_scan.dirty) return;
+  g_scan.dirty = 0;
+  if (!is_dir_path(g_build_dir)) return;
+
+  scan_path(path, sizeof(path));
+  tack_copy(tmp, sizeof(tmp), path);
+  tack_cat(tmp, sizeof(tmp), ".tmp");
+  f = fopen(tmp, "wb");
+  if (!f) return;
+
+  for (i = 0; i < g_scan.cap; i++) {
+    if (g_scan.items[i].path && g_scan.items[i].verified && !g_scan.items[i].racy) n++;
+  }
+
+  fwrite(TACK_SCAN_MAGIC, 1, 8, f);
+  db_put_u32(f, TACK_SCAN_VERSION);
+  db_put_u32(f, n);
+  for (i = 0; i < g_scan.cap; i++) {
+    ScanDir *e = &g_scan.items[i];
+    int k;
+    size_t len;
+    if (!e->path || !e->verified || e->racy) continue;
+    len = strlen(e->path);
+    db_put_u32(f, (unsigned long)len);
+    fwrite(e->path, 1, len, f);
+    db_put_long(f, e->mtime);
+    db_put_u32(f, (unsigned long)e->names.count);
+    for (k = 0; k < e->names.count; k++) {
+      len = strlen(e->names.items[k]);
+      db_put_u32(f, (unsigned long)len);
+      fwrite(e->names.items[k], 1, len, f);
+      db_put_u32(f, (unsigned long)e->kinds[k]);
+    }
+  }
+
+  if (fclose(f) != 0) { remove(tmp); return; }
+#ifdef _WIN32
+  remove(path); /* rename() does not replace on Windows */
+#endif
+  if (rename(tmp, path) != 0) remove(tmp);
+}
+
+/* read dir from disk into e */
+static void scan_read_dir(ScanDir *e, const char *dir) {
 #ifdef _WIN32
   WIN32_FIND_DATAA fd;
   HANDLE h;
   char *pattern;
 
-  if (depth > TACK_MAX_SCAN_DEPTH) tack_die("directory recursion too deep");
-
   pattern = path_join_alloc(dir, "*");
   h = FindFirstFileA(pattern, &fd);
   free(pattern);
   if (h == INVALID_HANDLE_VALUE) return;
 
   do {
-    char *full;
-
+    int kind = SCAN_FILE;
     if (streq(fd.cFileName, ".") || streq(fd.cFileName, "..")) continue;
-
-    if (skip_dirname && (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-      if (streq(fd.cFileName, skip_dirname)) continue;
-      if (streq(fd.cFileName, "build")) continue;
-    }
-
-    /* loop defense: do not recurse into reparse points (junctions/symlinks) */
-    if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
-        (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
-      continue;
-    }
-
-    full = path_join_alloc(dir, fd.cFileName);
-
     if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-      scan_dir_recursive_suffix_skip_depth(out, full, suffix, skip_dirname, depth + 1);
-      free(full);
-    } else {
-      if (ends_with(fd.cFileName, suffix)) {
-        sv_push_own(out, full);
-      } else {
-        free(full);
-      }
+      /* loop defense: do not recurse into reparse points (junctions/symlinks) */
+      kind = (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? SCAN_SKIP : SCAN_DIR;
     }
+    scan_push(e, fd.cFileName, kind);
   } while (FindNextFileA(h, &fd));
 
   FindClose(h);
 #else
   DIR *d;
-  struct dirent *e;
-
-  if (depth > TACK_MAX_SCAN_DEPTH) tack_die("directory recursion too deep");
+  struct dirent *de;
 
   d = opendir(dir);
   if (!d) return;
 
-  while ((e = readdir(d)) != 0) {
-    char *full;
+  while ((de = readdir(d)) != 0) {
+    int kind = -1;
+    if (streq(de->d_name, ".") || streq(de->d_name, "..")) continue;
+#ifdef DT_DIR
+    /* d_type saves the lstat per entry where the filesystem reports it */
+    if (de->d_type == DT_DIR) kind = SCAN_DIR;
+    else if (de->d_type != DT_UNKNOWN) kind = SCAN_FILE; /* symlinks are not followed */
+#endif
+    if (kind < 0) {
+      char *full = path_join_alloc(dir, de->d_name);
+      kind = is_dir_path_nofollow(full) ? SCAN_DIR : SCAN_FILE;
+      free(full);
+    }
+    scan_push(e, de->d_name, kind);
+  }
+  closedir(d);
+#endif
+}
 
-    if (streq(e->d_name, ".") || streq(e->d_name, "..")) continue;
+/* cached listing of dir, 0 if it is not a readable directory */
+static const ScanDir *scan_listing(const char *dir) {
+  ScanDir *e;
+  STAT_ST st;
 
-    if (skip_dirname && streq(e->d_name, skip_dirname)) continue;
-    if (streq(e->d_name, "build")) continue;
+  scan_load();
+  e = scan_get(dir);
+  if (e->verified) return e->mtime < 0 ? 0 : e;
+  e->verified = 1;
 
-    full = path_join_alloc(dir, e->d_name);
+  if (STAT_FN(dir, &st) != 0) {
+    if (e->mtime >= 0) g_scan.dirty = 1;
+    scan_clear_entry(e);
+    e->mtime = -1;
+    return 0;
+  }
+  if (e->mtime == (long)st.st_mtime && !e->racy) return e;
+
+  scan_clear_entry(e);
+  e->mtime = (long)st.st_mtime;
+  e->racy = e->mtime >= (long)time(0) - 1;
+  scan_read_dir(e, dir);
+  g_scan.dirty = 1;
+  return e;
+}
 
-    if (is_dir_path_nofollow(full)) {
-      scan_dir_recursive_suffix_skip_depth(out, full, suffix, skip_dirname, depth + 1);
-      free(full);
-    } else {
-      if (ends_with(e->d_name, suffix)) {
-        sv_push_own(out, full);
-      } else {
-        free(full);
+/* make the next walk re-check dir (0 = every directory) */
+static void scan_unverify(const char *dir) {
+  unsigned long i;
+  if (!g_scan.cap) return;
+  if (dir) {
+    ScanDir *e = scan_slot(dir, tack_hash_str(dir));
+    if (e->path) e->verified = 0;
+    return;
+  }
+  for (i = 0; i < g_scan.cap; i++) g_scan.items[i].verified = 0;
 }
+
+/* subdir paths of the walk in progress; reset once the outermost level returns */
+static Arena g_scan_arena;
+
+static void scan_dir_recursive_suffix_skip_depth(StrVec *out, const char *dir, const char *suffix,
+                                                 const char *skip_dirname, int depth) {
+  const ScanDir *e;
+  StrVec subdirs;
+  char path[4096];
+  int i;
+
+  if (depth > TACK_MAX_SCAN_DEPTH) tack_die("directory recursion too deep");
+
+  e = scan_listing(dir);
+  if (!e) return;
+
+  /* the listing may move when the table grows: collect subdirs before recursing */
+  sv_init_arena(&subdirs, &g_scan_arena);
+  for (i = 0; i < e->names.count; i++) {
+    const char *name = e->names.items[i];
+
+    if (e->kinds[i] == SCAN_SKIP) continue;
+    if (e->kinds[i] == SCAN_DIR) {
+      if (skip_dirname && streq(name, skip_dirname)) continue;
+      if (streq(name, "build")) continue;
+      path_join(path, sizeof(path), dir, name);
+      sv_push(&subdirs, path);
+    } else if (ends_with(name, suffix)) {
+      path_join(path, sizeof(path), dir, name);
+      sv_push(out, path);
     }
   }
-  closedir(d);
-#endif
+
+  for (i = 0; i < subdirs.count; i++) {
+    scan_dir_recursive_suffix_skip_depth(out, subdirs.items[i], suffix, skip_dirname, depth + 1);
+  }
+  sv_free(&subdirs);
+  if (depth == 0) arena_reset(&g_scan_arena);
 }
 
 static void scan_dir_recursive_suffix_skip(StrVec *out, const char *dir, const char *suffix,
@@ -649,6 +1274,36 @@ static int rm_rf_contents(const char *dir) {
   return rm_rf_contents_depth(dir, 0);
 }
 
+/* a fresh, unpredictable directory only this user can enter, under $TMPDIR (POSIX:
+ * mkdtemp, mode 0700; Windows: a new dir in the per-user %TEMP%). Files inside it can be
+ * opened by name without a symlink race. Caller removes it with rm_rf. 0 on success. */
+static int tmp_private_dir(char *out, size_t cap, const char *tag) {
+#ifdef _WIN32
+  char base[MAX_PATH + 1], name[64];
+  DWORD n = GetTempPathA((DWORD)sizeof(base), base);
+  unsigned long tries;
+
+  if (n == 0 || n >= sizeof(base)) return 1;
+  for (tries = 0; tries < 100; tries++) {
+    sprintf(name, "tack-%.16s-%lu-%lu", tag, (unsigned long)GetCurrentProcessId(),
+            (unsigned long)GetTickCount() + tries);
+    path_join(out, cap, base, name);
+    if (_mkdir(out) == 0) return 0;
+    if (errno != EEXIST) return 1;
+  }
+  return 1;
+#else
+  const char *tmp = getenv("TMPDIR");
+  char name[64];
+
+  if (!tmp || !*tmp) tmp = "/tmp";
+  sprintf(name, "tack-%.16s-XXXXXX", tag);
+  if (strlen(tmp) + strlen(name) + 2 > cap) return 1;
+  path_join(out, cap, tmp, name);
+  return mkdtemp(out) ? 0 : 1;
+#endif
+}
+
 /* --------------------------- process execution --------------------------- */
 
 static void print_argv(char **argv) {
@@ -681,57 +1336,713 @@ static void print_argv(char **argv) {
   fputc('\n', stdout);
 }
 
+/* wall clock in ms since the first call (durations only) */
+#ifdef _WIN32
+static long now_ms(void) {
+  static DWORD base;
+  static int inited = 0;
+  if (!inited) { base = GetTickCount(); inited = 1; }
+  return (long)(GetTickCount() - base);
+}
+#else
+static long now_ms(void) {
+  static long base = -1;
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  if (base < 0) base = (long)tv.tv_sec;
+  return ((long)tv.tv_sec - base) * 1000L + (long)(tv.tv_usec / 1000);
+}
+#endif
+
+/* proc_spawn_io: in_path feeds stdin, out_path/err_path take stdout/stderr (truncated;
+ * the same path for both = one file, like 2>&1); 0 = inherit.
+ * proc_spawn_nowait: log_path = 0 inherits both, else both go to that file. */
 #ifdef _WIN32
-typedef struct { intptr_t pid; } Proc;
-static int proc_spawn_nowait(char **argv, Proc *out) {
-  intptr_t pid = _spawnvp(_P_NOWAIT, argv[0], (const char * const *)argv);
+typedef struct {
+  intptr_t pid;
+  long peak_kb;     /* peak working set in KiB once reaped, 0 = unknown */
+} Proc;
+
+/* PROCESS_MEMORY_COUNTERS, resolved at run time so tack needs no psapi import lib */
+typedef struct {
+  DWORD cb;
+  DWORD PageFaultCount;
+  SIZE_T PeakWorkingSetSize;
+  SIZE_T WorkingSetSize;
+  SIZE_T QuotaPeakPagedPoolUsage;
+  SIZE_T QuotaPagedPoolUsage;
+  SIZE_T QuotaPeakNonPagedPoolUsage;
+  SIZE_T QuotaNonPagedPoolUsage;
+  SIZE_T PagefileUsage;
+  SIZE_T PeakPagefileUsage;
+} TackMemCounters;
+typedef BOOL (WINAPI *TackMemInfoFn)(HANDLE, TackMemCounters*, DWORD);
+
+static long proc_peak_kb(HANDLE h) {
+  static TackMemInfoFn fn = 0;
+  static int tried = 0;
+  TackMemCounters mc;
+  if (!tried) {
+    HMODULE m = GetModuleHandleA("kernel32.dll");
+    tried = 1;
+    if (m) fn = (TackMemInfoFn)GetProcAddress(m, "K32GetProcessMemoryInfo");
+    if (!fn && (m = LoadLibraryA("psapi.dll")) != 0) fn = (TackMemInfoFn)GetProcAddress(m, "GetProcessMemoryInfo");
+  }
+  if (!fn) return 0;
+  memset(&mc, 0, sizeof(mc));
+  mc.cb = (DWORD)sizeof(mc);
+  if (!fn(h, &mc, mc.cb)) return 0;
+  return (long)(mc.PeakWorkingSetSize / 1024);
+}
+
+static int proc_spawn_io(char **argv, const char *in_path, const char *out_path, const char *err_path, Proc *out) {
+  const char *paths[3];
+  int fds[3], saved[3], i, one = err_path && out_path && streq(err_path, out_path);
+  intptr_t pid;
+
+  /* _spawnvp hands our own fds to the child: swap them around the spawn */
+  paths[0] = in_path; paths[1] = out_path; paths[2] = one ? 0 : err_path;
+  fflush(stdout);
+  fflush(stderr);
+  for (i = 0; i < 3; i++) {
+    fds[i] = saved[i] = -1;
+    if (!paths[i]) continue;
+    fds[i] = i == 0 ? _open(paths[i], _O_RDONLY | _O_BINARY)
+                    : _open(paths[i], _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    if (fds[i] < 0) {
+      while (--i >= 0) if (fds[i] >= 0) { _dup2(saved[i], i); _close(saved[i]); _close(fds[i]); }
+      return 1;
+    }
+    saved[i] = _dup(i);
+    _dup2(fds[i], i);
+  }
+  if (one) { saved[2] = _dup(2); _dup2(1, 2); }
+  pid = _spawnvp(_P_NOWAIT, argv[0], (const char * const *)argv);
+  for (i = 0; i < 3; i++) {
+    if (saved[i] < 0) continue;
+    _dup2(saved[i], i);
+    _close(saved[i]);
+    if (fds[i] >= 0) _close(fds[i]);
+  }
   if (pid == -1) return 1;
   out->pid = pid;
+  out->peak_kb = 0;
   return 0;
 }
 static int proc_wait(Proc *p) {
   int status = 0;
-  intptr_t r = _cwait(&status, p->pid, 0);
+  intptr_t r;
+  WaitForSingleObject((HANDLE)p->pid, INFINITE);
+  p->peak_kb = proc_peak_kb((HANDLE)p->pid);
+  r = _cwait(&status, p->pid, 0);
   if (r == -1) return 1;
   return status;
 }
+
+/* watch --run: stop a running child, or see whether it exited (rc, 1 = exited) */
+static void proc_kill(Proc *p) {
+  int status;
+  TerminateProcess((HANDLE)p->pid, 1);
+  _cwait(&status, p->pid, 0);
+}
+static int proc_poll(Proc *p, int *rc) {
+  if (WaitForSingleObject((HANDLE)p->pid, 0) != WAIT_OBJECT_0) return 0;
+  *rc = proc_wait(p);
+  return 1;
+}
+#else
+typedef struct {
+  pid_t pid;
+  long peak_kb;     /* peak RSS in KiB once reaped, 0 = unknown */
+} Proc;
+
+static long rusage_peak_kb(const struct rusage *ru) {
+#ifdef __APPLE__
+  return (long)(ru->ru_maxrss / 1024); /* bytes there, KiB elsewhere */
+#else
+  return (long)ru->ru_maxrss;
+#endif
+}
+
+#ifdef TACK_POSIX_SPAWN
+extern char **environ;
+
+/* no page-table copy of tack (build db, stat cache, watch state) per compiler spawn;
+ * the redirections become file actions */
+static int proc_spawn_io(char **argv, const char *in_path, const char *out_path, const char *err_path, Proc *out) {
+  posix_spawn_file_actions_t fa;
+  pid_t pid;
+  int rc = 0;
+
+  fflush(stdout); /* keep our output ordered before the child's */
+  fflush(stderr);
+  if (posix_spawn_file_actions_init(&fa) != 0) return 1;
+  if (in_path) rc = posix_spawn_file_actions_addopen(&fa, 0, in_path, O_RDONLY, 0);
+  if (!rc && out_path) rc = posix_spawn_file_actions_addopen(&fa, 1, out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (!rc && err_path) {
+    rc = (out_path && streq(err_path, out_path)) ? posix_spawn_file_actions_adddup2(&fa, 1, 2)
+       : posix_spawn_file_actions_addopen(&fa, 2, err_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (rc) {
+    posix_spawn_file_actions_destroy(&fa);
+    return 1;
+  }
+  rc = posix_spawnp(&pid, argv[0], &fa, 0, argv, environ);
+  posix_spawn_file_actions_destroy(&fa);
+  if (rc != 0) { errno = rc; return 1; }
+  out->pid = pid;
+  out->peak_kb = 0;
+  return 0;
+}
 #else
-typedef struct { pid_t pid; } Proc;
-static int proc_spawn_nowait(char **argv, Proc *out) {
-  pid_t pid = fork();
+static int proc_spawn_io(char **argv, const char *in_path, const char *out_path, const char *err_path, Proc *out) {
+  pid_t pid;
+  fflush(stdout);
+  fflush(stderr);
+  pid = fork();
   if (pid < 0) return 1;
   if (pid == 0) {
+    int fd;
+    if (in_path) {
+      if ((fd = open(in_path, O_RDONLY)) < 0) _exit(127);
+      dup2(fd, 0);
+      close(fd);
+    }
+    if (out_path) {
+      if ((fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) _exit(127);
+      dup2(fd, 1);
+      close(fd);
+    }
+    if (err_path && out_path && streq(err_path, out_path)) {
+      dup2(1, 2);
+    } else if (err_path) {
+      if ((fd = open(err_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) _exit(127);
+      dup2(fd, 2);
+      close(fd);
+    }
     execvp(argv[0], argv);
     _exit(127);
   }
   out->pid = pid;
+  out->peak_kb = 0;
   return 0;
 }
+#endif
 static int proc_wait(Proc *p) {
   int status = 0;
-  if (waitpid(p->pid, &status, 0) < 0) return 1;
+  struct rusage ru;
+  memset(&ru, 0, sizeof(ru));
+  if (wait4(p->pid, &status, 0, &ru) < 0) return 1;
+  p->peak_kb = rusage_peak_kb(&ru);
   if (WIFEXITED(status)) return WEXITSTATUS(status);
   return 1;
 }
+
+/* watch --run: stop a running child, or see whether it exited (rc, 1 = exited) */
+static void proc_kill(Proc *p) {
+  int status;
+  kill(p->pid, SIGTERM);
+  while (waitpid(p->pid, &status, 0) < 0 && errno == EINTR) { /* retry */ }
+}
+static int proc_poll(Proc *p, int *rc) {
+  int status = 0;
+  if (waitpid(p->pid, &status, WNOHANG) != p->pid) return 0;
+  *rc = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+  return 1;
+}
 #endif
 
-static int run_argv_wait(char **argv, int verbose) {
-  Proc p;
-  if (verbose) print_argv(argv);
-  if (proc_spawn_nowait(argv, &p) != 0) {
-    const char *cmd0 = (argv && argv[0]) ? argv[0] : "(null)";
-    fprintf(stderr, "tack: spawn failed: %s\n", cmd0);
-    fprintf(stderr, "tack: errno: %d (%s)\n", errno, strerror(errno));
-    return 1;
-  }
-  return proc_wait(&p);
+static int proc_spawn_nowait(char **argv, const char *log_path, Proc *out) {
+  return proc_spawn_io(argv, 0, log_path, log_path, out);
 }
 
-/* --------------------------- argv builder --------------------------- */
+/* --------------------------- trace --------------------------- */
+/* --trace FILE: every spawned job (compile, link, archive, test, the tackfile.c
+ * generator) as a Chrome trace "complete" event, for Perfetto or chrome://tracing.
+ * tid = job slot (0 = tack itself), so idle slots show up as gaps. args carry the
+ * target, the output, the exit code and the child's peak RSS. Collection starts with
+ * the process (the generator runs before the command line is parsed) and stops once
+ * the options of a command are known without --trace.
+ */
 
-typedef struct {
-  char **a;
-  int n;
+static StrVec g_trace;               /* JSON event objects */
+static int g_trace_on = 1;
+static int g_trace_slots = 0;        /* highest tid seen */
+static const char *g_trace_path = 0;
+
+static void trace_event(const char *cat, const char *name, const char *target, const char *out,
+                        int tid, long start_ms, long end_ms, int rc, long peak_kb) {
+  StrBuf b;
+  char num[128];
+
+  if (!g_trace_on) return;
+  if (tid > g_trace_slots) g_trace_slots = tid;
+
+  sb_init(&b);
+  sb_puts(&b, "{\"name\":");
+  sb_json_str(&b, name ? name : "");
+  sb_puts(&b, ",\"cat\":");
+  sb_json_str(&b, cat);
+  /* ts/dur in microseconds; double: a long of them overflows after 35 min on Windows */
+  sprintf(num, ",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%d,\"args\":{\"target\":",
+          (double)start_ms * 1000.0, (double)(end_ms - start_ms) * 1000.0, tid);
+  sb_puts(&b, num);
+  sb_json_str(&b, target ? target : "");
+  sb_puts(&b, ",\"out\":");
+  sb_json_str(&b, out ? out : "");
+  sprintf(num, ",\"rc\":%d,\"peak_rss_kb\":%ld}}", rc, peak_kb);
+  sb_puts(&b, num);
+  sv_push_own(&g_trace, b.p);
+}
+
+static void trace_reset(void) {
+  sv_free(&g_trace);
+  g_trace_slots = 0;
+}
+
+/* write everything recorded so far (atexit with --trace, and after each watch build) */
+static void trace_flush(void) {
+  FILE *f;
+  int i;
+
+  if (!g_trace_path) return;
+  f = fopen(g_trace_path, "wb");
+  if (!f) { fprintf(stderr, "tack: warning: cannot write %s\n", g_trace_path); return; }
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+  fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tack\"}},\n", f);
+  fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tack\"}}", f);
+  for (i = 1; i <= g_trace_slots; i++) {
+    fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"slot %d\"}}", i, i);
+  }
+  for (i = 0; i < g_trace.count; i++) {
+    fputs(",\n", f);
+    fputs(g_trace.items[i], f);
+  }
+  fputs("\n]}\n", f);
+  fclose(f);
+}
+
+/* --------------------------- run stats --------------------------- */
+/* TACK_STATS=FILE (set by tack bench): at exit, "key value" pairs on one line
+ *   wall_ms       since startup
+ *   idle_ms       time without any child running: tack's own share (config, scan,
+ *                 dep checks, scheduling, db writes)
+ *   jobs jobs_ms  children spawned and their summed wall time
+ *   self_cpu_ms child_cpu_ms  user+sys of tack and of all reaped children
+ */
+
+static struct {
+  const char *path;
+  long t0;
+  int running;
+  long busy_since;
+  long busy_ms;
+  long jobs;
+  long jobs_ms;
+} g_stats;
+
+static void stats_job_start(void) {
+  if (g_stats.running++ == 0) g_stats.busy_since = now_ms();
+}
+
+static void stats_job_end(long ms) {
+  g_stats.jobs++;
+  g_stats.jobs_ms += ms;
+  if (--g_stats.running == 0) g_stats.busy_ms += now_ms() - g_stats.busy_since;
+}
+
+static void stats_flush(void) {
+  long wall = now_ms() - g_stats.t0, self_ms = 0, child_ms = 0;
+  FILE *f;
+#ifdef _WIN32
+  FILETIME c, e, k, u;
+  if (GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u)) {
+    self_ms = (long)(((((ULONGLONG)k.dwHighDateTime << 32) | k.dwLowDateTime) +
+                      (((ULONGLONG)u.dwHighDateTime << 32) | u.dwLowDateTime)) / 10000);
+  }
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    self_ms = (long)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000L + (long)((ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000);
+  if (getrusage(RUSAGE_CHILDREN, &ru) == 0)
+    child_ms = (long)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000L + (long)((ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000);
+#endif
+  f = fopen(g_stats.path, "w");
+  if (!f) return;
+  fprintf(f, "wall_ms %ld idle_ms %ld jobs %ld jobs_ms %ld self_cpu_ms %ld child_cpu_ms %ld\n",
+          wall, wall - g_stats.busy_ms, g_stats.jobs, g_stats.jobs_ms, self_ms, child_ms);
+  fclose(f);
+}
+
+static void stats_init(void) {
+  const char *v = getenv("TACK_STATS");
+  g_stats.t0 = now_ms();
+  if (!v || !*v) return;
+  g_stats.path = v;
+  atexit(stats_flush);
+}
+
+/* --------------------------- job pool --------------------------- */
+/* Completion-order pool for -j N: whichever child exits first is reaped and its slot
+ * is refilled right away, so one slow job never blocks the other slots.
+ * Each slot carries a caller tag (e.g. index of the source being compiled).
+ */
+
+typedef struct {
+  Proc *procs;
+  int *tags;
+  int *busy;
+  int cap;
+  int running;
+  int last_slot;    /* slot reaped by the last pool_wait_any (procs[].peak_kb is valid) */
+  long *started;    /* now_ms at spawn, per slot */
+} JobPool;
+
+static void pool_init(JobPool *jp, int jobs) {
+  int i;
+  if (jobs < 1) jobs = 1;
+#ifdef _WIN32
+  /* WaitForMultipleObjects() handles at most MAXIMUM_WAIT_OBJECTS at once */
+  if (jobs > MAXIMUM_WAIT_OBJECTS) jobs = MAXIMUM_WAIT_OBJECTS;
+#endif
+  jp->procs = (Proc*)xmalloc((size_t)jobs * sizeof(Proc));
+  jp->tags = (int*)xmalloc((size_t)jobs * sizeof(int));
+  jp->busy = (int*)xmalloc((size_t)jobs * sizeof(int));
+  jp->started = (long*)xmalloc((size_t)jobs * sizeof(long));
+  for (i = 0; i < jobs; i++) { jp->tags[i] = -1; jp->busy[i] = 0; jp->started[i] = 0; }
+  jp->cap = jobs;
+  jp->running = 0;
+  jp->last_slot = -1;
+}
+
+static void pool_free(JobPool *jp) {
+  free(jp->procs);
+  free(jp->tags);
+  free(jp->busy);
+  free(jp->started);
+  jp->procs = 0; jp->tags = 0; jp->busy = 0; jp->started = 0;
+  jp->cap = 0; jp->running = 0;
+}
+
+static int pool_full(const JobPool *jp) { return jp->running >= jp->cap; }
+
+/* spawn into a free slot with proc_spawn_io redirections; returns 0 on success
+ * (caller must not call when full) */
+static int pool_spawn_io(JobPool *jp, char **argv, const char *in_path, const char *out_path,
+                         const char *err_path, int tag) {
+  int i;
+  for (i = 0; i < jp->cap; i++) {
+    if (jp->busy[i]) continue;
+    if (proc_spawn_io(argv, in_path, out_path, err_path, &jp->procs[i]) != 0) {
+      const char *cmd0 = (argv && argv[0]) ? argv[0] : "(null)";
+      fprintf(stderr, "tack: spawn failed: %s\n", cmd0);
+      fprintf(stderr, "tack: errno: %d (%s)\n", errno, strerror(errno));
+      return 1;
+    }
+    jp->busy[i] = 1;
+    jp->tags[i] = tag;
+    jp->started[i] = now_ms();
+    jp->running++;
+    stats_job_start();
+    return 0;
+  }
+  tack_die("internal error: job pool full");
+  return 1;
+}
+
+/* log_path: 0 = inherit, else stdout and stderr go to that file */
+static int pool_spawn(JobPool *jp, char **argv, const char *log_path, int tag) {
+  return pool_spawn_io(jp, argv, 0, log_path, log_path, tag);
+}
+
+/* wait for whichever running job exits first; returns 0 and fills tag/rc, 1 if idle */
+static int pool_wait_any(JobPool *jp, int *out_tag, int *out_rc) {
+  int slot = -1;
+  int rc = 1;
+
+  if (jp->running == 0) return 1;
+
+#ifdef _WIN32
+  {
+    HANDLE hs[MAXIMUM_WAIT_OBJECTS];
+    int map[MAXIMUM_WAIT_OBJECTS];
+    int n = 0, i;
+    DWORD w;
+
+    for (i = 0; i < jp->cap; i++) {
+      if (!jp->busy[i]) continue;
+      hs[n] = (HANDLE)jp->procs[i].pid;
+      map[n] = i;
+      n++;
+    }
+    w = WaitForMultipleObjects((DWORD)n, hs, FALSE, INFINITE);
+    if (w >= WAIT_OBJECT_0 && w < WAIT_OBJECT_0 + (DWORD)n) {
+      slot = map[w - WAIT_OBJECT_0];
+    } else {
+      slot = map[0]; /* wait failed: fall back to a blocking wait in slot order */
+    }
+    rc = proc_wait(&jp->procs[slot]);
+  }
+#else
+  for (;;) {
+    int status = 0;
+    struct rusage ru;
+    pid_t pid;
+    int i;
+    memset(&ru, 0, sizeof(ru));
+    pid = wait4(-1, &status, 0, &ru);
+    if (pid < 0) {
+      if (errno == EINTR) continue;
+      /* no children left: treat all running slots as failed */
+      for (i = 0; i < jp->cap; i++) if (jp->busy[i]) { slot = i; break; }
+      rc = 1;
+      break;
+    }
+    for (i = 0; i < jp->cap; i++) {
+      if (jp->busy[i] && jp->procs[i].pid == pid) { slot = i; break; }
+    }
+    if (slot < 0) continue; /* not one of ours */
+    jp->procs[slot].peak_kb = rusage_peak_kb(&ru);
+    rc = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    break;
+  }
+#endif
+
+  if (out_tag) *out_tag = jp->tags[slot];
+  if (out_rc) *out_rc = rc;
+  jp->last_slot = slot;
+  stats_job_end(now_ms() - jp->started[slot]);
+  jp->busy[slot] = 0;
+  jp->tags[slot] = -1;
+  jp->running--;
+  return 0;
+}
+
+/* --------------------------- jobserver --------------------------- */
+/* GNU make jobserver, both ends.
+ * Client: MAKEFLAGS carries --jobserver-auth=R,W (pipe), fifo:PATH (make 4.4) or, on
+ * Windows, a semaphore name. Every job beyond the first needs a token; tokens are
+ * taken without blocking right before a spawn and handed back as jobs finish. The
+ * pipe is shared with make and other clients, so poll() + read() could block when
+ * someone else wins the byte: reads go through a private O_NONBLOCK descriptor
+ * (/proc/self/fd reopens the pipe; O_NONBLOCK on the shared one would change it for
+ * make too), or else are cut off by a short SIGALRM timer.
+ * Server: -j N > 1 without an outer jobserver creates one holding N - 1 tokens and
+ * exports it via MAKEFLAGS, so recursive make/tack runs (tackfile.c, tests, tools)
+ * share the same N slots instead of adding their own.
+ */
+
+typedef struct {
+  int active;
+  int held;            /* tokens taken, i.e. running jobs beyond the implicit one */
+#ifdef _WIN32
+  HANDLE sem;
+#else
+  int rfd, wfd;
+  int nonblock;        /* rfd is non-blocking: EAGAIN = no token */
+  char *toks;          /* bytes read, returned as read (make checks them) */
+  int cap;
+#endif
+} JobServer;
+
+static JobServer g_js;
+static char g_js_env[1200];  /* MAKEFLAGS=... (putenv keeps the pointer) */
+
+/* value after the last --jobserver-auth= / --jobserver-fds= in MAKEFLAGS, or 0 */
+static const char *js_auth(char *buf, size_t cap) {
+  const char *mf = getenv("MAKEFLAGS"), *p, *v = 0;
+  size_t n;
+  if (!mf) return 0;
+  for (p = mf; (p = strstr(p, "--jobserver-")) != 0; p++) {
+    if (strncmp(p, "--jobserver-auth=", 17) == 0) v = p + 17;
+    else if (strncmp(p, "--jobserver-fds=", 16) == 0) v = p + 16;
+  }
+  if (!v) return 0;
+  n = strcspn(v, " \t");
+  if (!n || n >= cap) return 0;
+  memcpy(buf, v, n);
+  buf[n] = '\0';
+  return buf;
+}
+
+#ifdef _WIN32
+static void js_client_init(void) {
+  char name[512];
+  HANDLE h;
+  if (!js_auth(name, sizeof(name))) return;
+  h = OpenSemaphoreA(SEMAPHORE_MODIFY_STATE | SYNCHRONIZE, FALSE, name);
+  if (!h) return;
+  g_js.sem = h;
+  g_js.active = 1;
+}
+
+static void js_serve(int jobs) {
+  char name[64];
+  HANDLE h;
+  sprintf(name, "tack_js_%lu", (unsigned long)GetCurrentProcessId());
+  h = CreateSemaphoreA(0, jobs - 1, jobs - 1, name);
+  if (!h) return;
+  g_js.sem = h;
+  g_js.active = 1;
+  sprintf(g_js_env, "MAKEFLAGS= -j%d --jobserver-auth=%s", jobs, name);
+  _putenv(g_js_env);
+}
+
+static int js_try_take(void) { return WaitForSingleObject(g_js.sem, 0) == WAIT_OBJECT_0; }
+static void js_put(void) { ReleaseSemaphore(g_js.sem, 1, 0); }
+#else
+/* make only passes the fds to commands it considers recursive: they may be closed or reused */
+static int js_fd_ok(int fd) {
+  STAT_ST st;
+  return fd >= 0 && fcntl(fd, F_GETFD) != -1 && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/* our own non-blocking read end of the pipe behind fd (a new open file description),
+ * or fd itself (blocking) where the platform cannot reopen it */
+static void js_private_rfd(int fd) {
+  g_js.rfd = fd;
+  g_js.nonblock = 0;
+#ifdef __linux__
+  {
+    char path[64];
+    int own;
+    sprintf(path, "/proc/self/fd/%d", fd);
+    own = open(path, O_RDONLY | O_NONBLOCK);
+    if (own < 0) return;
+    fcntl(own, F_SETFD, FD_CLOEXEC);
+    g_js.rfd = own;
+    g_js.nonblock = 1;
+  }
+#endif
+}
+
+static void js_client_init(void) {
+  char auth[1024];
+  if (!js_auth(auth, sizeof(auth))) return;
+  if (strncmp(auth, "fifo:", 5) == 0) {
+    int fd = open(auth + 5, O_RDWR | O_NONBLOCK);
+    if (fd < 0) return;
+    g_js.rfd = g_js.wfd = fd;
+    g_js.nonblock = 1;
+  } else {
+    int r, w;
+    if (sscanf(auth, "%d,%d", &r, &w) != 2 || !js_fd_ok(r) || !js_fd_ok(w)) return;
+    js_private_rfd(r);
+    g_js.wfd = w;
+  }
+  g_js.active = 1;
+}
+
+static void js_serve(int jobs) {
+  int fds[2], i;
+  const char *mf = getenv("MAKEFLAGS");
+  if (pipe(fds) != 0) return;
+  for (i = 0; i < jobs - 1; i++) {
+    if (write(fds[1], "+", 1) != 1) { close(fds[0]); close(fds[1]); return; }
+  }
+  js_private_rfd(fds[0]); /* recursive clients read fds[0] too */
+  g_js.wfd = fds[1];
+  g_js.active = 1;
+  /* make < 4.2 only knows --jobserver-fds */
+  if (mf && strlen(mf) < 512) sprintf(g_js_env, "MAKEFLAGS=%s ", mf);
+  else tack_copy(g_js_env, sizeof(g_js_env), "MAKEFLAGS=");
+  sprintf(g_js_env + strlen(g_js_env), "-j%d --jobserver-fds=%d,%d --jobserver-auth=%d,%d",
+          jobs, fds[0], fds[1], fds[0], fds[1]);
+  putenv(g_js_env);
+}
+
+static void js_alarm(int sig) { (void)sig; }
+
+/* one byte from a blocking rfd: a byte another client takes between poll() and read()
+ * would block us (and our unreaped children) indefinitely, so a 20 ms timer
+ * without SA_RESTART interrupts the read */
+static int js_read_blocking(char *c) {
+  struct pollfd pf;
+  struct sigaction sa, old_sa;
+  struct itimerval it, old_it;
+  int n;
+
+  pf.fd = g_js.rfd;
+  pf.events = POLLIN;
+  pf.revents = 0;
+  if (poll(&pf, 1, 0) != 1 || !(pf.revents & POLLIN)) return 0;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = js_alarm;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sigaction(SIGALRM, &sa, &old_sa);
+  memset(&it, 0, sizeof(it));
+  it.it_value.tv_usec = 20000;
+  setitimer(ITIMER_REAL, &it, &old_it);
+  n = (int)read(g_js.rfd, c, 1);
+  memset(&it, 0, sizeof(it));
+  setitimer(ITIMER_REAL, &it, 0);
+  sigaction(SIGALRM, &old_sa, 0);
+  return n == 1;
+}
+
+static int js_try_take(void) {
+  char c;
+  if (g_js.nonblock) {
+    if (read(g_js.rfd, &c, 1) != 1) return 0; /* EAGAIN: no token right now */
+  } else if (!js_read_blocking(&c)) {
+    return 0;
+  }
+  if (g_js.held + 1 > g_js.cap) {
+    g_js.cap = g_js.cap ? g_js.cap * 2 : 16;
+    g_js.toks = (char*)xrealloc(g_js.toks, (size_t)g_js.cap);
+  }
+  g_js.toks[g_js.held] = c;
+  return 1;
+}
+
+static void js_put(void) {
+  char c = g_js.toks[g_js.held - 1];
+  while (write(g_js.wfd, &c, 1) < 0 && errno == EINTR) { /* retry */ }
+}
+#endif
+
+/* running = jobs already running in this process; 1 = one more may start */
+static int js_take(int running) {
+  if (!g_js.active || running == 0) return 1; /* the implicit token */
+  if (!js_try_take()) return 0;
+  g_js.held++;
+  return 1;
+}
+
+/* a job ended: hand back tokens no longer covered by running jobs */
+static void js_release(int running) {
+  while (g_js.active && g_js.held > 0 && g_js.held > running - 1) {
+    js_put();
+    g_js.held--;
+  }
+}
+
+/* trace_name: record the run as a trace event ("generator" track), 0 = not traced */
+static int run_argv_wait(char **argv, int verbose, const char *trace_name) {
+  Proc p;
+  long t0 = now_ms();
+  int rc;
+  if (verbose) print_argv(argv);
+  if (proc_spawn_nowait(argv, 0, &p) != 0) {
+    const char *cmd0 = (argv && argv[0]) ? argv[0] : "(null)";
+    fprintf(stderr, "tack: spawn failed: %s\n", cmd0);
+    fprintf(stderr, "tack: errno: %d (%s)\n", errno, strerror(errno));
+    return 1;
+  }
+  stats_job_start();
+  rc = proc_wait(&p);
+  stats_job_end(now_ms() - t0);
+  if (trace_name) trace_event("generator", trace_name, 0, 0, 0, t0, now_ms(), rc, p.peak_kb);
+  return rc;
+}
+
+/* --------------------------- argv builder --------------------------- */
+
+typedef struct {
+  char **a;
+  int n;
   int cap;
 } Argv;
 
@@ -759,18 +2070,14 @@ static void av_terminate(Argv *v) {
 
 /* --------------------------- dep parsing --------------------------- */
 
-static int depfile_needs_rebuild(const char *obj_path, const char *dep_path) {
-#if USE_DEPFILES
+/* parse a make-style depfile ("obj: src hdr ...") into prerequisite paths */
+static int depfile_parse(const char *dep_path, StrVec *out) {
   FILE *f;
-  long obj_t;
   int c;
   char tok[2048];
   int ti;
   int seen_colon;
 
-  obj_t = file_mtime(obj_path);
-  if (obj_t < 0) return 1;
-
   f = fopen(dep_path, "rb");
   if (!f) return 1;
 
@@ -798,10 +2105,7 @@ static int depfile_needs_rebuild(const char *obj_path, const char *dep_path) {
       if (ti > 0) {
         tok[ti] = '\0';
         ti = 0;
-        if (seen_colon) {
-          long dt = file_mtime(tok);
-          if (dt < 0 || dt > obj_t) { fclose(f); return 1; }
-        }
+        if (seen_colon) sv_push(out, tok);
       }
       continue;
     }
@@ -811,1661 +2115,6272 @@ static int depfile_needs_rebuild(const char *obj_path, const char *dep_path) {
 
   if (ti > 0 && seen_colon) {
     tok[ti] = '\0';
-    {
-      long dt = file_mtime(tok);
-      if (dt < 0 || dt > obj_t) { fclose(f); return 1; }
-    }
+    sv_push(out, tok);
   }
 
   fclose(f);
-  return 0;
-#else
-  (void)obj_path; (void)dep_path;
-  return 1;
-#endif
+  return seen_colon ? 0 : 1;
 }
 
-static int obj_needs_rebuild(const char *obj_path, const char *src_path, const char *dep_path, int force) {
-  long obj_t, src_t;
-  if (force) return 1;
-  obj_t = file_mtime(obj_path);
-  if (obj_t < 0) return 1;
-  src_t = file_mtime(src_path);
-  if (src_t < 0) return 1;
-  if (src_t > obj_t) return 1;
-#if USE_DEPFILES
-  if (depfile_needs_rebuild(obj_path, dep_path)) return 1;
-#else
-  (void)dep_path;
-#endif
-  return 0;
-}
+/* --------------------------- build database --------------------------- */
+/* build/.tack_db: compact binary build log (in the spirit of .ninja_deps).
+ * Per output it stores the deps (interned path ids), the mtimes seen at last build and
+ * the hash of the command line. It is read once at startup; .d files are only parsed
+ * right after a compile (or once, when an object has no record yet).
+ * With --hash-deps, deps also carry a content hash, and every path keeps its last
+ * (mtime, size, hash) so a file is only re-read when its stat tuple changes. Links and
+ * archives always hash their inputs (objects), so identical objects do not relink.
+ * Each record also keeps the wall time and peak RSS of the job that last produced it
+ * (scheduling, -j auto).
+ *
+ * Layout (little endian u32 words):
+ *   "TACKDB\r\n" version npaths { len bytes mtime(2) size(2) hashed hash(2) }* nrecs
+ *   { out out_mtime(2) cmd(2) ms(2) peak_kb(2) ndeps { path mtime(2) hashed hash(2) }* }*
+ * Versions 2 (no ms, no peak_kb) and 3 (no peak_kb) are still read.
+ */
 
-/* --------------------------- target configuration --------------------------- */
+#define TACK_DB_MAGIC   "TACKDB\r\n"
+#define TACK_DB_VERSION 4UL
 
 typedef struct {
-  const char *name;                 /* matches CLI target name (e.g. "app" or "tool:foo") */
-  const char * const *includes;     /* extra -I dirs */
-  const char * const *defines;      /* extra -D... */
-  const char * const *cflags;       /* extra compile flags */
-  const char * const *ldflags;      /* extra link flags */
-  const char * const *libs;         /* extra libs/flags, e.g. "-lws2_32" */
-  int use_core;                     /* 1 = link src/core into this target */
-} TargetOverride;
+  int path;          /* interned path id */
+  long mtime;        /* mtime seen when recorded */
+  int hashed;        /* hash below is valid (recorded with --hash-deps) */
+  Hash64 hash;       /* content hash when recorded */
+} DbDep;
 
-/* runtime INI overrides (higher priority than tackfile/built-ins) */
-static const TargetOverride *find_ini_override(const char *name);
+typedef struct {
+  long mtime;        /* stat tuple the hash belongs to */
+  long size;
+  int hashed;
+  Hash64 hash;
+} DbFile;
 
 typedef struct {
-  const char *name;      /* CLI name (e.g. "app" or "tool:foo") */
-  const char *src_dir;   /* directory to scan recursively for .c files (upsert if non-0) */
-  const char *bin_base;  /* output executable base name (no extension; upsert if non-0) */
-  const char *id;        /* optional filesystem-safe id (upsert if non-0) */
-  int enabled;           /* action-only: if src_dir/bin_base/id are all 0 -> 0 disable, 1 enable */
-  int remove;            /* action: 1 remove target from graph */
-} TargetDef;
+  int out;           /* interned path id of the output */
+  long out_mtime;    /* output mtime when recorded (stale record if it differs) */
+  Hash64 cmd;        /* hash of the full argv that produced out */
+  long ms;           /* wall time of the job that last produced out, 0 = unknown */
+  long peak_kb;      /* its peak RSS in KiB, 0 = unknown */
+  DbDep *deps;
+  int ndeps;
+} DbRec;
 
-/* Optional external configuration:
- *
- * tack supports two ways to keep project-specific build setup out of tack.c:
- *
- *  A) Runtime tackfile.c (recommended):
- *     - If a file named "tackfile.c" exists in the project root, tack compiles a tiny
- *       generator (with your chosen compiler) and runs it to produce:
- *         build/_tackfile/tackfile.generated.ini
- *     - That generated INI is loaded as a low-priority config layer (below tack.ini / --config).
- *     - If compilation or execution fails, tack exits with an error (fail-fast).
- *
- *  B) Compile-time include (legacy / locked-down environments):
- *     - Build tack with -DTACK_USE_TACKFILE to #include "tackfile.c" directly:
- *         tcc -DTACK_USE_TACKFILE src/tack.c -o tack.exe
- *     - When this mode is enabled, the runtime generator is not used.
- *
- * In tackfile.c you may define:
- *
- *   1) Overrides (includes/defines/cflags/ldflags/libs, core):
- *   #define TACKFILE_OVERRIDES my_overrides
- *      static const TargetOverride my_overrides[] = { ... , { 0,0,0,0,0,0,0 } };
- *
- *   2) Targets (add/modify/disable/remove):
- *      #define TACKFILE_TARGETS my_targets
- *      static const TargetDef my_targets[] = { ... , { 0,0,0,0,0,0 } };
- *
- *   3) Default target:
- *      #define TACKFILE_DEFAULT_TARGET "app"
- *
- *   4) Disable auto tool discovery:
- *      #define TACKFILE_DISABLE_AUTO_TOOLS 1
- *
- * Layering (highest wins):
- *   tack.ini / --config  >  generated tackfile.ini  >  built-ins
- */
+typedef struct {
+  int loaded;
+  int dirty;
+  StrVec paths;      /* id -> path */
+  int *tab;          /* open addressing: id + 1, 0 = empty */
+  int tab_cap;       /* power of two */
+  IntVec rec_of;     /* path id -> record index, -1 = none */
+  DbFile *files;     /* path id -> last known content hash */
+  int cap_files;
+  DbRec *recs;
+  int nrecs;
+  int cap_recs;
+  IntVec *rev;       /* path id -> records listing it as a dep (db_dependents; 0 = not built) */
+  int rev_count;
+} BuildDb;
+
+static BuildDb g_db;
+
+static void db_path(char *out, size_t cap) {
+  path_join(out, cap, g_build_dir, ".tack_db");
+}
 
-#ifdef TACK_USE_TACKFILE
-#include "tackfile.c"
-#endif
+static void db_tab_insert(int id) {
+  unsigned long i = tack_hash_str(g_db.paths.items[id]) & (unsigned long)(g_db.tab_cap - 1);
+  while (g_db.tab[i]) i = (i + 1) & (unsigned long)(g_db.tab_cap - 1);
+  g_db.tab[i] = id + 1;
+}
 
-/* Example overrides (edit as needed) */
-static const char *app_includes[] = { "src", 0 };
-static const char *app_defines[]  = { 0 };
-static const char *app_cflags[]   = { 0 };
-static const char *app_ldflags[]  = { 0 };
-static const char *app_libs[]     = { 0 };
+static int db_find_path(const char *path) {
+  unsigned long i;
+  if (!g_db.tab_cap) return -1;
+  i = tack_hash_str(path) & (unsigned long)(g_db.tab_cap - 1);
+  while (g_db.tab[i]) {
+    int id = g_db.tab[i] - 1;
+    if (streq(g_db.paths.items[id], path)) return id;
+    i = (i + 1) & (unsigned long)(g_db.tab_cap - 1);
+  }
+  return -1;
+}
 
-static const TargetOverride g_overrides[] = {
-  /* app: use shared core by default */
-  { "app", app_includes, app_defines, app_cflags, app_ldflags, app_libs, 1 },
+static int db_intern(const char *path) {
+  int id = db_find_path(path);
+  if (id >= 0) return id;
+
+  if ((g_db.paths.count + 1) * 10 > g_db.tab_cap * 7) {
+    int i, ncap = g_db.tab_cap ? g_db.tab_cap * 2 : 1024;
+    free(g_db.tab);
+    g_db.tab = (int*)xmalloc((size_t)ncap * sizeof(int));
+    memset(g_db.tab, 0, (size_t)ncap * sizeof(int));
+    g_db.tab_cap = ncap;
+    for (i = 0; i < g_db.paths.count; i++) db_tab_insert(i);
+  }
 
-  /* Example tool override (uncomment when you have tools/foo):
-   * static const char *foo_defines[] = { "TOOL_FOO=1", 0 };
-   * { "tool:foo", 0, foo_defines, 0, 0, 0, 1 },
-   */
+  sv_push(&g_db.paths, path);
+  iv_push(&g_db.rec_of, -1);
+  id = g_db.paths.count - 1;
+  db_tab_insert(id);
 
-  { 0, 0, 0, 0, 0, 0, 0 }
-};
+  if (id >= g_db.cap_files) {
+    int ncap = g_db.cap_files ? g_db.cap_files * 2 : 1024;
+    g_db.files = (DbFile*)xrealloc(g_db.files, (size_t)ncap * sizeof(DbFile));
+    g_db.cap_files = ncap;
+  }
+  memset(&g_db.files[id], 0, sizeof(DbFile));
+  return id;
+}
 
-static const TargetOverride *find_override(const char *name) {
+static void db_rev_free(void) {
   int i;
-  {
-    const TargetOverride *io = find_ini_override(name);
-    if (io) return io;
+  for (i = 0; i < g_db.rev_count; i++) iv_free(&g_db.rev[i]);
+  free(g_db.rev);
+  g_db.rev = 0;
+  g_db.rev_count = 0;
+}
+
+/* reverse index: records (indices into g_db.recs) that depend on path id; built on
+ * first use from the ingested deps and dropped whenever a record changes */
+static const IntVec *db_dependents(int id) {
+  if (!g_db.rev) {
+    int i, k;
+    g_db.rev_count = g_db.paths.count;
+    g_db.rev = (IntVec*)xmalloc((size_t)(g_db.rev_count + 1) * sizeof(IntVec));
+    for (i = 0; i < g_db.rev_count; i++) iv_init(&g_db.rev[i]);
+    for (i = 0; i < g_db.nrecs; i++) {
+      for (k = 0; k < g_db.recs[i].ndeps; k++) iv_push(&g_db.rev[g_db.recs[i].deps[k].path], i);
+    }
   }
+  if (id < 0 || id >= g_db.rev_count) return 0;
+  return &g_db.rev[id];
+}
 
-#ifdef TACKFILE_OVERRIDES
-  /* user overrides (from tackfile.c) take precedence */
-  for (i = 0; TACKFILE_OVERRIDES[i].name; i++) {
-    if (streq(TACKFILE_OVERRIDES[i].name, name)) return &TACKFILE_OVERRIDES[i];
-  }
-#endif
+static DbRec *db_find_rec(const char *out) {
+  int id = db_find_path(out);
+  if (id < 0 || g_db.rec_of.items[id] < 0) return 0;
+  return &g_db.recs[g_db.rec_of.items[id]];
+}
 
-  for (i = 0; g_overrides[i].name; i++) {
-    if (streq(g_overrides[i].name, name)) return &g_overrides[i];
+/* get (or create) the record for out, with its dep list reset */
+static DbRec *db_put_rec(const char *out) {
+  int id = db_intern(out);
+  DbRec *r;
+
+  db_rev_free();
+  if (g_db.rec_of.items[id] < 0) {
+    if (g_db.nrecs + 1 > g_db.cap_recs) {
+      int ncap = g_db.cap_recs ? g_db.cap_recs * 2 : 256;
+      g_db.recs = (DbRec*)xrealloc(g_db.recs, (size_t)ncap * sizeof(DbRec));
+      g_db.cap_recs = ncap;
+    }
+    r = &g_db.recs[g_db.nrecs];
+    memset(r, 0, sizeof(*r));
+    r->out = id;
+    g_db.rec_of.items[id] = g_db.nrecs++;
+  } else {
+    r = &g_db.recs[g_db.rec_of.items[id]];
+    free(r->deps);
+    r->deps = 0;
+    r->ndeps = 0;
   }
+  g_db.dirty = 1;
+  return r;
+}
+
+static void db_put_u32(FILE *f, unsigned long v) {
+  unsigned char b[4];
+  b[0] = (unsigned char)(v & 0xff);
+  b[1] = (unsigned char)((v >> 8) & 0xff);
+  b[2] = (unsigned char)((v >> 16) & 0xff);
+  b[3] = (unsigned char)((v >> 24) & 0xff);
+  fwrite(b, 1, 4, f);
+}
+
+static int db_get_u32(FILE *f, unsigned long *v) {
+  unsigned char b[4];
+  if (fread(b, 1, 4, f) != 4) return 1;
+  *v = (unsigned long)b[0] | ((unsigned long)b[1] << 8) | ((unsigned long)b[2] << 16) | ((unsigned long)b[3] << 24);
   return 0;
 }
 
-/* --------------------------- discovered targets --------------------------- */
+/* mtimes as two words; -1 (missing) is all ones */
+static void db_put_long(FILE *f, long v) {
+  if (v < 0) { db_put_u32(f, 0xffffffffUL); db_put_u32(f, 0xffffffffUL); return; }
+  db_put_u32(f, (unsigned long)v & 0xffffffffUL);
+  db_put_u32(f, (((unsigned long)v >> 16) >> 16) & 0xffffffffUL);
+}
 
-typedef struct {
-  char *name;     /* CLI name (may contain ':') */
-  char *id;       /* filesystem-safe id */
-  char *src_dir;  /* directory to scan */
-  char *bin_base; /* output base name */
-  int enabled;    /* 1=active, 0=disabled */
-} Target;
+static int db_get_long(FILE *f, long *v) {
+  unsigned long lo, hi;
+  if (db_get_u32(f, &lo) || db_get_u32(f, &hi)) return 1;
+  if (lo == 0xffffffffUL && hi == 0xffffffffUL) { *v = -1; return 0; }
+  *v = (long)(lo | ((hi << 16) << 16));
+  return 0;
+}
 
-typedef struct {
-  Target *items;
-  int count;
-  int cap;
-} TargetVec;
+/* optional content hash: flag word + two lanes (lanes are 0 when not hashed) */
+static void db_put_hashed(FILE *f, int hashed, const Hash64 *h) {
+  db_put_u32(f, hashed ? 1UL : 0UL);
+  db_put_u32(f, hashed ? h->a : 0UL);
+  db_put_u32(f, hashed ? h->b : 0UL);
+}
 
-static void tv_init(TargetVec *v) { v->items = 0; v->count = 0; v->cap = 0; }
+static int db_get_hashed(FILE *f, int *hashed, Hash64 *h) {
+  unsigned long v;
+  if (db_get_u32(f, &v) || db_get_u32(f, &h->a) || db_get_u32(f, &h->b)) return 1;
+  *hashed = v != 0;
+  return 0;
+}
 
-static void tv_free(TargetVec *v) {
+static int db_get_file(FILE *f, DbFile *df) {
+  if (db_get_long(f, &df->mtime) || db_get_long(f, &df->size)) return 1;
+  return db_get_hashed(f, &df->hashed, &df->hash);
+}
+
+static void db_reset(void) {
   int i;
-  for (i = 0; i < v->count; i++) {
-    free(v->items[i].name);
-    free(v->items[i].id);
-    free(v->items[i].src_dir);
-    free(v->items[i].bin_base);
-  }
-  free(v->items);
-  v->items = 0; v->count = 0; v->cap = 0;
+  db_rev_free();
+  for (i = 0; i < g_db.nrecs; i++) free(g_db.recs[i].deps);
+  free(g_db.recs);
+  free(g_db.files);
+  free(g_db.tab);
+  sv_free(&g_db.paths);
+  iv_free(&g_db.rec_of);
+  memset(&g_db, 0, sizeof(g_db));
 }
 
-static void tv_push(TargetVec *v, const char *name, const char *src_dir, const char *bin_base) {
-  Target *t;
-  char idbuf[256];
+/* read records from an open db file; returns 1 on a format error, 2 on an older version */
+static int db_read(FILE *f) {
+  char magic[8];
+  unsigned long ver, n, i;
+
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TACK_DB_MAGIC, 8) != 0) return 1;
+  if (db_get_u32(f, &ver)) return 1;
+  if (ver != TACK_DB_VERSION && ver != 2UL && ver != 3UL) return 2;
+
+  if (db_get_u32(f, &n)) return 1;
+  for (i = 0; i < n; i++) {
+    unsigned long len;
+    char *s;
+    int id;
+    if (db_get_u32(f, &len) || len > TACK_MAX_TOKEN) return 1;
+    s = (char*)xmalloc((size_t)len + 1);
+    if (fread(s, 1, (size_t)len, f) != (size_t)len) { free(s); return 1; }
+    s[len] = '\0';
+    id = db_intern(s);
+    free(s);
+    if (id != (int)i) return 1; /* duplicate path: corrupt */
+    if (db_get_file(f, &g_db.files[id])) return 1;
+  }
 
-  if (v->count + 1 > v->cap) {
-    int ncap = v->cap ? v->cap * 2 : 8;
-    v->items = (Target*)xrealloc(v->items, (size_t)ncap * sizeof(Target));
-    v->cap = ncap;
+  if (db_get_u32(f, &n)) return 1;
+  for (i = 0; i < n; i++) {
+    unsigned long out, nd, k;
+    DbRec *r;
+    if (db_get_u32(f, &out) || out >= (unsigned long)g_db.paths.count) return 1;
+    r = db_put_rec(g_db.paths.items[out]);
+    if (db_get_long(f, &r->out_mtime)) return 1;
+    if (db_get_u32(f, &r->cmd.a) || db_get_u32(f, &r->cmd.b)) return 1;
+    if (ver >= 3UL && db_get_long(f, &r->ms)) return 1;
+    if (ver >= 4UL && db_get_long(f, &r->peak_kb)) return 1;
+    if (db_get_u32(f, &nd) || nd > (unsigned long)g_db.paths.count) return 1;
+    r->deps = nd ? (DbDep*)xmalloc((size_t)nd * sizeof(DbDep)) : 0;
+    for (k = 0; k < nd; k++) {
+      unsigned long pid;
+      if (db_get_u32(f, &pid) || pid >= (unsigned long)g_db.paths.count) return 1;
+      r->deps[k].path = (int)pid;
+      if (db_get_long(f, &r->deps[k].mtime)) return 1;
+      if (db_get_hashed(f, &r->deps[k].hashed, &r->deps[k].hash)) return 1;
+      r->ndeps++;
+    }
   }
+  return 0;
+}
 
-  sanitize_name_to_id(idbuf, sizeof(idbuf), name);
+/* load build/.tack_db once; a missing or foreign file just means "no records" */
+static void db_load(void) {
+  char path[1024];
+  FILE *f;
+  int rc;
 
-  t = &v->items[v->count++];
-  t->name = xstrdup(name);
-  t->id = xstrdup(idbuf);
-  t->src_dir = xstrdup(src_dir);
-  t->bin_base = xstrdup(bin_base);
-  t->enabled = 1;
-}
+  if (g_db.loaded) return;
+  g_db.loaded = 1;
 
-/* --------------------------- target graph helpers --------------------------- */
-/* Used by tackfile targets (compile-time) and tack.ini targets (runtime). */
+  db_path(path, sizeof(path));
+  f = fopen(path, "rb");
+  if (!f) return;
 
-static int tv_find_index_by_name(TargetVec *v, const char *name) {
-  int i;
-  for (i = 0; i < v->count; i++) {
-    if (streq(v->items[i].name, name)) return i;
+  rc = db_read(f);
+  if (rc != 0) {
+    if (rc == 1) fprintf(stderr, "tack: warning: ignoring unreadable build database %s\n", path);
+    db_reset();
+    g_db.loaded = 1;
   }
-  return -1;
+  fclose(f);
+  g_db.dirty = 0;
 }
 
-static void tv_remove_at(TargetVec *v, int idx) {
-  int i;
-  if (idx < 0 || idx >= v->count) return;
-
-  free(v->items[idx].name);
-  free(v->items[idx].id);
-  free(v->items[idx].src_dir);
-  free(v->items[idx].bin_base);
+/* write build/.tack_db if anything changed (temp file + rename) */
+static void db_save(void) {
+  char path[1024], tmp[1024];
+  FILE *f;
+  int i, k;
 
-  for (i = idx + 1; i < v->count; i++) v->items[i - 1] = v->items[i];
-  v->count--;
-}
+  if (!g_db.loaded || !g_db.dirty) return;
 
-static void tv_update_at_fields(TargetVec *v, int idx, const TargetDef *d) {
-  if (idx < 0 || idx >= v->count) return;
+  db_path(path, sizeof(path));
+  tack_copy(tmp, sizeof(tmp), path);
+  tack_cat(tmp, sizeof(tmp), ".tmp");
 
-  if (d->src_dir) {
-    free(v->items[idx].src_dir);
-    v->items[idx].src_dir = xstrdup(d->src_dir);
-  }
-  if (d->bin_base) {
-    free(v->items[idx].bin_base);
-    v->items[idx].bin_base = xstrdup(d->bin_base);
+  ensure_dir(g_build_dir);
+  f = fopen(tmp, "wb");
+  if (!f) { fprintf(stderr, "tack: warning: cannot write %s\n", tmp); return; }
+
+  fwrite(TACK_DB_MAGIC, 1, 8, f);
+  db_put_u32(f, TACK_DB_VERSION);
+
+  db_put_u32(f, (unsigned long)g_db.paths.count);
+  for (i = 0; i < g_db.paths.count; i++) {
+    size_t len = strlen(g_db.paths.items[i]);
+    db_put_u32(f, (unsigned long)len);
+    fwrite(g_db.paths.items[i], 1, len, f);
+    db_put_long(f, g_db.files[i].mtime);
+    db_put_long(f, g_db.files[i].size);
+    db_put_hashed(f, g_db.files[i].hashed, &g_db.files[i].hash);
   }
-  if (d->id) {
-    free(v->items[idx].id);
-    v->items[idx].id = xstrdup(d->id);
+
+  db_put_u32(f, (unsigned long)g_db.nrecs);
+  for (i = 0; i < g_db.nrecs; i++) {
+    DbRec *r = &g_db.recs[i];
+    db_put_u32(f, (unsigned long)r->out);
+    db_put_long(f, r->out_mtime);
+    db_put_u32(f, r->cmd.a);
+    db_put_u32(f, r->cmd.b);
+    db_put_long(f, r->ms);
+    db_put_long(f, r->peak_kb);
+    db_put_u32(f, (unsigned long)r->ndeps);
+    for (k = 0; k < r->ndeps; k++) {
+      db_put_u32(f, (unsigned long)r->deps[k].path);
+      db_put_long(f, r->deps[k].mtime);
+      db_put_hashed(f, r->deps[k].hashed, &r->deps[k].hash);
+    }
   }
+
+  if (fclose(f) != 0) { remove(tmp); fprintf(stderr, "tack: warning: cannot write %s\n", tmp); return; }
+#ifdef _WIN32
+  remove(path); /* rename() does not replace on Windows */
+#endif
+  if (rename(tmp, path) != 0) { remove(tmp); fprintf(stderr, "tack: warning: cannot write %s\n", path); return; }
+  g_db.dirty = 0;
 }
 
-static void tv_apply_targetdef(TargetVec *v, const TargetDef *d) {
-  int idx;
+/* content hash of path, cached per stat tuple: only re-read when mtime or size changed.
+ * Returns nonzero if the file cannot be read. */
+static int db_file_hash(int id, Hash64 *out) {
+  const StatEntry *st = stat_cache_get(g_db.paths.items[id]);
+  DbFile *df = &g_db.files[id];
+  FILE *f;
+  char buf[16384];
+  size_t n;
 
-  if (!d || !d->name) return;
+  if (st->mtime < 0) return 1;
+  if (df->hashed && df->mtime == st->mtime && df->size == st->size) { *out = df->hash; return 0; }
 
-    idx = tv_find_index_by_name(v, d->name);
+  f = fopen(g_db.paths.items[id], "rb");
+  if (!f) return 1;
+  h64_init(out);
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) h64_update(out, buf, n);
+  fclose(f);
 
-  /* remove wins */
-  if (d->remove) {
-    if (idx >= 0) tv_remove_at(v, idx);
-    return;
+  df->mtime = st->mtime;
+  df->size = st->size;
+  df->hashed = 1;
+  df->hash = *out;
+  g_db.dirty = 1;
+  return 0;
+}
+
+/* out's record if it is current for out_t, else 0. With --hash-deps a record whose
+ * output only got a new mtime (CI cache restore, fresh checkout) stays current: out's
+ * content hash from recording time still matches, so the new mtime is adopted. */
+static DbRec *db_rec_current(const char *out, long out_t) {
+  DbRec *r = db_find_rec(out);
+  DbFile *df;
+  Hash64 was, h;
+
+  if (!r || r->out_mtime == out_t) return r;
+  if (!g_hash_deps || out_t < 0) return 0;
+  df = &g_db.files[r->out];
+  if (!df->hashed) return 0;
+  was = df->hash;
+  if (db_file_hash(r->out, &h) != 0 || h.a != was.a || h.b != was.b) return 0;
+  r->out_mtime = out_t;
+  g_db.dirty = 1;
+  return r;
+}
+
+/* record out's deps from its depfile (right after a successful compile) */
+static int db_ingest_depfile(const char *out, const char *dep_path, const Hash64 *cmd) {
+  StrVec deps;
+  DbRec *r;
+  int i;
+
+  db_load();
+  sv_init(&deps);
+  if (depfile_parse(dep_path, &deps) != 0) { sv_free(&deps); return 1; }
+
+  r = db_put_rec(out);
+  r->out_mtime = file_mtime(out);
+  if (cmd) r->cmd = *cmd;
+  if (g_hash_deps) { Hash64 h; db_file_hash(r->out, &h); } /* for db_rec_current */
+  r->deps = deps.count ? (DbDep*)xmalloc((size_t)deps.count * sizeof(DbDep)) : 0;
+  for (i = 0; i < deps.count; i++) {
+    r->deps[i].path = db_intern(deps.items[i]);
+    r->deps[i].mtime = file_mtime(deps.items[i]);
+    r->deps[i].hashed = g_hash_deps && db_file_hash(r->deps[i].path, &r->deps[i].hash) == 0;
+    r->ndeps++;
   }
 
-  /* action-only: enable/disable existing */
-  if (!d->src_dir && !d->bin_base && !d->id) {
-    if (idx >= 0) v->items[idx].enabled = d->enabled ? 1 : 0;
-    return;
+  sv_free(&deps);
+  return 0;
+}
+
+static int depfile_needs_rebuild(const char *obj_path, const char *dep_path) {
+#if USE_DEPFILES
+  long obj_t;
+  DbRec *r;
+  int i;
+
+  obj_t = file_mtime(obj_path);
+  if (obj_t < 0) return 1;
+
+  db_load();
+
+  /* no (or stale) record: ingest the .d file once, then answer from the db */
+  r = db_rec_current(obj_path, obj_t);
+  if (!r) {
+    if (db_ingest_depfile(obj_path, dep_path, 0) != 0) return 1;
+    r = db_find_rec(obj_path);
   }
 
-  /* upsert */
-  if (idx < 0) {
-    /* create with best-effort defaults, then apply upserts */
-    tv_push(v, d->name, d->src_dir ? d->src_dir : "src", d->bin_base ? d->bin_base : "app");
-    idx = v->count - 1;
+  for (i = 0; i < r->ndeps; i++) {
+    DbDep *d = &r->deps[i];
+    long dt = file_mtime(g_db.paths.items[d->path]);
+    if (dt < 0) return 1;
+    if (g_hash_deps && d->hashed) {
+      Hash64 h;
+      if (dt == d->mtime) continue;
+      if (db_file_hash(d->path, &h) != 0) return 1;
+      if (h.a != d->hash.a || h.b != d->hash.b) return 1;
+      d->mtime = dt; /* same content, new mtime: skip the hash next time */
+      g_db.dirty = 1;
+      continue;
+    }
+    if (mtime_newer(dt, obj_t)) return 1;
   }
+  return 0;
+#else
+  (void)obj_path; (void)dep_path;
+  return 1;
+#endif
+}
 
-    tv_update_at_fields(v, idx, d);
+/* does out still carry the signature of cmd? (no record / stale record = unknown = no) */
+static int db_signature_matches(const char *out, long out_t, const Hash64 *cmd) {
+  DbRec *r;
+  db_load();
+  r = db_rec_current(out, out_t);
+  if (!r) return 0;
+  return r->cmd.a == cmd->a && r->cmd.b == cmd->b;
+}
 
-  /* enabled defaults to 1; if explicitly 0, allow disabling */
-  v->items[idx].enabled = (d->enabled ? 1 : 0);
+/* wall time and peak RSS of the job that produced out (tests: out is their log) */
+static void db_record_run(const char *out, long ms, long peak_kb) {
+  DbRec *r;
+  db_load();
+  r = db_find_rec(out);
+  if (!r) r = db_put_rec(out);
+  if (ms < 1) ms = 1;
+  if (r->ms != ms || r->peak_kb != peak_kb) { r->ms = ms; r->peak_kb = peak_kb; g_db.dirty = 1; }
 }
 
-/* --------------------------- tackfile.c targets --------------------------- */
-#ifdef TACKFILE_TARGETS
-static void apply_tackfile_targets(TargetVec *out) {
+/* record out + its command signature; links/archives list their inputs as deps with
+ * a content hash, so a recompile that reproduced an object byte for byte does not
+ * relink (db_input_unchanged) */
+static void db_record_output(const char *out, const Hash64 *cmd, const StrVec *inputs) {
+  DbRec *r;
   int i;
-  for (i = 0; TACKFILE_TARGETS[i].name; i++) {
-    tv_apply_targetdef(out, &TACKFILE_TARGETS[i]);
+  db_load();
+  r = db_put_rec(out);
+  r->out_mtime = file_mtime(out);
+  r->cmd = *cmd;
+  if (g_hash_deps) { Hash64 h; db_file_hash(r->out, &h); } /* for db_rec_current */
+  r->deps = inputs->count ? (DbDep*)xmalloc((size_t)inputs->count * sizeof(DbDep)) : 0;
+  for (i = 0; i < inputs->count; i++) {
+    DbDep *d = &r->deps[r->ndeps++];
+    d->path = db_intern(inputs->items[i]);
+    d->mtime = file_mtime(inputs->items[i]);
+    d->hashed = db_file_hash(d->path, &d->hash) == 0;
+  }
+}
+
+/* in (mtime in_t) is what out's recorded link read: same mtime or same content */
+static int db_input_unchanged(const char *out, long out_t, const char *in, long in_t) {
+  DbRec *r;
+  Hash64 h;
+  int id, i;
+  db_load();
+  r = db_rec_current(out, out_t);
+  id = db_find_path(in);
+  if (!r || id < 0) return 0;
+  for (i = 0; i < r->ndeps; i++) {
+    const DbDep *d = &r->deps[i];
+    if (d->path != id) continue;
+    if (d->mtime == in_t) return 1;
+    if (!d->hashed || db_file_hash(id, &h) != 0) return 0;
+    return h.a == d->hash.a && h.b == d->hash.b;
   }
+  return 0;
 }
+
+/* cmd: hash of the full compile argv; a changed command line (cflags, defines, CC, ...)
+ * rebuilds just the objects it affects, without --rebuild */
+static int obj_needs_rebuild(const char *obj_path, const char *src_path, const char *dep_path,
+                             const Hash64 *cmd, int force) {
+  long obj_t, src_t;
+  if (force) return 1;
+  obj_t = file_mtime(obj_path);
+  if (obj_t < 0) return 1;
+  src_t = file_mtime(src_path);
+  if (src_t < 0) return 1;
+  if (cmd && !db_signature_matches(obj_path, obj_t, cmd)) return 1;
+#if USE_DEPFILES
+  /* --hash-deps: the source is a depfile entry too, compared by content below */
+  if (mtime_newer(src_t, obj_t) && !g_hash_deps) return 1;
+  if (depfile_needs_rebuild(obj_path, dep_path)) return 1;
 #else
-static void apply_tackfile_targets(TargetVec *out) { (void)out; }
+  (void)dep_path;
+  if (mtime_newer(src_t, obj_t)) return 1;
 #endif
+  return 0;
+}
 
-/* --------------------------- tack.ini (INI config) --------------------------- */
+/* --------------------------- object cache --------------------------- */
+/* Optional content-addressed object cache, shared by all builds of a user
+ * (--cache or TACK_CACHE=1). Dir: TACK_CACHE_DIR, else $XDG_CACHE_HOME/tack,
+ * ~/.cache/tack or %LOCALAPPDATA%\tack. Works like ccache's direct mode:
+ *   key       = H(compiler identity, cwd, argv without output paths, source contents)
+ *   m/<key>   manifest: the last few dep lists seen for key, with the content hash
+ *             of every dep and the id of the object built from them
+ *   o/<id>.o  the object
+ * A hit copies the object (copies, not hardlinks: compilers rewrite outputs in place)
+ * and writes a fresh .d from the manifest, without running the compiler.
+ * Size cap: TACK_CACHE_SIZE in MiB (default 1024); LRU by object mtime, touched on hits.
+ */
 
-typedef struct {
-  char *name; /* target name key */
-  char *src_dir;
-  char *bin_base;
-  char *id;
-  int enabled_set, enabled;
-  int remove_set, remove;
-  int core_set, core;
+#define TACK_CACHE_MAGIC        "TACKMF\r\n"
+#define TACK_CACHE_VERSION      1UL
+#define TACK_CACHE_MAX_ENTRIES  8
 
-  StrVec includes;
-  StrVec defines;
-  StrVec cflags;
-  StrVec ldflags;
-  StrVec libs;
-} IniTargetCfg;
+static int g_cache_cli = 0; /* --cache */
 
 typedef struct {
-  IniTargetCfg *items;
-  int count;
-  int cap;
-} IniTargetVec;
+  int decided;
+  int enabled;
+  char dir[1024];
+  Hash64 cc_id;
+  int cc_id_done;
+  long hits;
+  long misses;
+  long stored_bytes;
+} ObjCache;
+
+static ObjCache g_cache;
 
 typedef struct {
-  TargetOverride *items;
-  int count;
-  int cap;
-} IniOverrideVec;
+  StrVec deps;
+  Hash64 *hashes;
+  Hash64 obj;
+} CacheEntry;
 
-static IniTargetVec g_ini_targets;
-static IniOverrideVec g_ini_overrides;
+static void h64_hex(char *out, const Hash64 *h) {
+  sprintf(out, "%08lx%08lx", h->a & 0xffffffffUL, h->b & 0xffffffffUL);
+}
 
-static void ini_targets_init(void) { g_ini_targets.items = 0; g_ini_targets.count = 0; g_ini_targets.cap = 0; }
-static void ini_overrides_init(void) { g_ini_overrides.items = 0; g_ini_overrides.count = 0; g_ini_overrides.cap = 0; }
+static int cache_enabled(void) {
+  const char *v, *base;
 
-static void free_strlist(char **lst) {
-  int i;
-  if (!lst) return;
-  for (i = 0; lst[i]; i++) free(lst[i]);
-  free(lst);
-}
+  if (g_cache.decided) return g_cache.enabled;
+  g_cache.decided = 1;
 
-static void ini_targets_free(void) {
-  int i;
-  for (i = 0; i < g_ini_targets.count; i++) {
-    IniTargetCfg *t = &g_ini_targets.items[i];
-    free(t->name);
-    free(t->src_dir);
-    free(t->bin_base);
-    free(t->id);
-    sv_free(&t->includes);
-    sv_free(&t->defines);
-    sv_free(&t->cflags);
-    sv_free(&t->ldflags);
-    sv_free(&t->libs);
+  v = getenv("TACK_CACHE");
+  if (!g_cache_cli && !(v && *v && !streq(v, "0"))) {
+    v = getenv("TACK_REMOTE_CACHE");
+    if (!(v && *v)) return 0;
   }
-  free(g_ini_targets.items);
-  g_ini_targets.items = 0; g_ini_targets.count = 0; g_ini_targets.cap = 0;
-}
 
-static void ini_overrides_free(void) {
-  int i;
-  for (i = 0; i < g_ini_overrides.count; i++) {
-    TargetOverride *ov = &g_ini_overrides.items[i];
-    free((char*)ov->name);
-    free_strlist((char**)ov->includes);
-    free_strlist((char**)ov->defines);
-    free_strlist((char**)ov->cflags);
-    free_strlist((char**)ov->ldflags);
-    free_strlist((char**)ov->libs);
+  v = getenv("TACK_CACHE_DIR");
+  if (v && *v) {
+    tack_copy(g_cache.dir, sizeof(g_cache.dir), v);
+  } else if ((base = getenv("XDG_CACHE_HOME")) != 0 && *base) {
+    path_join(g_cache.dir, sizeof(g_cache.dir), base, "tack");
+  } else if ((base = getenv("HOME")) != 0 && *base) {
+    char tmp[1024];
+    path_join(tmp, sizeof(tmp), base, ".cache");
+    path_join(g_cache.dir, sizeof(g_cache.dir), tmp, "tack");
+  } else if ((base = getenv("LOCALAPPDATA")) != 0 && *base) {
+    path_join(g_cache.dir, sizeof(g_cache.dir), base, "tack");
+  } else {
+    fprintf(stderr, "tack: warning: no cache directory (set TACK_CACHE_DIR); cache disabled\n");
+    return 0;
   }
-  free(g_ini_overrides.items);
-  g_ini_overrides.items = 0; g_ini_overrides.count = 0; g_ini_overrides.cap = 0;
+
+  g_cache.enabled = 1;
+  return 1;
 }
 
-/* tiny trimming helpers */
-static char *ltrim(char *s) { while (*s && isspace((unsigned char)*s)) s++; return s; }
-static void rtrim_inplace(char *s) {
-  size_t n = strlen(s);
-  while (n > 0 && isspace((unsigned char)s[n - 1])) { s[n - 1] = '\0'; n--; }
+static void cache_sub(char *out, size_t cap, const char *sub, const Hash64 *h, const char *suffix) {
+  char hex[17], name[64], d[1024];
+  path_join(d, sizeof(d), g_cache.dir, sub);
+  h64_hex(hex, h);
+  tack_copy(name, sizeof(name), hex);
+  tack_cat(name, sizeof(name), suffix);
+  path_join(out, cap, d, name);
 }
-static char *trim(char *s) { s = ltrim(s); rtrim_inplace(s); return s; }
 
-static int strieq(const char *a, const char *b) {
-  unsigned char ca, cb;
-  while (*a && *b) {
-    ca = (unsigned char)*a++;
-    cb = (unsigned char)*b++;
-    if (tolower(ca) != tolower(cb)) return 0;
+static long cache_cap_bytes(void) {
+  const char *v = getenv("TACK_CACHE_SIZE");
+  long mb = 1024;
+  if (v && *v) {
+    mb = atol(v);
+    if (mb < 1) mb = 1;
   }
-  return *a == '\0' && *b == '\0';
+  return mb * 1024L * 1024L;
 }
 
-static int parse_bool(const char *v, int *out) {
-  if (!v) return 0;
-  if (strieq(v, "1") || strieq(v, "yes") || strieq(v, "true") || strieq(v, "on")) { *out = 1; return 1; }
-  if (strieq(v, "0") || strieq(v, "no")  || strieq(v, "false")|| strieq(v, "off")) { *out = 0; return 1; }
-  return 0;
-}
+/* compiler identity: name + size/mtime of the binary found on PATH (a switched or
+ * upgraded compiler must not reuse objects) */
+static const Hash64 *cache_cc_identity(const char *cc) {
+  STAT_ST st;
+  char found[1024];
+  int ok = 0;
 
-static void split_list_tokens(StrVec *out, const char *v, int ws_sep) {
-  const char *p = v;
+  if (g_cache.cc_id_done) return &g_cache.cc_id;
+  g_cache.cc_id_done = 1;
 
-  while (p && *p) {
-    char *tmp;
-    size_t n;
+  h64_init(&g_cache.cc_id);
+  h64_update(&g_cache.cc_id, cc, strlen(cc) + 1);
 
-    /* skip separators and leading whitespace */
-    while (*p && (*p == ';' || isspace((unsigned char)*p))) p++;
-    if (!*p) break;
+  if (strchr(cc, '/') || strchr(cc, '\\')) {
+    tack_copy(found, sizeof(found), cc);
+    ok = STAT_FN(found, &st) == 0;
+  } else {
+    const char *path = getenv("PATH");
+#ifdef _WIN32
+    const char sep = ';';
+#else
+    const char sep = ':';
+#endif
+    while (path && *path && !ok) {
+      const char *e = strchr(path, sep);
+      size_t n = e ? (size_t)(e - path) : strlen(path);
+      char d[1024];
+      if (n > 0 && n < sizeof(d)) {
+        memcpy(d, path, n);
+        d[n] = '\0';
+        path_join(found, sizeof(found), d, cc);
+        ok = STAT_FN(found, &st) == 0;
+#ifdef _WIN32
+        if (!ok) { tack_cat(found, sizeof(found), ".exe"); ok = STAT_FN(found, &st) == 0; }
+#endif
+      }
+      path = e ? e + 1 : 0;
+    }
+  }
 
-    /* quoted token: " ... " */
-    if (*p == '"') {
-      const char *q;
-      p++; /* skip opening quote */
-    q = p;
-      while (*q && *q != '"') q++;
-      if (!*q) tack_die("ini: unterminated quote in list");
+  if (ok) {
+    long v[2];
+    v[0] = (long)st.st_size;
+    v[1] = (long)st.st_mtime;
+    h64_update(&g_cache.cc_id, found, strlen(found) + 1);
+    h64_update(&g_cache.cc_id, v, sizeof(v));
+  }
+  return &g_cache.cc_id;
+}
 
-    n = (size_t)(q - p);
-    if (n > TACK_MAX_TOKEN) tack_die("ini token too long");
+/* manifest key for a compile; nonzero if the source cannot be read */
+static int cache_key(Hash64 *key, char **argv, const char *src) {
+  const Hash64 *id = cache_cc_identity(argv[0]);
+  Hash64 sh;
+  char cwd[1024];
+  int i;
 
-    tmp = (char*)xmalloc(n + 1);
-    memcpy(tmp, p, n);
-    tmp[n] = '\0';
+  db_load();
+  if (db_file_hash(db_intern(src), &sh) != 0) return 1;
 
-      if (tmp[0]) {
-        if (out->count >= TACK_MAX_LIST_ITEMS) { free(tmp); tack_die("ini list too long"); }
-        sv_push_own(out, tmp); /* already owned */
-      } else {
-    free(tmp);
-      }
+  h64_init(key);
+  h64_update(key, id, sizeof(*id));
+#ifdef _WIN32
+  if (!_getcwd(cwd, (int)sizeof(cwd))) cwd[0] = '\0';
+#else
+  if (!getcwd(cwd, sizeof(cwd))) cwd[0] = '\0';
+#endif
+  h64_update(key, cwd, strlen(cwd) + 1); /* debug info embeds the build dir */
 
-      p = q + 1; /* skip closing quote */
-      continue;
-    }
+  for (i = 1; argv[i]; i++) {
+    /* output paths differ between profiles/targets but do not change the object */
+    if ((streq(argv[i], "-o") || streq(argv[i], "-MF")) && argv[i + 1]) { i++; continue; }
+    h64_update(key, argv[i], strlen(argv[i]) + 1);
+  }
+  h64_update(key, &sh, sizeof(sh));
+  return 0;
+}
 
-    /* unquoted token */
-    {
-      const char *q = p;
-      while (*q) {
-        if (*q == ';') break;
-        if (ws_sep && isspace((unsigned char)*q)) break;
-        q++;
-      }
+static void cache_entries_free(CacheEntry *es, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    sv_free(&es[i].deps);
+    free(es[i].hashes);
+  }
+}
 
-      n = (size_t)(q - p);
-      if (n > TACK_MAX_TOKEN) tack_die("ini token too long");
+/* read up to TACK_CACHE_MAX_ENTRIES manifest entries; returns the count (0 on any error) */
+static int cache_read_manifest(const char *path, CacheEntry *es) {
+  FILE *f;
+  char magic[8];
+  unsigned long ver, n, i;
+  int count = 0, bad = 0;
 
-      tmp = (char*)xmalloc(n + 1);
-      memcpy(tmp, p, n);
-      tmp[n] = '\0';
+  f = fopen(path, "rb");
+  if (!f) return 0;
 
-      {
-        char *t = trim(tmp);
-        if (t[0]) {
-          if (out->count >= TACK_MAX_LIST_ITEMS) { free(tmp); tack_die("ini list too long"); }
-          if (t != tmp) {
-            char *own = xstrdup(t);
-            free(tmp);
-            tmp = own;
-          }
-          sv_push_own(out, tmp);
-        } else {
-          free(tmp);
-        }
-      }
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TACK_CACHE_MAGIC, 8) != 0 ||
+      db_get_u32(f, &ver) || ver != TACK_CACHE_VERSION ||
+      db_get_u32(f, &n) || n > TACK_CACHE_MAX_ENTRIES) {
+    fclose(f);
+    return 0;
+  }
 
-    p = q;
-      continue;
+  for (i = 0; i < n && !bad; i++) {
+    CacheEntry *e = &es[count];
+    unsigned long nd, k;
+
+    sv_init(&e->deps);
+    e->hashes = 0;
+    count++;
+
+    if (db_get_u32(f, &e->obj.a) || db_get_u32(f, &e->obj.b) ||
+        db_get_u32(f, &nd) || nd > 65536UL) { bad = 1; break; }
+    e->hashes = (Hash64*)xmalloc((size_t)(nd ? nd : 1) * sizeof(Hash64));
+    for (k = 0; k < nd; k++) {
+      unsigned long len;
+      char *s;
+      if (db_get_u32(f, &len) || len > TACK_MAX_TOKEN) { bad = 1; break; }
+      s = (char*)xmalloc((size_t)len + 1);
+      if (fread(s, 1, (size_t)len, f) != (size_t)len) { free(s); bad = 1; break; }
+      s[len] = '\0';
+      sv_push_own(&e->deps, s);
+      if (db_get_u32(f, &e->hashes[k].a) || db_get_u32(f, &e->hashes[k].b)) { bad = 1; break; }
+    }
+  }
+  fclose(f);
+
+  if (bad) { cache_entries_free(es, count); return 0; }
+  return count;
+}
+
+static int cache_write_manifest(const char *path, const CacheEntry *es, int n) {
+  char tmp[1100];
+  FILE *f;
+  int i, k;
+
+  tack_copy(tmp, sizeof(tmp), path);
+  tack_cat(tmp, sizeof(tmp), ".tmp");
+  f = fopen(tmp, "wb");
+  if (!f) return 1;
+
+  fwrite(TACK_CACHE_MAGIC, 1, 8, f);
+  db_put_u32(f, TACK_CACHE_VERSION);
+  db_put_u32(f, (unsigned long)n);
+  for (i = 0; i < n; i++) {
+    db_put_u32(f, es[i].obj.a);
+    db_put_u32(f, es[i].obj.b);
+    db_put_u32(f, (unsigned long)es[i].deps.count);
+    for (k = 0; k < es[i].deps.count; k++) {
+      size_t len = strlen(es[i].deps.items[k]);
+      db_put_u32(f, (unsigned long)len);
+      fwrite(es[i].deps.items[k], 1, len, f);
+      db_put_u32(f, es[i].hashes[k].a);
+      db_put_u32(f, es[i].hashes[k].b);
+    }
   }
+
+  if (fclose(f) != 0) { remove(tmp); return 1; }
+#ifdef _WIN32
+  remove(path);
+#endif
+  if (rename(tmp, path) != 0) { remove(tmp); return 1; }
+  return 0;
 }
+
+static int copy_file(const char *from, const char *to) {
+  FILE *in, *out;
+  char buf[16384];
+  size_t n;
+  int rc = 0;
+
+  in = fopen(from, "rb");
+  if (!in) return 1;
+  out = fopen(to, "wb");
+  if (!out) { fclose(in); return 1; }
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    if (fwrite(buf, 1, n, out) != n) { rc = 1; break; }
+  }
+  if (ferror(in)) rc = 1;
+  fclose(in);
+  if (fclose(out) != 0) rc = 1;
+  return rc;
 }
 
-static IniTargetCfg *ini_get_or_add_target(const char *name) {
+/* depfile for a cache hit, in the compiler's own format */
+static int cache_write_depfile(const char *dep_path, const char *obj_path, const StrVec *deps) {
+  FILE *f = fopen(dep_path, "wb");
   int i;
-  for (i = 0; i < g_ini_targets.count; i++) {
-    if (streq(g_ini_targets.items[i].name, name)) return &g_ini_targets.items[i];
+  const char *p;
+
+  if (!f) return 1;
+  fprintf(f, "%s:", obj_path);
+  for (i = 0; i < deps->count; i++) {
+    fputs(" \\\n ", f);
+    for (p = deps->items[i]; *p; p++) {
+      if (*p == ' ') fputc('\\', f);
+      fputc(*p, f);
+    }
   }
-  if (g_ini_targets.count + 1 > g_ini_targets.cap) {
-    int ncap = g_ini_targets.cap ? g_ini_targets.cap * 2 : 8;
-    g_ini_targets.items = (IniTargetCfg*)xrealloc(g_ini_targets.items, (size_t)ncap * sizeof(IniTargetCfg));
-    g_ini_targets.cap = ncap;
+  fputc('\n', f);
+  return fclose(f) != 0;
+}
+
+static void cache_touch(const char *path) {
+#ifdef _WIN32
+  _utime(path, 0);
+#else
+  utime(path, 0);
+#endif
+}
+
+/* first manifest entry whose deps all still have the recorded contents, or -1 */
+static int cache_match(const CacheEntry *es, int n) {
+  int i, k;
+  for (i = 0; i < n; i++) {
+    for (k = 0; k < es[i].deps.count; k++) {
+      Hash64 h;
+      if (db_file_hash(db_intern(es[i].deps.items[k]), &h) != 0) break;
+      if (h.a != es[i].hashes[k].a || h.b != es[i].hashes[k].b) break;
+    }
+    if (k == es[i].deps.count) return i;
   }
-  {
-    IniTargetCfg *t = &g_ini_targets.items[g_ini_targets.count++];
-    memset(t, 0, sizeof(*t));
-    t->name = xstrdup(name);
-    sv_init(&t->includes);
-    sv_init(&t->defines);
-    sv_init(&t->cflags);
-    sv_init(&t->ldflags);
-    sv_init(&t->libs);
-    t->enabled_set = 0; t->enabled = 1;
-    t->remove_set = 0; t->remove = 0;
-    t->core_set = 0; t->core = 0;
-    return t;
+  return -1;
+}
+
+/* try to satisfy a compile from the cache; 0 = hit (obj + dep written) */
+static int cache_fetch(const Hash64 *key, const char *obj_path, const char *dep_path) {
+  CacheEntry es[TACK_CACHE_MAX_ENTRIES];
+  char man[1024], obj[1024];
+  int n, hit;
+
+  cache_sub(man, sizeof(man), "m", key, "");
+  n = cache_read_manifest(man, es);
+  hit = cache_match(es, n);
+
+  if (hit >= 0) {
+    cache_sub(obj, sizeof(obj), "o", &es[hit].obj, ".o");
+    remove(obj_path);
+    if (copy_file(obj, obj_path) != 0 || cache_write_depfile(dep_path, obj_path, &es[hit].deps) != 0) {
+      remove(obj_path);
+      hit = -1;
+    } else {
+      cache_touch(obj);
+    }
+    stat_cache_forget(obj_path);
+    stat_cache_forget(dep_path);
   }
+
+  cache_entries_free(es, n);
+  if (hit < 0) { g_cache.misses++; return 1; }
+  g_cache.hits++;
+  return 0;
 }
 
-static char **sv_to_strlist_own(StrVec *v) {
-  char **lst;
-  int i;
-  lst = (char**)xmalloc((size_t)(v->count + 1) * sizeof(char*));
-  for (i = 0; i < v->count; i++) lst[i] = v->items[i]; /* transfer */
-  lst[v->count] = 0;
-  free(v->items);
-  v->items = 0; v->count = 0; v->cap = 0;
-  return lst;
+/* put ne (taken over) first in the manifest of key; drops an older entry for the same
+ * object and the oldest overflow */
+static void cache_manifest_add(const Hash64 *key, CacheEntry *ne) {
+  CacheEntry es[TACK_CACHE_MAX_ENTRIES];
+  char man[1024];
+  int n, i, k;
+
+  cache_sub(man, sizeof(man), "m", key, "");
+  n = cache_read_manifest(man, es);
+  for (i = 0; i < n; i++) {
+    if (es[i].obj.a == ne->obj.a && es[i].obj.b == ne->obj.b) {
+      cache_entries_free(&es[i], 1);
+      for (k = i; k + 1 < n; k++) es[k] = es[k + 1];
+      n--;
+      break;
+    }
+  }
+  if (n == TACK_CACHE_MAX_ENTRIES) { cache_entries_free(&es[n - 1], 1); n--; }
+  for (k = n; k > 0; k--) es[k] = es[k - 1];
+  es[0] = *ne;
+  n++;
+
+  if (cache_write_manifest(man, es, n) != 0) fprintf(stderr, "tack: warning: cannot write %s\n", man);
+  cache_entries_free(es, n);
 }
 
-static TargetOverride *ini_get_or_add_override(const char *name) {
-  int i;
-  for (i = 0; i < g_ini_overrides.count; i++) {
-    if (streq(g_ini_overrides.items[i].name, name)) return &g_ini_overrides.items[i];
+static void remote_queue_put(const Hash64 *key, const Hash64 *obj);
+
+/* after a successful compile: store the object and add its dep list to the manifest */
+static void cache_store(const Hash64 *key, const char *obj_path, const char *dep_path) {
+  CacheEntry ne;
+  char obj[1024], tmp[1100], sub[1024];
+  long old_size;
+  int k;
+  STAT_ST st;
+
+  sv_init(&ne.deps);
+  if (depfile_parse(dep_path, &ne.deps) != 0) { sv_free(&ne.deps); return; }
+  ne.hashes = (Hash64*)xmalloc((size_t)(ne.deps.count ? ne.deps.count : 1) * sizeof(Hash64));
+
+  ne.obj = *key;
+  for (k = 0; k < ne.deps.count; k++) {
+    if (db_file_hash(db_intern(ne.deps.items[k]), &ne.hashes[k]) != 0) { cache_entries_free(&ne, 1); return; }
+    h64_update(&ne.obj, ne.deps.items[k], strlen(ne.deps.items[k]) + 1);
+    h64_update(&ne.obj, &ne.hashes[k], sizeof(Hash64));
   }
-  if (g_ini_overrides.count + 1 > g_ini_overrides.cap) {
-    int ncap = g_ini_overrides.cap ? g_ini_overrides.cap * 2 : 8;
-    g_ini_overrides.items = (TargetOverride*)xrealloc(g_ini_overrides.items, (size_t)ncap * sizeof(TargetOverride));
-    g_ini_overrides.cap = ncap;
+
+  ensure_dir(g_cache.dir);
+  path_join(sub, sizeof(sub), g_cache.dir, "o"); ensure_dir(sub);
+  path_join(sub, sizeof(sub), g_cache.dir, "m"); ensure_dir(sub);
+
+  cache_sub(obj, sizeof(obj), "o", &ne.obj, ".o");
+  tack_copy(tmp, sizeof(tmp), obj);
+  tack_cat(tmp, sizeof(tmp), ".tmp");
+  if (copy_file(obj_path, tmp) != 0) { remove(tmp); cache_entries_free(&ne, 1); return; }
+  /* a re-store over an existing object only changes the cache size by the difference */
+  old_size = STAT_FN(obj, &st) == 0 ? (long)st.st_size : 0;
+#ifdef _WIN32
+  remove(obj);
+#endif
+  if (rename(tmp, obj) != 0) { remove(tmp); cache_entries_free(&ne, 1); return; }
+  if (STAT_FN(obj, &st) == 0) g_cache.stored_bytes += (long)st.st_size - old_size;
+
+  remote_queue_put(key, &ne.obj);
+  cache_manifest_add(key, &ne);
+}
+
+/* --------------------------- remote cache --------------------------- */
+/* Optional HTTP backend behind the object cache, for CI runners that start empty
+ * (TACK_REMOTE_CACHE=http[s]://host/prefix; implies the local cache). Same layout and
+ * keys as the local cache: GET/PUT <url>/m/<key> and <url>/o/<id>.o, so any server
+ * that stores PUT bodies works (nginx/WebDAV, bazel-remote, an S3 bucket behind a
+ * signing proxy). Transfers run through curl, up to TACK_REMOTE_CACHE_JOBS (16) at once.
+ *   TACK_REMOTE_CACHE_MODE    read (default, PR builds) or write (also upload, main builds)
+ *   TACK_REMOTE_CACHE_TIMEOUT seconds per request (default 3)
+ *   TACK_REMOTE_CACHE_HEADER  extra request header, e.g. "Authorization: Bearer ...";
+ *                             passed to curl via a 0600 config file, never on argv
+ * Before a plan runs, manifests for every missing object are fetched in one concurrent
+ * round and matching objects in a second; hits land in the local cache. Uploads are
+ * queued per stored object and sent when the build ends. A connect failure or timeout
+ * switches the remote off for the rest of the run: everything else compiles locally.
+ */
+
+typedef struct {
+  int decided;
+  int enabled;
+  int write;
+  int down;          /* unreachable or too slow: no more requests this run */
+  char url[1024];
+  const char *header;
+  char timeout[24];
+  int jobs;
+  StrVec put_objs, put_obj_urls;  /* write mode: queued uploads */
+  StrVec put_mans, put_man_urls;
+  long lookups;
+  long hits;
+} RemoteCache;
+
+static RemoteCache g_remote;
+
+static int remote_enabled(void) {
+  const char *v;
+  size_t n;
+  long t;
+
+  if (g_remote.decided) return g_remote.enabled && !g_remote.down;
+  g_remote.decided = 1;
+  sv_init(&g_remote.put_objs);
+  sv_init(&g_remote.put_obj_urls);
+  sv_init(&g_remote.put_mans);
+  sv_init(&g_remote.put_man_urls);
+
+  v = getenv("TACK_REMOTE_CACHE");
+  if (!v || !*v) return 0;
+  tack_check_len("TACK_REMOTE_CACHE", v, 900);
+  if (strncmp(v, "http://", 7) != 0 && strncmp(v, "https://", 8) != 0) {
+    fprintf(stderr, "tack: warning: TACK_REMOTE_CACHE must be an http(s) URL; remote cache disabled\n");
+    return 0;
   }
-  {
-    TargetOverride *ov = &g_ini_overrides.items[g_ini_overrides.count++];
-    memset(ov, 0, sizeof(*ov));
-    ov->name = xstrdup(name);
-    ov->includes = 0;
-    ov->defines = 0;
-    ov->cflags = 0;
-    ov->ldflags = 0;
-    ov->libs = 0;
-    ov->use_core = 0;
-    return ov;
+  if (!cache_enabled()) return 0;
+  tack_copy(g_remote.url, sizeof(g_remote.url), v);
+  n = strlen(g_remote.url);
+  while (n > 0 && g_remote.url[n - 1] == '/') g_remote.url[--n] = '\0';
+
+  v = getenv("TACK_REMOTE_CACHE_MODE");
+  if (v && streq(v, "write")) g_remote.write = 1;
+  else if (v && *v && !streq(v, "read")) fprintf(stderr, "tack: warning: TACK_REMOTE_CACHE_MODE=%s: using read\n", v);
+
+  v = getenv("TACK_REMOTE_CACHE_TIMEOUT");
+  t = (v && *v) ? atol(v) : 3;
+  if (t < 1) t = 1;
+  if (t > 3600) t = 3600;
+  sprintf(g_remote.timeout, "%ld", t);
+
+  v = getenv("TACK_REMOTE_CACHE_JOBS");
+  g_remote.jobs = (v && *v) ? atoi(v) : 16;
+  if (g_remote.jobs < 1) g_remote.jobs = 1;
+
+  v = getenv("TACK_REMOTE_CACHE_HEADER");
+  if (v && *v) {
+    tack_check_len("TACK_REMOTE_CACHE_HEADER", v, 4096);
+    g_remote.header = v;
   }
+
+  g_remote.enabled = 1;
+  return 1;
 }
 
-/* INI override lookup (used by find_override) */
-static const TargetOverride *find_ini_override(const char *name) {
-  int i;
-  for (i = 0; i < g_ini_overrides.count; i++) {
-    if (streq(g_ini_overrides.items[i].name, name)) return &g_ini_overrides.items[i];
+static void remote_url(char *out, size_t cap, const char *sub, const Hash64 *h, const char *suffix) {
+  char hex[17];
+  h64_hex(hex, h);
+  tack_copy(out, cap, g_remote.url);
+  tack_cat(out, cap, "/");
+  tack_cat(out, cap, sub);
+  tack_cat(out, cap, "/");
+  tack_cat(out, cap, hex);
+  tack_cat(out, cap, suffix);
+}
+
+/* TACK_REMOTE_CACHE_HEADER usually carries a token: hand it to curl as a config file
+ * (-K) in a private temp dir instead of on the command line, where ps would show it.
+ * dir/cfg receive the paths; 0 on success. */
+static int remote_header_file(char *dir, size_t dcap, char *cfg, size_t ccap) {
+  const char *p;
+  FILE *f;
+  int ok;
+
+  if (tmp_private_dir(dir, dcap, "curl") != 0) return 1;
+  path_join(cfg, ccap, dir, "header.cfg");
+  f = fopen(cfg, "wb");
+  if (!f) { rm_rf(dir); return 1; }
+  fputs("header = \"", f);
+  for (p = g_remote.header; *p; p++) {
+    if (*p == '"' || *p == '\\') fputc('\\', f);
+    fputc(*p, f);
   }
+  fputs("\"\n", f);
+  ok = !ferror(f);
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) { rm_rf(dir); return 1; }
   return 0;
 }
 
-/* read tack.ini into g_ini_targets/g_ini_overrides + project globals */
-static int ini_load_file(const char *path) {
-  FILE *f;
-  char line[TACK_MAX_LINE];
-  int lineno = 0;
+/* n transfers through curl, concurrently; rcs[i] = curl's exit code (-1 = not run).
+ * put: upload files[i] to urls[i], else download urls[i] into files[i]. */
+static void remote_batch(char **urls, char **files, int *rcs, int n, int put, const char *what) {
+#ifdef _WIN32
+  static const char *null_dev = "NUL";
+#else
+  static const char *null_dev = "/dev/null";
+#endif
+  JobPool pool;
+  char hdir[1024], hcfg[1100];
+  long t0 = now_ms();
+  int next = 0, i, tag, rc;
+
+  for (i = 0; i < n; i++) rcs[i] = -1;
+  if (n == 0) return;
+
+  hdir[0] = '\0';
+  if (g_remote.header && remote_header_file(hdir, sizeof(hdir), hcfg, sizeof(hcfg)) != 0) {
+    fprintf(stderr, "tack: warning: cannot write the remote cache header file; building locally\n");
+    g_remote.down = 1;
+    return;
+  }
 
-  enum { SEC_NONE = 0, SEC_PROJECT = 1, SEC_TARGET = 2 } sec = SEC_NONE;
-  IniTargetCfg *cur_t = 0;
+  pool_init(&pool, g_remote.jobs);
+  for (;;) {
+    while (!pool_full(&pool) && next < n && !g_remote.down) {
+      Argv av;
+      av_init(&av);
+      av_push(&av, "curl");
+      av_push(&av, "-sf");
+      av_push(&av, "--connect-timeout");
+      av_push(&av, g_remote.timeout);
+      av_push(&av, "--max-time");
+      av_push(&av, g_remote.timeout);
+      if (hdir[0]) { av_push(&av, "-K"); av_push(&av, hcfg); }
+      if (put) { av_push(&av, "-T"); av_push(&av, files[next]); av_push(&av, "-o"); av_push(&av, null_dev); }
+      else { av_push(&av, "-o"); av_push(&av, files[next]); }
+      av_push(&av, urls[next]);
+      av_terminate(&av);
+      if (pool_spawn(&pool, av.a, 0, next) != 0) {
+        fprintf(stderr, "tack: warning: remote cache needs curl; building locally\n");
+        g_remote.down = 1;
+      }
+      av_free(&av);
+      next++;
+    }
+    if (pool_wait_any(&pool, &tag, &rc) != 0) break;
+    rcs[tag] = rc;
+    /* 6/7: cannot resolve/connect, 28: timeout, 127: no curl (fork path) */
+    if ((rc == 6 || rc == 7 || rc == 28 || rc == 127) && !g_remote.down) {
+      fprintf(stderr, "tack: warning: remote cache %s unreachable or too slow (curl exit %d); building locally\n",
+              g_remote.url, rc);
+      g_remote.down = 1;
+    }
+  }
+  pool_free(&pool);
+  if (hdir[0] && rm_rf(hdir) != 0) fprintf(stderr, "tack: warning: cannot remove %s\n", hdir);
+  trace_event("cache", what, 0, 0, 0, t0, now_ms(), g_remote.down, 0);
+}
 
-  f = fopen(path, "rb");
-  if (!f) return 1;
+/* write mode: remember a freshly stored object and its manifest for remote_flush */
+static void remote_queue_put(const Hash64 *key, const Hash64 *obj) {
+  char file[1024], url[1100];
+  if (!remote_enabled() || !g_remote.write) return;
+  cache_sub(file, sizeof(file), "o", obj, ".o");
+  remote_url(url, sizeof(url), "o", obj, ".o");
+  sv_push(&g_remote.put_objs, file);
+  sv_push(&g_remote.put_obj_urls, url);
+  cache_sub(file, sizeof(file), "m", key, "");
+  remote_url(url, sizeof(url), "m", key, "");
+  sv_push(&g_remote.put_mans, file);
+  sv_push(&g_remote.put_man_urls, url);
+}
 
-  ini_targets_init();
-  ini_overrides_init();
+/* upload one queue; returns the number of failed transfers */
+static int remote_put_all(StrVec *files, StrVec *urls, const char *what) {
+  int *rcs, i, failed = 0;
+  if (!files->count) return 0;
+  rcs = (int*)xmalloc((size_t)files->count * sizeof(int));
+  remote_batch(urls->items, files->items, rcs, files->count, 1, what);
+  for (i = 0; i < files->count; i++) if (rcs[i] != 0) failed++;
+  free(rcs);
+  return failed;
+}
 
-  while (fgets(line, sizeof(line), f)) {
-    char *s, *eq;
-    lineno++;
+/* end of a build: upload what this run stored; objects first, so a manifest never
+ * names an object the server does not have yet */
+static void remote_flush(int verbose) {
+  int n = g_remote.put_objs.count, failed;
+
+  if (g_remote.enabled && verbose && g_remote.lookups)
+    printf("remote cache: %ld of %ld objects fetched\n", g_remote.hits, g_remote.lookups);
+  g_remote.lookups = g_remote.hits = 0;
+  if (n == 0) return;
+
+  if (remote_enabled()) {
+    failed = remote_put_all(&g_remote.put_objs, &g_remote.put_obj_urls, "remote put objects");
+    if (failed == 0) failed = remote_put_all(&g_remote.put_mans, &g_remote.put_man_urls, "remote put manifests");
+    if (failed) fprintf(stderr, "tack: warning: remote cache: %d uploads failed\n", failed);
+    else if (verbose) printf("remote cache: %d objects uploaded\n", n);
+  }
+  sv_free(&g_remote.put_objs);
+  sv_free(&g_remote.put_obj_urls);
+  sv_free(&g_remote.put_mans);
+  sv_free(&g_remote.put_man_urls);
+}
 
-    /* fail-fast on truncated lines */
-    if (!strchr(line, '\n') && !feof(f)) {
-      int ch;
-      while ((ch = fgetc(f)) != EOF && ch != '\n') { /* discard */ }
-      fclose(f);
-      tack_die("ini line too long");
-    }
+/* --------------------------- distributed compile --------------------------- */
+/* TACK_DIST_HOSTS="host[/slots] ..." (default 4 slots each) ships compiles to other
+ * machines, distcc-style over ssh: the compile becomes a local preprocess job
+ * (-E, which also writes the depfile) and a remote job
+ *   ssh HOST tack worker <cc id> CC <flags minus -I, -D, -M..., -o>  < x.i  > x.o
+ * that needs no local -j slot: remote jobs have their own slots next to -j.
+ * <cc id> hashes the first line of "CC --version"; a worker with a different compiler
+ * refuses the job. TACK_DIST_SSH replaces ssh (called as PROG HOST COMMAND),
+ * TACK_DIST_WORKER the remote tack. Worker exit >= 200 (refused), the remote shell's
+ * 126/127 (no tack there, wrong TACK_DIST_WORKER) or ssh's 255 takes
+ * the host out of the run and reruns the compile locally. tcc is never distributed:
+ * it compiles faster than a round trip.
+ */
 
-    s = line;
-    s = trim(s);
-    if (!s[0]) continue;
-    if (s[0] == ';' || s[0] == '#') continue;
+#define TACK_DIST_MAX_HOSTS 32
 
-    if (s[0] == '[') {
-      char *end = strchr(s, ']');
-      if (!end) continue;
-      *end = '\0';
-      s++;
-      s = trim(s);
+typedef struct {
+  char name[256];
+  int slots;
+  int running;
+  int down;
+} DistHost;
 
-      cur_t = 0;
-      sec = SEC_NONE;
+typedef struct {
+  int decided;
+  int enabled;
+  DistHost hosts[TACK_DIST_MAX_HOSTS];
+  int nhosts;
+  int slots;         /* sum over all hosts (pool size on top of -j) */
+  const char *ssh;
+  const char *worker;
+  char cc_id[17];
+} DistConfig;
+
+static DistConfig g_dist;
+
+/* exit code of a remote job that says nothing about the TU: the host is out, the
+ * compile reruns locally (see the section comment) */
+static int dist_host_failed(int rc) {
+  return rc == 255 || rc >= 200 || rc == 126 || rc == 127;
+}
 
-      if (strieq(s, "project")) {
-        sec = SEC_PROJECT;
-        continue;
-      }
+static int cc_is_tcc(const char *cc);
+static int cc_is_clang(const char *cc);
 
-      if ((tolower((unsigned char)s[0])=='t') && (tolower((unsigned char)s[1])=='a') && (tolower((unsigned char)s[2])=='r') && (tolower((unsigned char)s[3])=='g') && (tolower((unsigned char)s[4])=='e') && (tolower((unsigned char)s[5])=='t')) {
-        char *p;
-        char *tname;
-        size_t tn;
+/* id of a compiler: hash of the first line of "cc --version" (tmp: scratch file) */
+static int cc_version_id(const char *cc, const char *tmp, char *out) {
+  char *argv[3], line[512];
+  Proc p;
+  FILE *f;
+  Hash64 h;
+  size_t n;
+  int rc;
+
+  argv[0] = (char*)cc;
+  argv[1] = (char*)"--version";
+  argv[2] = 0;
+  if (proc_spawn_nowait(argv, tmp, &p) != 0) return 1;
+  rc = proc_wait(&p);
+  f = fopen(tmp, "r");
+  line[0] = '\0';
+  if (f) {
+    if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+    fclose(f);
+  }
+  remove(tmp);
+  n = strlen(line);
+  while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+  if (rc != 0 || n == 0) return 1;
+  h64_init(&h);
+  h64_update(&h, line, n);
+  h64_hex(out, &h);
+  return 0;
+}
 
-        p = s + 6;
-        tname = 0;
-        tn = 0;
-        p = trim(p);
-        if (*p == '"') {
-          char *q = strchr(p + 1, '"');
-          if (!q) continue;
-          tn = (size_t)(q - (p + 1));
-          if (tn > TACK_MAX_NAME) tack_die("target name too long");
-          tname = (char*)xmalloc(tn + 1);
-          memcpy(tname, p + 1, tn);
-          tname[tn] = '\0';
-        } else {
-          tn = strlen(p);
-          if (tn > TACK_MAX_NAME) tack_die("target name too long");
-          tname = xstrdup(p);
-        }
-        cur_t = ini_get_or_add_target(tname);
-        free(tname);
-        continue;
-      }
+static int dist_enabled(const char *cc) {
+  const char *v, *p;
+  char tmp[1024];
 
-      continue;
-    }
+  if (g_dist.decided) return g_dist.enabled;
+  g_dist.decided = 1;
 
-    eq = strchr(s, '=');
-    if (!eq) continue;
-    *eq = '\0';
-    {
-      char *key = trim(s);
-      char *val = trim(eq + 1);
+  v = getenv("TACK_DIST_HOSTS");
+  if (!v || !*v || cc_is_tcc(cc)) return 0;
+  for (p = v; *p;) {
+    DistHost *h;
+    size_t n;
+    const char *sl;
+    while (*p == ' ' || *p == ',' || *p == '\t') p++;
+    n = strcspn(p, " ,\t");
+    if (!n) break;
+    if (g_dist.nhosts == TACK_DIST_MAX_HOSTS || n >= sizeof(h->name)) {
+      fprintf(stderr, "tack: warning: TACK_DIST_HOSTS: too many or too long entries; ignoring the rest\n");
+      break;
+    }
+    h = &g_dist.hosts[g_dist.nhosts++];
+    memcpy(h->name, p, n);
+    h->name[n] = '\0';
+    h->slots = 4;
+    sl = strchr(h->name, '/');
+    if (sl) {
+      h->slots = atoi(sl + 1);
+      h->name[sl - h->name] = '\0';
+      if (h->slots < 1) h->slots = 1;
+    }
+    h->running = h->down = 0;
+    g_dist.slots += h->slots;
+    p += n;
+  }
+  if (!g_dist.nhosts) return 0;
 
-      if (sec == SEC_PROJECT) {
-        if (strieq(key, "default_target")) {
-          free(g_config_default_target);
-          tack_check_len("default_target", val, TACK_MAX_NAME);
-          g_config_default_target = xstrdup(val);
-        } else if (strieq(key, "disable_auto_tools")) {
-          int b;
-          if (parse_bool(val, &b)) g_config_disable_auto_tools = b;
-        }
-        continue;
-      }
+  g_dist.ssh = getenv("TACK_DIST_SSH");
+  if (!g_dist.ssh || !*g_dist.ssh) g_dist.ssh = 0;
+  g_dist.worker = getenv("TACK_DIST_WORKER");
+  if (!g_dist.worker || !*g_dist.worker) g_dist.worker = "tack";
 
-      if (sec == SEC_TARGET && cur_t) {
-        if (strieq(key, "src")) {
-          free(cur_t->src_dir);
-          cur_t->src_dir = xstrdup(val);
-        } else if (strieq(key, "bin")) {
-          free(cur_t->bin_base);
-          cur_t->bin_base = xstrdup(val);
-        } else if (strieq(key, "id")) {
-          free(cur_t->id);
-          cur_t->id = xstrdup(val);
-        } else if (strieq(key, "enabled")) {
-          int b;
-          if (parse_bool(val, &b)) { cur_t->enabled_set = 1; cur_t->enabled = b; }
-        } else if (strieq(key, "remove")) {
-          int b;
-          if (parse_bool(val, &b)) { cur_t->remove_set = 1; cur_t->remove = b; }
-        } else if (strieq(key, "core")) {
-          int b;
-          if (parse_bool(val, &b)) { cur_t->core_set = 1; cur_t->core = b; }
-        } else if (strieq(key, "includes")) {
-          sv_free(&cur_t->includes); sv_init(&cur_t->includes); split_list_tokens(&cur_t->includes, val, 0);
-        } else if (strieq(key, "defines")) {
-          sv_free(&cur_t->defines); sv_init(&cur_t->defines); split_list_tokens(&cur_t->defines, val, 1);
-        } else if (strieq(key, "cflags")) {
-          sv_free(&cur_t->cflags); sv_init(&cur_t->cflags); split_list_tokens(&cur_t->cflags, val, 1);
-        } else if (strieq(key, "ldflags")) {
-          sv_free(&cur_t->ldflags); sv_init(&cur_t->ldflags); split_list_tokens(&cur_t->ldflags, val, 1);
-        } else if (strieq(key, "libs")) {
-          sv_free(&cur_t->libs); sv_init(&cur_t->libs); split_list_tokens(&cur_t->libs, val, 1);
-        }
-      }
-    }
+  ensure_dir(g_build_dir);
+  path_join(tmp, sizeof(tmp), g_build_dir, ".tack_ccver");
+  if (cc_version_id(cc, tmp, g_dist.cc_id) != 0) {
+    fprintf(stderr, "tack: warning: %s --version failed; not distributing compiles\n", cc);
+    return 0;
   }
+  g_dist.enabled = 1;
+  return 1;
+}
 
-  fclose(f);
-  return 0;
+/* host with a free slot and the lowest load, or -1 */
+static int dist_pick_host(void) {
+  int i, best = -1;
+  for (i = 0; i < g_dist.nhosts; i++) {
+    const DistHost *h = &g_dist.hosts[i];
+    if (h->down || h->running >= h->slots) continue;
+    if (best < 0 || h->running * g_dist.hosts[best].slots < g_dist.hosts[best].running * h->slots) best = i;
+  }
+  return best;
 }
 
-/* materialize override arrays from ini target cfg lists */
-static void ini_materialize_overrides(void) {
+static int dist_any_up(void) {
   int i;
-  for (i = 0; i < g_ini_targets.count; i++) {
-    IniTargetCfg *t = &g_ini_targets.items[i];
-    int need = 0;
-    if (t->includes.count) need = 1;
-    if (t->defines.count) need = 1;
-    if (t->cflags.count) need = 1;
-    if (t->ldflags.count) need = 1;
-    if (t->libs.count) need = 1;
-    if (t->core_set) need = 1;
+  for (i = 0; i < g_dist.nhosts; i++) if (!g_dist.hosts[i].down) return 1;
+  return 0;
+}
 
-    if (need) {
-      TargetOverride *ov = ini_get_or_add_override(t->name);
-      if (t->includes.count) ov->includes = (const char * const *)sv_to_strlist_own(&t->includes);
-      if (t->defines.count) ov->defines = (const char * const *)sv_to_strlist_own(&t->defines);
-      if (t->cflags.count) ov->cflags = (const char * const *)sv_to_strlist_own(&t->cflags);
-      if (t->ldflags.count) ov->ldflags = (const char * const *)sv_to_strlist_own(&t->ldflags);
-      if (t->libs.count) ov->libs = (const char * const *)sv_to_strlist_own(&t->libs);
-      if (t->core_set) ov->use_core = t->core ? 1 : 0;
-    }
+/* single-quote for the remote POSIX shell ssh hands the command to */
+static void sb_sh_quote(StrBuf *b, const char *s) {
+  sb_putc(b, '\'');
+  for (; *s; s++) {
+    if (*s == '\'') sb_puts(b, "'\\''");
+    else sb_putc(b, *s);
   }
+  sb_putc(b, '\'');
 }
 
-static void apply_ini_targets(TargetVec *out) {
+/* argv for one remote job on host h: [ssh, (-o BatchMode=yes,) HOST, "tack worker ID CC ARGS"]
+ * (cmd: the worker's compile argv); the caller frees av and the command string */
+static char *dist_argv(Argv *av, int h, char **cmd) {
+  StrBuf b;
   int i;
-  if (!g_config_loaded) return;
 
-  /* ensure overrides are ready */
-  ini_materialize_overrides();
+  sb_init(&b);
+  sb_puts(&b, g_dist.worker);
+  sb_puts(&b, " worker ");
+  sb_puts(&b, g_dist.cc_id);
+  for (i = 0; cmd[i]; i++) {
+    sb_putc(&b, ' ');
+    sb_sh_quote(&b, cmd[i]);
+  }
 
-  for (i = 0; i < g_ini_targets.count; i++) {
-    IniTargetCfg *t = &g_ini_targets.items[i];
-    TargetDef d;
-    memset(&d, 0, sizeof(d));
-    d.name = t->name;
+  av_init(av);
+  if (g_dist.ssh) {
+    av_push(av, g_dist.ssh);
+  } else {
+    av_push(av, "ssh");
+    av_push(av, "-o");
+    av_push(av, "BatchMode=yes"); /* never stop a build for a password prompt */
+  }
+  av_push(av, g_dist.hosts[h].name);
+  av_push(av, b.p);
+  av_terminate(av);
+  return b.p;
+}
 
-    if (t->remove_set && t->remove) {
-      d.remove = 1;
-      tv_apply_targetdef(out, &d);
-      continue;
-    }
+/* stats file: "hits N\nmisses N\nsize N\n" (best effort; concurrent runs may lose counts) */
+static void cache_read_stats(long *hits, long *misses, long *size) {
+  char path[1024], key[32];
+  long v;
+  FILE *f;
 
-    /* action-only enable/disable */
-    if (!t->src_dir && !t->bin_base && !t->id && t->enabled_set) {
-      d.enabled = t->enabled ? 1 : 0;
-      tv_apply_targetdef(out, &d);
-      continue;
-    }
+  *hits = *misses = *size = 0;
+  path_join(path, sizeof(path), g_cache.dir, "stats");
+  f = fopen(path, "r");
+  if (!f) return;
+  while (fscanf(f, "%31s %ld", key, &v) == 2) {
+    if (streq(key, "hits")) *hits = v;
+    else if (streq(key, "misses")) *misses = v;
+    else if (streq(key, "size")) *size = v;
+  }
+  fclose(f);
+}
 
-    /* upsert */
-    d.src_dir = t->src_dir;
-    d.bin_base = t->bin_base;
-    d.id = t->id;
+static void cache_write_stats(long hits, long misses, long size) {
+  char path[1024];
+  FILE *f;
+  ensure_dir(g_cache.dir);
+  path_join(path, sizeof(path), g_cache.dir, "stats");
+  f = fopen(path, "w");
+  if (!f) return;
+  fprintf(f, "hits %ld\nmisses %ld\nsize %ld\n", hits, misses, size);
+  fclose(f);
+}
 
-    /* if enabled not specified, default to 1 for created/updated targets */
-    d.enabled = t->enabled_set ? (t->enabled ? 1 : 0) : 1;
-    d.remove = 0;
+typedef struct { char *path; long mtime; long size; } CacheFile;
 
-    tv_apply_targetdef(out, &d);
+static int cache_file_cmp(const void *a, const void *b) {
+  const CacheFile *x = (const CacheFile*)a, *y = (const CacheFile*)b;
+  if (x->mtime != y->mtime) return x->mtime < y->mtime ? -1 : 1;
+  return strcmp(x->path, y->path);
+}
 
-    /* If target exists and enabled_set was specified, we already applied it.
-     * If enabled_set was not specified and target existed disabled, leave it as-is?
-     * For safety, we keep the existing enabled state in that case.
-     */
-    if (!t->enabled_set) {
-      int idx = tv_find_index_by_name(out, t->name);
-      if (idx >= 0) {
-        /* keep existing enabled state if it was disabled by other config */
-        /* (do nothing) */
-      }
+/* evict least recently used objects down to 90% of the cap; returns the new total size.
+ * o/ is read straight from disk: the cache lives outside the project, so its listing
+ * has no place in build/.tack_scan. */
+static long cache_evict(long cap) {
+  StrVec objs;
+  ScanDir listing;
+  CacheFile *fs;
+  char dir[1024], path[1100];
+  long total = 0;
+  int i;
+
+  sv_init(&objs);
+  memset(&listing, 0, sizeof(listing));
+  sv_init(&listing.names);
+  path_join(dir, sizeof(dir), g_cache.dir, "o");
+  scan_read_dir(&listing, dir);
+  for (i = 0; i < listing.names.count; i++) {
+    if (listing.kinds[i] != SCAN_FILE || !ends_with(listing.names.items[i], ".o")) continue;
+    path_join(path, sizeof(path), dir, listing.names.items[i]);
+    sv_push(&objs, path);
+  }
+  scan_clear_entry(&listing);
+  fs = (CacheFile*)xmalloc((size_t)(objs.count ? objs.count : 1) * sizeof(CacheFile));
+  for (i = 0; i < objs.count; i++) {
+    STAT_ST st;
+    fs[i].path = objs.items[i];
+    fs[i].mtime = 0;
+    fs[i].size = 0;
+    if (STAT_FN(objs.items[i], &st) == 0) { fs[i].mtime = (long)st.st_mtime; fs[i].size = (long)st.st_size; }
+    total += fs[i].size;
+  }
+
+  if (total > cap) {
+    long target = cap / 10 * 9;
+    qsort(fs, (size_t)objs.count, sizeof(CacheFile), cache_file_cmp);
+    for (i = 0; i < objs.count && total > target; i++) {
+      if (remove(fs[i].path) == 0) total -= fs[i].size;
     }
   }
+
+  free(fs);
+  sv_free(&objs);
+  return total;
 }
 
-/* config glue (called from main) */
+/* end of a build: fold counters into the stats file, evict when over the cap */
+static void cache_finish(int verbose) {
+  long hits, misses, size, cap;
 
-/* --------------------------- tackfile.c auto-config (v0.6.0) ---------------------------
+  if (!g_cache.enabled) return;
+  remote_flush(verbose);
+  if (!g_cache.hits && !g_cache.misses) return;
+
+  if (verbose) printf("cache: %ld hits, %ld misses\n", g_cache.hits, g_cache.misses);
+
+  cache_read_stats(&hits, &misses, &size);
+  hits += g_cache.hits;
+  misses += g_cache.misses;
+  size += g_cache.stored_bytes;
+  cap = cache_cap_bytes();
+  if (size > cap) size = cache_evict(cap);
+  cache_write_stats(hits, misses, size);
+
+  g_cache.hits = g_cache.misses = g_cache.stored_bytes = 0;
+}
+
+/* --------------------------- target configuration --------------------------- */
+
+typedef struct {
+  const char *name;                 /* matches CLI target name (e.g. "app" or "tool:foo") */
+  const char * const *includes;     /* extra -I dirs */
+  const char * const *defines;      /* extra -D... */
+  const char * const *cflags;       /* extra compile flags */
+  const char * const *ldflags;      /* extra link flags */
+  const char * const *libs;         /* extra libs/flags, e.g. "-lws2_32" */
+  int use_core;                     /* 1 = link src/core into this target */
+  int unity;                        /* 1 = compile sources in batched unity_N.c chunks */
+  int unity_chunk;                  /* sources per chunk (0 = default) */
+  const char *pch;                  /* header to precompile and -include (0 = none) */
+  const char *linker;               /* -fuse-ld= for its link (0 = [project] linker) */
+} TargetOverride;
+
+/* runtime INI overrides (higher priority than tackfile/built-ins) */
+static const TargetOverride *find_ini_override(const char *name);
+
+typedef struct {
+  const char *name;      /* CLI name (e.g. "app" or "tool:foo") */
+  const char *src_dir;   /* directory to scan recursively for .c files (upsert if non-0) */
+  const char *bin_base;  /* output executable base name (no extension; upsert if non-0) */
+  const char *id;        /* optional filesystem-safe id (upsert if non-0) */
+  int enabled;           /* action-only: if src_dir/bin_base/id are all 0 -> 0 disable, 1 enable */
+  int remove;            /* action: 1 remove target from graph */
+} TargetDef;
+
+/* Optional external configuration:
  *
- * If a file named "tackfile.c" exists in the project root, tack will (by default):
- *   1) compile a tiny generator into build/_tackfile/
- *   2) run it to emit build/_tackfile/tackfile.generated.ini
- *   3) load that INI as a low-priority config layer
+ * tack supports two ways to keep project-specific build setup out of tack.c:
  *
- * Then tack loads tack.ini (or --config <path>) on top, so INI can override tackfile.c.
+ *  A) Runtime tackfile.c (recommended):
+ *     - If a file named "tackfile.c" exists in the project root, tack compiles a tiny
+ *       generator (with your chosen compiler) and runs it to produce:
+ *         build/_tackfile/tackfile.generated.ini
+ *     - That generated INI is loaded as a low-priority config layer (below tack.ini / --config).
+ *     - If compilation or execution fails, tack exits with an error (fail-fast).
  *
- * Important:
- * - If tackfile.c exists but cannot be compiled/executed, tack fails (unless --no-config).
- * - If you compile tack with -DTACK_USE_TACKFILE, this runtime step is skipped.
+ *  B) Compile-time include (legacy / locked-down environments):
+ *     - Build tack with -DTACK_USE_TACKFILE to #include "tackfile.c" directly:
+ *         tcc -DTACK_USE_TACKFILE src/tack.c -o tack.exe
+ *     - When this mode is enabled, the runtime generator is not used.
+ *
+ * In tackfile.c you may define:
+ *
+ *   1) Overrides (includes/defines/cflags/ldflags/libs, core, unity, unity_chunk, pch, linker):
+ *   #define TACKFILE_OVERRIDES my_overrides
+ *      static const TargetOverride my_overrides[] = { ... , { 0,0,0,0,0,0,0,0,0,0,0 } };
+ *
+ *   2) Targets (add/modify/disable/remove):
+ *      #define TACKFILE_TARGETS my_targets
+ *      static const TargetDef my_targets[] = { ... , { 0,0,0,0,0,0 } };
+ *
+ *   3) Default target:
+ *      #define TACKFILE_DEFAULT_TARGET "app"
+ *
+ *   4) Disable auto tool discovery:
+ *      #define TACKFILE_DISABLE_AUTO_TOOLS 1
+ *
+ * Layering (highest wins):
+ *   tack.ini / --config  >  generated tackfile.ini  >  built-ins
  */
 
-#ifndef TACK_USE_TACKFILE
-static char g_tackfile_generated_ini[TACK_MAX_CONFIG_PATH + 1] = {0};
+#ifdef TACK_USE_TACKFILE
+#include "tackfile.c"
+#endif
+
+/* Example overrides (edit as needed) */
+static const char *app_includes[] = { "src", 0 };
+static const char *app_defines[]  = { 0 };
+static const char *app_cflags[]   = { 0 };
+static const char *app_ldflags[]  = { 0 };
+static const char *app_libs[]     = { 0 };
 
+static const TargetOverride g_overrides[] = {
+  /* app: use shared core by default */
+  { "app", app_includes, app_defines, app_cflags, app_ldflags, app_libs, 1, 0, 0, 0, 0 },
 
-static void tackfile_gen_paths(char *dir, size_t dir_cap,
-                               char *gen_c, size_t gen_c_cap,
-                               char *gen_exe, size_t gen_exe_cap,
-                               char *gen_ini, size_t gen_ini_cap) {
-  path_join(dir, dir_cap, g_build_dir, "_tackfile");
-  path_join(gen_c, gen_c_cap, dir, "tackfile_gen.c");
-#ifdef _WIN32
-  path_join(gen_exe, gen_exe_cap, dir, "tackfile_gen.exe");
-#else
-  path_join(gen_exe, gen_exe_cap, dir, "tackfile_gen");
+  /* Example tool override (uncomment when you have tools/foo):
+   * static const char *foo_defines[] = { "TOOL_FOO=1", 0 };
+   * { "tool:foo", 0, foo_defines, 0, 0, 0, 1, 0, 0, 0, 0 },
+   */
+
+  { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+};
+
+static const TargetOverride *find_override(const char *name) {
+  int i;
+  {
+    const TargetOverride *io = find_ini_override(name);
+    if (io) return io;
+  }
+
+#ifdef TACKFILE_OVERRIDES
+  /* user overrides (from tackfile.c) take precedence */
+  for (i = 0; TACKFILE_OVERRIDES[i].name; i++) {
+    if (streq(TACKFILE_OVERRIDES[i].name, name)) return &TACKFILE_OVERRIDES[i];
+  }
 #endif
-  path_join(gen_ini, gen_ini_cap, dir, "tackfile.generated.ini");
+
+  for (i = 0; g_overrides[i].name; i++) {
+    if (streq(g_overrides[i].name, name)) return &g_overrides[i];
+  }
+  return 0;
 }
 
-static int tackfile_write_generator_source(const char *gen_c_path) {
-  /* Keep generator self-contained and C89-friendly. */
-  static const char *lines[] = {
-    "/* auto-generated by tack " TACK_VERSION " */\n",
-    "#include <stdio.h>\n",
-    "#include <stdlib.h>\n",
-    "#include <string.h>\n",
-    "\n",
-    "typedef struct {\n",
-    "  const char *name;\n",
-    "  const char * const *includes;\n",
-    "  const char * const *defines;\n",
-    "  const char * const *cflags;\n",
-    "  const char * const *ldflags;\n",
-    "  const char * const *libs;\n",
-    "  int use_core;\n",
-    "} TargetOverride;\n",
-    "\n",
-    "typedef struct {\n",
-    "  const char *name;\n",
-    "  const char *src_dir;\n",
-    "  const char *bin_base;\n",
-    "  const char *id;\n",
-    "  int enabled;\n",
-    "  int remove;\n",
-    "} TargetDef;\n",
-    "\n",
-    "/* Pull in project config */\n",
-    "#include \"tackfile.c\"\n",
-    "\n",
-    "static void emit_list(FILE *f, const char *key, const char * const *lst) {\n",
-    "  int i;\n",
-    "  if (!lst || !lst[0]) return;\n",
-    "  fputs(key, f); fputs(\" = \", f);\n",
-    "  for (i = 0; lst[i]; i++) {\n",
-    "    if (i) fputc(';', f);\n",
-    "    fputs(lst[i], f);\n",
-    "  }\n",
-    "  fputc('\\n', f);\n",
-    "}\n",
-    "\n",
-    "int main(int argc, char **argv) {\n",
-    "  const char *out = (argc > 1) ? argv[1] : \"tackfile.generated.ini\";\n",
-    "  FILE *f = fopen(out, \"wb\");\n",
-    "  if (!f) return 1;\n",
-    "\n",
-    "  fputs(\"# generated from tackfile.c\\n\\n\", f);\n",
-    "\n",
-    "  /* project */\n",
-    "  fputs(\"[project]\\n\", f);\n",
-    "#ifdef TACKFILE_DEFAULT_TARGET\n",
-    "  fprintf(f, \"default_target = %s\\n\", TACKFILE_DEFAULT_TARGET);\n",
-    "#endif\n",
-    "#ifdef TACKFILE_DISABLE_AUTO_TOOLS\n",
-    "#if TACKFILE_DISABLE_AUTO_TOOLS\n",
-    "  fputs(\"disable_auto_tools = yes\\n\", f);\n",
-    "#endif\n",
-    "#endif\n",
-    "  fputc('\\n', f);\n",
-    "\n",
-    "  /* targets */\n",
-    "#ifdef TACKFILE_TARGETS\n",
-    "  {\n",
-    "    const TargetDef *td = (const TargetDef*)TACKFILE_TARGETS;\n",
-    "    while (td && td->name) {\n",
-    "      fprintf(f, \"[target \\\"%s\\\"]\\n\", td->name);\n",
-    "      if (td->src_dir)  fprintf(f, \"src = %s\\n\", td->src_dir);\n",
-    "      if (td->bin_base) fprintf(f, \"bin = %s\\n\", td->bin_base);\n",
-    "      if (td->id)       fprintf(f, \"id = %s\\n\", td->id);\n",
-    "      if (td->remove) {\n",
-    "        fputs(\"remove = yes\\n\", f);\n",
-    "      } else if (!td->src_dir && !td->bin_base && !td->id) {\n",
-    "        fputs(td->enabled ? \"enabled = yes\\n\" : \"enabled = no\\n\", f);\n",
-    "      }\n",
-    "      fputc('\\n', f);\n",
-    "      td++;\n",
-    "    }\n",
-    "  }\n",
-    "#endif\n",
-    "\n",
-    "  /* overrides (may augment existing [target] sections) */\n",
-    "#ifdef TACKFILE_OVERRIDES\n",
-    "  {\n",
-    "    const TargetOverride *ov = (const TargetOverride*)TACKFILE_OVERRIDES;\n",
-    "    while (ov && ov->name) {\n",
-    "      fprintf(f, \"[target \\\"%s\\\"]\\n\", ov->name);\n",
-    "      fputs(ov->use_core ? \"core = yes\\n\" : \"core = no\\n\", f);\n",
-    "      emit_list(f, \"includes\", ov->includes);\n",
-    "      emit_list(f, \"defines\",  ov->defines);\n",
-    "      emit_list(f, \"cflags\",   ov->cflags);\n",
-    "      emit_list(f, \"ldflags\",  ov->ldflags);\n",
-    "      emit_list(f, \"libs\",     ov->libs);\n",
-    "      fputc('\\n', f);\n",
-    "      ov++;\n",
-    "    }\n",
-    "  }\n",
-    "#endif\n",
-    "\n",
-    "  fclose(f);\n",
-    "  return 0;\n",
-    "}\n",
-    0
-  };
+/* --------------------------- discovered targets --------------------------- */
 
-  FILE *f = fopen(gen_c_path, "wb");
+typedef struct {
+  char *name;     /* CLI name (may contain ':') */
+  char *id;       /* filesystem-safe id */
+  char *src_dir;  /* directory to scan */
+  char *bin_base; /* output base name */
+  int enabled;    /* 1=active, 0=disabled */
+} Target;
+
+typedef struct {
+  Target *items;
+  int count;
+  int cap;
+} TargetVec;
+
+static void tv_init(TargetVec *v) { v->items = 0; v->count = 0; v->cap = 0; }
+
+static void tv_free(TargetVec *v) {
+  int i;
+  for (i = 0; i < v->count; i++) {
+    free(v->items[i].name);
+    free(v->items[i].id);
+    free(v->items[i].src_dir);
+    free(v->items[i].bin_base);
+  }
+  free(v->items);
+  v->items = 0; v->count = 0; v->cap = 0;
+}
+
+static void tv_push(TargetVec *v, const char *name, const char *src_dir, const char *bin_base) {
+  Target *t;
+  char idbuf[256];
+
+  if (v->count + 1 > v->cap) {
+    int ncap = v->cap ? v->cap * 2 : 8;
+    v->items = (Target*)xrealloc(v->items, (size_t)ncap * sizeof(Target));
+    v->cap = ncap;
+  }
+
+  sanitize_name_to_id(idbuf, sizeof(idbuf), name);
+
+  t = &v->items[v->count++];
+  t->name = xstrdup(name);
+  t->id = xstrdup(idbuf);
+  t->src_dir = xstrdup(src_dir);
+  t->bin_base = xstrdup(bin_base);
+  t->enabled = 1;
+}
+
+/* --------------------------- target graph helpers --------------------------- */
+/* Used by tackfile targets (compile-time) and tack.ini targets (runtime). */
+
+static int tv_find_index_by_name(TargetVec *v, const char *name) {
+  int i;
+  for (i = 0; i < v->count; i++) {
+    if (streq(v->items[i].name, name)) return i;
+  }
+  return -1;
+}
+
+static void tv_remove_at(TargetVec *v, int idx) {
+  int i;
+  if (idx < 0 || idx >= v->count) return;
+
+  free(v->items[idx].name);
+  free(v->items[idx].id);
+  free(v->items[idx].src_dir);
+  free(v->items[idx].bin_base);
+
+  for (i = idx + 1; i < v->count; i++) v->items[i - 1] = v->items[i];
+  v->count--;
+}
+
+static void tv_update_at_fields(TargetVec *v, int idx, const TargetDef *d) {
+  if (idx < 0 || idx >= v->count) return;
+
+  if (d->src_dir) {
+    free(v->items[idx].src_dir);
+    v->items[idx].src_dir = xstrdup(d->src_dir);
+  }
+  if (d->bin_base) {
+    free(v->items[idx].bin_base);
+    v->items[idx].bin_base = xstrdup(d->bin_base);
+  }
+  if (d->id) {
+    free(v->items[idx].id);
+    v->items[idx].id = xstrdup(d->id);
+  }
+}
+
+static void tv_apply_targetdef(TargetVec *v, const TargetDef *d) {
+  int idx;
+
+  if (!d || !d->name) return;
+
+    idx = tv_find_index_by_name(v, d->name);
+
+  /* remove wins */
+  if (d->remove) {
+    if (idx >= 0) tv_remove_at(v, idx);
+    return;
+  }
+
+  /* action-only: enable/disable existing */
+  if (!d->src_dir && !d->bin_base && !d->id) {
+    if (idx >= 0) v->items[idx].enabled = d->enabled ? 1 : 0;
+    return;
+  }
+
+  /* upsert */
+  if (idx < 0) {
+    /* create with best-effort defaults, then apply upserts */
+    tv_push(v, d->name, d->src_dir ? d->src_dir : "src", d->bin_base ? d->bin_base : "app");
+    idx = v->count - 1;
+  }
+
+    tv_update_at_fields(v, idx, d);
+
+  /* enabled defaults to 1; if explicitly 0, allow disabling */
+  v->items[idx].enabled = (d->enabled ? 1 : 0);
+}
+
+/* --------------------------- tackfile.c targets --------------------------- */
+#ifdef TACKFILE_TARGETS
+static void apply_tackfile_targets(TargetVec *out) {
   int i;
+  for (i = 0; TACKFILE_TARGETS[i].name; i++) {
+    tv_apply_targetdef(out, &TACKFILE_TARGETS[i]);
+  }
+}
+#else
+static void apply_tackfile_targets(TargetVec *out) { (void)out; }
+#endif
+
+/* --------------------------- tack.ini (INI config) --------------------------- */
+
+typedef struct {
+  char *name; /* target name key */
+  char *src_dir;
+  char *bin_base;
+  char *id;
+  int enabled_set, enabled;
+  int remove_set, remove;
+  int core_set, core;
+  int unity_set, unity;
+  int unity_chunk;       /* 0 = not set */
+  char *pch;
+  char *linker;
+
+  StrVec includes;
+  StrVec defines;
+  StrVec cflags;
+  StrVec ldflags;
+  StrVec libs;
+} IniTargetCfg;
+
+typedef struct {
+  IniTargetCfg *items;
+  int count;
+  int cap;
+} IniTargetVec;
+
+typedef struct {
+  TargetOverride *items;
+  int count;
+  int cap;
+} IniOverrideVec;
+
+static IniTargetVec g_ini_targets;
+static IniOverrideVec g_ini_overrides;
+
+/* target/override names and every list token and list: dropped as a whole by config_reset */
+static Arena g_cfg_arena;
+
+static void ini_targets_init(void) { g_ini_targets.items = 0; g_ini_targets.count = 0; g_ini_targets.cap = 0; }
+static void ini_overrides_init(void) { g_ini_overrides.items = 0; g_ini_overrides.count = 0; g_ini_overrides.cap = 0; }
+
+static void ini_targets_free(void) {
+  int i;
+  for (i = 0; i < g_ini_targets.count; i++) {
+    IniTargetCfg *t = &g_ini_targets.items[i];
+    free(t->src_dir);
+    free(t->bin_base);
+    free(t->id);
+    free(t->pch);
+    free(t->linker);
+    sv_free(&t->includes);
+    sv_free(&t->defines);
+    sv_free(&t->cflags);
+    sv_free(&t->ldflags);
+    sv_free(&t->libs);
+  }
+  free(g_ini_targets.items);
+  g_ini_targets.items = 0; g_ini_targets.count = 0; g_ini_targets.cap = 0;
+}
+
+static void ini_overrides_free(void) {
+  int i;
+  for (i = 0; i < g_ini_overrides.count; i++) {
+    TargetOverride *ov = &g_ini_overrides.items[i];
+    free((char*)ov->pch);
+    free((char*)ov->linker);
+  }
+  free(g_ini_overrides.items);
+  g_ini_overrides.items = 0; g_ini_overrides.count = 0; g_ini_overrides.cap = 0;
+}
+
+/* tiny trimming helpers */
+static char *ltrim(char *s) { while (*s && isspace((unsigned char)*s)) s++; return s; }
+static void rtrim_inplace(char *s) {
+  size_t n = strlen(s);
+  while (n > 0 && isspace((unsigned char)s[n - 1])) { s[n - 1] = '\0'; n--; }
+}
+static char *trim(char *s) { s = ltrim(s); rtrim_inplace(s); return s; }
+
+static int strieq(const char *a, const char *b) {
+  unsigned char ca, cb;
+  while (*a && *b) {
+    ca = (unsigned char)*a++;
+    cb = (unsigned char)*b++;
+    if (tolower(ca) != tolower(cb)) return 0;
+  }
+  return *a == '\0' && *b == '\0';
+}
+
+static int parse_bool(const char *v, int *out) {
+  if (!v) return 0;
+  if (strieq(v, "1") || strieq(v, "yes") || strieq(v, "true") || strieq(v, "on")) { *out = 1; return 1; }
+  if (strieq(v, "0") || strieq(v, "no")  || strieq(v, "false")|| strieq(v, "off")) { *out = 0; return 1; }
+  return 0;
+}
+
+/* linker = mold|lld|gold|bfd: owned copy; anything else warns and keeps the default */
+static const char * const g_linkers[] = { "mold", "lld", "gold", "bfd", 0 };
+
+static char *linker_option(const char *v) {
+  int i;
+  if (!v[0]) return 0;
+  for (i = 0; g_linkers[i]; i++) if (strieq(v, g_linkers[i])) return xstrdup(g_linkers[i]);
+  fprintf(stderr, "tack: warning: linker = %s: expected mold, lld, gold or bfd; using the default\n", v);
+  return 0;
+}
+
+static void split_list_tokens(StrVec *out, const char *v, int ws_sep) {
+  const char *p = v;
+
+  while (p && *p) {
+    const char *q;
+    size_t n;
+
+    /* skip separators and leading whitespace */
+    while (*p && (*p == ';' || isspace((unsigned char)*p))) p++;
+    if (!*p) break;
+
+    /* quoted token: " ... " */
+    if (*p == '"') {
+      p++; /* skip opening quote */
+      q = p;
+      while (*q && *q != '"') q++;
+      if (!*q) tack_die("ini: unterminated quote in list");
+
+      n = (size_t)(q - p);
+      if (n > TACK_MAX_TOKEN) tack_die("ini token too long");
+      if (n) {
+        if (out->count >= TACK_MAX_LIST_ITEMS) tack_die("ini list too long");
+        sv_push_n(out, p, n);
+      }
+
+      p = q + 1; /* skip closing quote */
+      continue;
+    }
+
+    /* unquoted token, trailing whitespace trimmed (leading is already skipped) */
+    q = p;
+    while (*q) {
+      if (*q == ';') break;
+      if (ws_sep && isspace((unsigned char)*q)) break;
+      q++;
+    }
+
+    n = (size_t)(q - p);
+    if (n > TACK_MAX_TOKEN) tack_die("ini token too long");
+    while (n > 0 && isspace((unsigned char)p[n - 1])) n--;
+    if (n) {
+      if (out->count >= TACK_MAX_LIST_ITEMS) tack_die("ini list too long");
+      sv_push_n(out, p, n);
+    }
+
+    p = q;
+  }
+}
+
+static IniTargetCfg *ini_get_or_add_target(const char *name) {
+  int i;
+  for (i = 0; i < g_ini_targets.count; i++) {
+    if (streq(g_ini_targets.items[i].name, name)) return &g_ini_targets.items[i];
+  }
+  if (g_ini_targets.count + 1 > g_ini_targets.cap) {
+    int ncap = g_ini_targets.cap ? g_ini_targets.cap * 2 : 8;
+    g_ini_targets.items = (IniTargetCfg*)xrealloc(g_ini_targets.items, (size_t)ncap * sizeof(IniTargetCfg));
+    g_ini_targets.cap = ncap;
+  }
+  {
+    IniTargetCfg *t = &g_ini_targets.items[g_ini_targets.count++];
+    memset(t, 0, sizeof(*t));
+    t->name = arena_strdup(&g_cfg_arena, name);
+    sv_init_arena(&t->includes, &g_cfg_arena);
+    sv_init_arena(&t->defines, &g_cfg_arena);
+    sv_init_arena(&t->cflags, &g_cfg_arena);
+    sv_init_arena(&t->ldflags, &g_cfg_arena);
+    sv_init_arena(&t->libs, &g_cfg_arena);
+    t->enabled_set = 0; t->enabled = 1;
+    t->remove_set = 0; t->remove = 0;
+    t->core_set = 0; t->core = 0;
+    t->unity_set = 0; t->unity = 0;
+    t->unity_chunk = 0;
+    return t;
+  }
+}
+
+/* 0-terminated list in v's arena, sharing its strings; v is left empty */
+static char **sv_to_arena_list(StrVec *v) {
+  char **lst;
+  int i;
+  lst = (char**)arena_alloc(v->arena, (size_t)(v->count + 1) * sizeof(char*));
+  for (i = 0; i < v->count; i++) lst[i] = v->items[i];
+  lst[v->count] = 0;
+  sv_free(v);
+  return lst;
+}
+
+static TargetOverride *ini_get_or_add_override(const char *name) {
+  int i;
+  for (i = 0; i < g_ini_overrides.count; i++) {
+    if (streq(g_ini_overrides.items[i].name, name)) return &g_ini_overrides.items[i];
+  }
+  if (g_ini_overrides.count + 1 > g_ini_overrides.cap) {
+    int ncap = g_ini_overrides.cap ? g_ini_overrides.cap * 2 : 8;
+    g_ini_overrides.items = (TargetOverride*)xrealloc(g_ini_overrides.items, (size_t)ncap * sizeof(TargetOverride));
+    g_ini_overrides.cap = ncap;
+  }
+  {
+    TargetOverride *ov = &g_ini_overrides.items[g_ini_overrides.count++];
+    memset(ov, 0, sizeof(*ov));
+    ov->name = arena_strdup(&g_cfg_arena, name);
+    ov->includes = 0;
+    ov->defines = 0;
+    ov->cflags = 0;
+    ov->ldflags = 0;
+    ov->libs = 0;
+    ov->use_core = 0;
+    ov->unity = 0;
+    ov->unity_chunk = 0;
+    ov->pch = 0;
+    ov->linker = 0;
+    return ov;
+  }
+}
+
+/* INI override lookup (used by find_override) */
+static const TargetOverride *find_ini_override(const char *name) {
+  int i;
+  for (i = 0; i < g_ini_overrides.count; i++) {
+    if (streq(g_ini_overrides.items[i].name, name)) return &g_ini_overrides.items[i];
+  }
+  return 0;
+}
+
+static int parse_int(const char *s);
+static int parse_jobs(const char *s);
+static int cpu_count(void);
+static Profile parse_profile(int *argi, int argc, char **argv);
+
+/* read tack.ini into g_ini_targets/g_ini_overrides + project globals */
+static int ini_load_file(const char *path) {
+  FILE *f;
+  char line[TACK_MAX_LINE];
+  int lineno = 0;
+
+  enum { SEC_NONE = 0, SEC_PROJECT = 1, SEC_TARGET = 2 } sec = SEC_NONE;
+  IniTargetCfg *cur_t = 0;
+
+  f = fopen(path, "rb");
+  if (!f) return 1;
+
+  ini_targets_init();
+  ini_overrides_init();
+
+  while (fgets(line, sizeof(line), f)) {
+    char *s, *eq;
+    lineno++;
+
+    /* fail-fast on truncated lines */
+    if (!strchr(line, '\n') && !feof(f)) {
+      int ch;
+      while ((ch = fgetc(f)) != EOF && ch != '\n') { /* discard */ }
+      fclose(f);
+      tack_die("ini line too long");
+    }
+
+    s = line;
+    s = trim(s);
+    if (!s[0]) continue;
+    if (s[0] == ';' || s[0] == '#') continue;
+
+    if (s[0] == '[') {
+      char *end = strchr(s, ']');
+      if (!end) continue;
+      *end = '\0';
+      s++;
+      s = trim(s);
+
+      cur_t = 0;
+      sec = SEC_NONE;
+
+      if (strieq(s, "project")) {
+        sec = SEC_PROJECT;
+        continue;
+      }
+
+      if ((tolower((unsigned char)s[0])=='t') && (tolower((unsigned char)s[1])=='a') && (tolower((unsigned char)s[2])=='r') && (tolower((unsigned char)s[3])=='g') && (tolower((unsigned char)s[4])=='e') && (tolower((unsigned char)s[5])=='t')) {
+        char *p;
+        char *tname;
+        size_t tn;
+
+        p = s + 6;
+        tname = 0;
+        tn = 0;
+        p = trim(p);
+        if (*p == '"') {
+          char *q = strchr(p + 1, '"');
+          if (!q) continue;
+          tn = (size_t)(q - (p + 1));
+          if (tn > TACK_MAX_NAME) tack_die("target name too long");
+          tname = (char*)xmalloc(tn + 1);
+          memcpy(tname, p + 1, tn);
+          tname[tn] = '\0';
+        } else {
+          tn = strlen(p);
+          if (tn > TACK_MAX_NAME) tack_die("target name too long");
+          tname = xstrdup(p);
+        }
+        cur_t = ini_get_or_add_target(tname);
+        sec = SEC_TARGET;
+        free(tname);
+        continue;
+      }
+
+      continue;
+    }
+
+    eq = strchr(s, '=');
+    if (!eq) continue;
+    *eq = '\0';
+    {
+      char *key = trim(s);
+      char *val = trim(eq + 1);
+
+      if (sec == SEC_PROJECT) {
+        if (strieq(key, "default_target")) {
+          free(g_config_default_target);
+          tack_check_len("default_target", val, TACK_MAX_NAME);
+          g_config_default_target = xstrdup(val);
+        } else if (strieq(key, "disable_auto_tools")) {
+          int b;
+          if (parse_bool(val, &b)) g_config_disable_auto_tools = b;
+        } else if (strieq(key, "core_archive")) {
+          int b;
+          if (parse_bool(val, &b)) g_config_core_archive = b;
+        } else if (strieq(key, "core_pch")) {
+          free(g_config_core_pch);
+          tack_check_len("core_pch", val, TACK_MAX_NAME);
+          g_config_core_pch = val[0] ? xstrdup(val) : 0;
+        } else if (strieq(key, "compdb")) {
+          int b;
+          if (parse_bool(val, &b)) g_config_compdb = b;
+        } else if (strieq(key, "direct")) {
+          int b;
+          if (parse_bool(val, &b)) g_config_direct = b;
+        } else if (strieq(key, "test_env")) {
+          free(g_config_test_env);
+          g_config_test_env = xstrdup(val);
+        } else if (strieq(key, "test_data")) {
+          free(g_config_test_data);
+          g_config_test_data = xstrdup(val);
+        } else if (strieq(key, "pgo_train")) {
+          free(g_config_pgo_train);
+          g_config_pgo_train = val[0] ? xstrdup(val) : 0;
+        } else if (strieq(key, "linker")) {
+          free(g_config_linker);
+          g_config_linker = linker_option(val);
+        } else if (strieq(key, "split_dwarf")) {
+          int b;
+          if (parse_bool(val, &b)) g_config_split_dwarf = b;
+        }
+        continue;
+      }
+
+      if (sec == SEC_TARGET && cur_t) {
+        if (strieq(key, "src")) {
+          free(cur_t->src_dir);
+          cur_t->src_dir = xstrdup(val);
+        } else if (strieq(key, "bin")) {
+          free(cur_t->bin_base);
+          cur_t->bin_base = xstrdup(val);
+        } else if (strieq(key, "id")) {
+          free(cur_t->id);
+          cur_t->id = xstrdup(val);
+        } else if (strieq(key, "enabled")) {
+          int b;
+          if (parse_bool(val, &b)) { cur_t->enabled_set = 1; cur_t->enabled = b; }
+        } else if (strieq(key, "remove")) {
+          int b;
+          if (parse_bool(val, &b)) { cur_t->remove_set = 1; cur_t->remove = b; }
+        } else if (strieq(key, "core")) {
+          int b;
+          if (parse_bool(val, &b)) { cur_t->core_set = 1; cur_t->core = b; }
+        } else if (strieq(key, "unity")) {
+          int b;
+          if (parse_bool(val, &b)) { cur_t->unity_set = 1; cur_t->unity = b; }
+        } else if (strieq(key, "unity_chunk")) {
+          int v = parse_int(val);
+          if (v > 0) cur_t->unity_chunk = v;
+        } else if (strieq(key, "pch")) {
+          free(cur_t->pch);
+          tack_check_len("pch", val, TACK_MAX_NAME);
+          cur_t->pch = val[0] ? xstrdup(val) : 0;
+        } else if (strieq(key, "linker")) {
+          free(cur_t->linker);
+          cur_t->linker = linker_option(val);
+        } else if (strieq(key, "includes")) {
+          sv_free(&cur_t->includes); split_list_tokens(&cur_t->includes, val, 0);
+        } else if (strieq(key, "defines")) {
+          sv_free(&cur_t->defines); split_list_tokens(&cur_t->defines, val, 1);
+        } else if (strieq(key, "cflags")) {
+          sv_free(&cur_t->cflags); split_list_tokens(&cur_t->cflags, val, 1);
+        } else if (strieq(key, "ldflags")) {
+          sv_free(&cur_t->ldflags); split_list_tokens(&cur_t->ldflags, val, 1);
+        } else if (strieq(key, "libs")) {
+          sv_free(&cur_t->libs); split_list_tokens(&cur_t->libs, val, 1);
+        }
+      }
+    }
+  }
+
+  fclose(f);
+  return 0;
+}
+
+/* materialize override arrays from ini target cfg lists */
+static void ini_materialize_overrides(void) {
+  int i;
+  for (i = 0; i < g_ini_targets.count; i++) {
+    IniTargetCfg *t = &g_ini_targets.items[i];
+    int need = 0;
+    if (t->includes.count) need = 1;
+    if (t->defines.count) need = 1;
+    if (t->cflags.count) need = 1;
+    if (t->ldflags.count) need = 1;
+    if (t->libs.count) need = 1;
+    if (t->core_set) need = 1;
+    if (t->unity_set || t->unity_chunk) need = 1;
+    if (t->pch) need = 1;
+    if (t->linker) need = 1;
+
+    if (need) {
+      TargetOverride *ov = ini_get_or_add_override(t->name);
+      if (t->includes.count) ov->includes = (const char * const *)sv_to_arena_list(&t->includes);
+      if (t->defines.count) ov->defines = (const char * const *)sv_to_arena_list(&t->defines);
+      if (t->cflags.count) ov->cflags = (const char * const *)sv_to_arena_list(&t->cflags);
+      if (t->ldflags.count) ov->ldflags = (const char * const *)sv_to_arena_list(&t->ldflags);
+      if (t->libs.count) ov->libs = (const char * const *)sv_to_arena_list(&t->libs);
+      if (t->core_set) ov->use_core = t->core ? 1 : 0;
+      if (t->unity_set) ov->unity = t->unity ? 1 : 0;
+      if (t->unity_chunk) ov->unity_chunk = t->unity_chunk;
+      if (t->pch) {
+        free((char*)ov->pch);
+        ov->pch = t->pch; /* transfer */
+        t->pch = 0;
+      }
+      if (t->linker) {
+        free((char*)ov->linker);
+        ov->linker = t->linker; /* transfer */
+        t->linker = 0;
+      }
+    }
+  }
+}
+
+static void apply_ini_targets(TargetVec *out) {
+  int i;
+  if (!g_config_loaded) return;
+
+  /* ensure overrides are ready */
+  ini_materialize_overrides();
+
+  for (i = 0; i < g_ini_targets.count; i++) {
+    IniTargetCfg *t = &g_ini_targets.items[i];
+    TargetDef d;
+    memset(&d, 0, sizeof(d));
+    d.name = t->name;
+
+    if (t->remove_set && t->remove) {
+      d.remove = 1;
+      tv_apply_targetdef(out, &d);
+      continue;
+    }
+
+    /* action-only enable/disable */
+    if (!t->src_dir && !t->bin_base && !t->id && t->enabled_set) {
+      d.enabled = t->enabled ? 1 : 0;
+      tv_apply_targetdef(out, &d);
+      continue;
+    }
+
+    /* upsert */
+    d.src_dir = t->src_dir;
+    d.bin_base = t->bin_base;
+    d.id = t->id;
+
+    /* if enabled not specified, default to 1 for created/updated targets */
+    d.enabled = t->enabled_set ? (t->enabled ? 1 : 0) : 1;
+    d.remove = 0;
+
+    tv_apply_targetdef(out, &d);
+
+    /* If target exists and enabled_set was specified, we already applied it.
+     * If enabled_set was not specified and target existed disabled, leave it as-is?
+     * For safety, we keep the existing enabled state in that case.
+     */
+    if (!t->enabled_set) {
+      int idx = tv_find_index_by_name(out, t->name);
+      if (idx >= 0) {
+        /* keep existing enabled state if it was disabled by other config */
+        /* (do nothing) */
+      }
+    }
+  }
+}
+
+/* config glue (called from main) */
+
+/* --------------------------- tackfile.c auto-config (v0.6.0) ---------------------------
+ *
+ * If a file named "tackfile.c" exists in the project root, tack will (by default):
+ *   1) compile a tiny generator into build/_tackfile/
+ *   2) run it to emit build/_tackfile/tackfile.generated.ini
+ *   3) load that INI as a low-priority config layer
+ *
+ * Then tack loads tack.ini (or --config <path>) on top, so INI can override tackfile.c.
+ *
+ * Important:
+ * - If tackfile.c exists but cannot be compiled/executed, tack fails (unless --no-config).
+ * - If you compile tack with -DTACK_USE_TACKFILE, this runtime step is skipped.
+ */
+
+#ifndef TACK_USE_TACKFILE
+static char g_tackfile_generated_ini[TACK_MAX_CONFIG_PATH + 1] = {0};
+
+
+static void tackfile_gen_paths(char *dir, size_t dir_cap,
+                               char *gen_c, size_t gen_c_cap,
+                               char *gen_exe, size_t gen_exe_cap,
+                               char *gen_ini, size_t gen_ini_cap) {
+  path_join(dir, dir_cap, g_build_dir, "_tackfile");
+  path_join(gen_c, gen_c_cap, dir, "tackfile_gen.c");
+#ifdef _WIN32
+  path_join(gen_exe, gen_exe_cap, dir, "tackfile_gen.exe");
+#else
+  path_join(gen_exe, gen_exe_cap, dir, "tackfile_gen");
+#endif
+  path_join(gen_ini, gen_ini_cap, dir, "tackfile.generated.ini");
+}
+
+static int tackfile_write_generator_source(const char *gen_c_path) {
+  /* Keep generator self-contained and C89-friendly. */
+  static const char *lines[] = {
+    "/* auto-generated by tack " TACK_VERSION " */\n",
+    "#include <stdio.h>\n",
+    "#include <stdlib.h>\n",
+    "#include <string.h>\n",
+    "\n",
+    "typedef struct {\n",
+    "  const char *name;\n",
+    "  const char * const *includes;\n",
+    "  const char * const *defines;\n",
+    "  const char * const *cflags;\n",
+    "  const char * const *ldflags;\n",
+    "  const char * const *libs;\n",
+    "  int use_core;\n",
+    "  int unity;\n",
+    "  int unity_chunk;\n",
+    "  const char *pch;\n",
+    "  const char *linker;\n",
+    "} TargetOverride;\n",
+    "\n",
+    "typedef struct {\n",
+    "  const char *name;\n",
+    "  const char *src_dir;\n",
+    "  const char *bin_base;\n",
+    "  const char *id;\n",
+    "  int enabled;\n",
+    "  int remove;\n",
+    "} TargetDef;\n",
+    "\n",
+    "/* Pull in project config */\n",
+    "#include \"tackfile.c\"\n",
+    "\n",
+    "static void emit_list(FILE *f, const char *key, const char * const *lst) {\n",
+    "  int i;\n",
+    "  if (!lst || !lst[0]) return;\n",
+    "  fputs(key, f); fputs(\" = \", f);\n",
+    "  for (i = 0; lst[i]; i++) {\n",
+    "    if (i) fputc(';', f);\n",
+    "    fputs(lst[i], f);\n",
+    "  }\n",
+    "  fputc('\\n', f);\n",
+    "}\n",
+    "\n",
+    "int main(int argc, char **argv) {\n",
+    "  const char *out = (argc > 1) ? argv[1] : \"tackfile.generated.ini\";\n",
+    "  FILE *f = fopen(out, \"wb\");\n",
+    "  if (!f) return 1;\n",
+    "\n",
+    "  fputs(\"# generated from tackfile.c\\n\\n\", f);\n",
+    "\n",
+    "  /* project */\n",
+    "  fputs(\"[project]\\n\", f);\n",
+    "#ifdef TACKFILE_DEFAULT_TARGET\n",
+    "  fprintf(f, \"default_target = %s\\n\", TACKFILE_DEFAULT_TARGET);\n",
+    "#endif\n",
+    "#ifdef TACKFILE_DISABLE_AUTO_TOOLS\n",
+    "#if TACKFILE_DISABLE_AUTO_TOOLS\n",
+    "  fputs(\"disable_auto_tools = yes\\n\", f);\n",
+    "#endif\n",
+    "#endif\n",
+    "  fputc('\\n', f);\n",
+    "\n",
+    "  /* targets */\n",
+    "#ifdef TACKFILE_TARGETS\n",
+    "  {\n",
+    "    const TargetDef *td = (const TargetDef*)TACKFILE_TARGETS;\n",
+    "    while (td && td->name) {\n",
+    "      fprintf(f, \"[target \\\"%s\\\"]\\n\", td->name);\n",
+    "      if (td->src_dir)  fprintf(f, \"src = %s\\n\", td->src_dir);\n",
+    "      if (td->bin_base) fprintf(f, \"bin = %s\\n\", td->bin_base);\n",
+    "      if (td->id)       fprintf(f, \"id = %s\\n\", td->id);\n",
+    "      if (td->remove) {\n",
+    "        fputs(\"remove = yes\\n\", f);\n",
+    "      } else if (!td->src_dir && !td->bin_base && !td->id) {\n",
+    "        fputs(td->enabled ? \"enabled = yes\\n\" : \"enabled = no\\n\", f);\n",
+    "      }\n",
+    "      fputc('\\n', f);\n",
+    "      td++;\n",
+    "    }\n",
+    "  }\n",
+    "#endif\n",
+    "\n",
+    "  /* overrides (may augment existing [target] sections) */\n",
+    "#ifdef TACKFILE_OVERRIDES\n",
+    "  {\n",
+    "    const TargetOverride *ov = (const TargetOverride*)TACKFILE_OVERRIDES;\n",
+    "    while (ov && ov->name) {\n",
+    "      fprintf(f, \"[target \\\"%s\\\"]\\n\", ov->name);\n",
+    "      fputs(ov->use_core ? \"core = yes\\n\" : \"core = no\\n\", f);\n",
+    "      if (ov->unity) fputs(\"unity = yes\\n\", f);\n",
+    "      if (ov->unity_chunk > 0) fprintf(f, \"unity_chunk = %d\\n\", ov->unity_chunk);\n",
+    "      if (ov->pch) fprintf(f, \"pch = %s\\n\", ov->pch);\n",
+    "      if (ov->linker) fprintf(f, \"linker = %s\\n\", ov->linker);\n",
+    "      emit_list(f, \"includes\", ov->includes);\n",
+    "      emit_list(f, \"defines\",  ov->defines);\n",
+    "      emit_list(f, \"cflags\",   ov->cflags);\n",
+    "      emit_list(f, \"ldflags\",  ov->ldflags);\n",
+    "      emit_list(f, \"libs\",     ov->libs);\n",
+    "      fputc('\\n', f);\n",
+    "      ov++;\n",
+    "    }\n",
+    "  }\n",
+    "#endif\n",
+    "\n",
+    "  fclose(f);\n",
+    "  return 0;\n",
+    "}\n",
+    0
+  };
+
+  FILE *f = fopen(gen_c_path, "wb");
+  int i;
+
+  if (!f) return 1;
+  for (i = 0; lines[i]; i++) fputs(lines[i], f);
+  fclose(f);
+  return 0;
+}
+
+static int tackfile_prepare_generated_ini(void) {
+  const char *cc;
+  char dir[512], gen_c[512], gen_exe[512], gen_ini[512];
+  long tf_t;
+
+  if (!file_exists("tackfile.c")) return 0;
+
+  cc = get_cc();
+  tf_t = file_mtime("tackfile.c");
+
+  ensure_dir(g_build_dir);
+  path_join(dir, sizeof(dir), g_build_dir, "_tackfile");
+  ensure_dir(dir);
+
+  tackfile_gen_paths(dir, sizeof(dir), gen_c, sizeof(gen_c), gen_exe, sizeof(gen_exe), gen_ini, sizeof(gen_ini));
+
+  strncpy(g_tackfile_generated_ini, gen_ini, sizeof(g_tackfile_generated_ini) - 1);
+  g_tackfile_generated_ini[sizeof(g_tackfile_generated_ini) - 1] = '\0';
+
+  /* cache: if generated ini is newer than tackfile.c, reuse */
+  if (file_exists(gen_ini) && file_mtime(gen_ini) >= tf_t) return 0;
+
+  if (tackfile_write_generator_source(gen_c) != 0) {
+    fprintf(stderr, "tack: tackfile.c: cannot write generator source\n");
+    return 1;
+  }
+
+  /* compile generator */
+  {
+    Argv av;
+    int rc;
+
+    av_init(&av);
+    av_push(&av, cc);
+    av_push(&av, "-I"); av_push(&av, ".");         /* to find tackfile.c */
+    av_push(&av, "-I"); av_push(&av, g_inc_dir);   /* allow includes */
+    av_push(&av, "-o"); av_push(&av, gen_exe);
+    av_push(&av, gen_c);
+    av_terminate(&av);
+
+    rc = run_argv_wait(av.a, 0, "tackfile.c (compile)");
+    if (rc != 0) {
+      fprintf(stderr, "tack: tackfile.c: compile failed\n");
+      print_argv(av.a);
+      av_free(&av);
+      return 1;
+    }
+    av_free(&av);
+  }
+
+  /* run generator */
+  {
+    char *runv[3];
+    int rc;
+
+    runv[0] = gen_exe;
+    runv[1] = gen_ini;
+    runv[2] = 0;
+
+    rc = run_argv_wait(runv, 0, "tackfile.c (run)");
+    stat_cache_forget(gen_ini);
+    if (rc != 0) {
+      fprintf(stderr, "tack: tackfile.c: generator failed\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
+#endif /* !TACK_USE_TACKFILE */
+
+static void config_reset(void) {
+  /* reset INI state and project globals for layered loads */
+  free(g_config_default_target);
+  g_config_default_target = 0;
+  g_config_disable_auto_tools = 0;
+  g_config_core_archive = 0;
+  free(g_config_core_pch);
+  g_config_core_pch = 0;
+  g_config_direct = 0;
+  g_config_compdb = 0;
+  free(g_config_test_env);
+  g_config_test_env = 0;
+  free(g_config_test_data);
+  g_config_test_data = 0;
+  free(g_config_pgo_train);
+  g_config_pgo_train = 0;
+  free(g_config_linker);
+  g_config_linker = 0;
+  g_config_split_dwarf = 0;
+
+  ini_targets_free();
+  ini_overrides_free();
+  ini_targets_init();
+  ini_overrides_init();
+  arena_reset(&g_cfg_arena);
+
+  g_config_loaded = 0;
+  g_config_path[0] = '\0';
+}
+
+static int config_add_ini_layer(const char *path) {
+  if (!path || !path[0]) return 0;
+  if (ini_load_file(path) != 0) return 1;
+
+  /* record last loaded path (highest priority) */
+  tack_check_len("config path", path, TACK_MAX_CONFIG_PATH);
+  tack_copy(g_config_path, sizeof(g_config_path), path);
+  g_config_loaded = 1;
+  return 0;
+}
+
+static int config_auto_load(void) {
+  if (g_no_config) return 0;
+
+  config_reset();
+
+#ifndef TACK_USE_TACKFILE
+  /* low-priority layer: tackfile.c (compiled on the fly) */
+  if (!g_no_code_config && file_exists("tackfile.c")) {
+    if (tackfile_prepare_generated_ini() != 0) return 1;
+    if (g_tackfile_generated_ini[0]) {
+      if (config_add_ini_layer(g_tackfile_generated_ini) != 0) return 1;
+    }
+  }
+#endif
+
+  /* high-priority layer: explicit --config, otherwise tack.ini */
+  if (g_config_path_cli && g_config_path_cli[0]) {
+    if (config_add_ini_layer(g_config_path_cli) != 0) return 1;
+  } else if (file_exists("tack.ini")) {
+    if (config_add_ini_layer("tack.ini") != 0) return 1;
+  }
+
+  /* finally build override list */
+  ini_materialize_overrides();
+  return 0;
+}
+
+static void config_free(void) {
+  ini_targets_free();
+  ini_overrides_free();
+  arena_free(&g_cfg_arena);
+  free(g_config_default_target);
+  g_config_default_target = 0;
+  g_config_core_archive = 0;
+  free(g_config_core_pch);
+  g_config_core_pch = 0;
+  g_config_direct = 0;
+  g_config_compdb = 0;
+  free(g_config_test_env);
+  g_config_test_env = 0;
+  free(g_config_test_data);
+  g_config_test_data = 0;
+  free(g_config_pgo_train);
+  g_config_pgo_train = 0;
+  free(g_config_linker);
+  g_config_linker = 0;
+  g_config_split_dwarf = 0;
+  g_config_loaded = 0;
+  g_config_path[0] = '\0';
+}
+
+
+static const Target *find_target(TargetVec *v, const char *name_or_id) {
+  int i;
+  for (i = 0; i < v->count; i++) {
+    if (!v->items[i].enabled) continue;
+    if (streq(v->items[i].name, name_or_id)) return &v->items[i];
+    if (streq(v->items[i].id, name_or_id)) return &v->items[i];
+  }
+  return 0;
+}
+
+static void discover_targets(TargetVec *out, int disable_auto_tools) {
+  /* app: prefer src/app if it exists, otherwise src */
+  if (file_exists(g_app_dir) && is_dir_path(g_app_dir)) {
+    tv_push(out, "app", g_app_dir, "app");
+  } else {
+    tv_push(out, "app", g_src_dir, "app");
+  }
+
+#ifdef TACKFILE_DISABLE_AUTO_TOOLS
+  disable_auto_tools = 1;
+#endif
+
+  /* tools/<name> */
+  if (!disable_auto_tools) {
+  if (file_exists(g_tools_dir) && is_dir_path(g_tools_dir)) {
+
+#ifdef _WIN32
+  {
+    char pattern[1024];
+    WIN32_FIND_DATAA fd;
+    HANDLE h;
+
+    tack_copy(pattern, sizeof(pattern), g_tools_dir);
+    {
+      size_t ld = strlen(pattern);
+      if (ld > 0 && pattern[ld - 1] != '\\' && pattern[ld - 1] != '/') {
+        pattern[ld] = '\\';
+        pattern[ld + 1] = '\0';
+      }
+    }
+    tack_cat(pattern, sizeof(pattern), "*");
+
+    h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return;
+
+    do {
+      if (streq(fd.cFileName, ".") || streq(fd.cFileName, "..")) continue;
+      if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        char name[256];
+        char *src;
+        char *tname;
+        size_t n;
+
+        tack_copy(name, sizeof(name), fd.cFileName);
+
+        src = path_join_alloc(g_tools_dir, name);
+
+        n = strlen("tool:") + strlen(name) + 1;
+        tname = (char*)xmalloc(n);
+        tack_copy(tname, n, "tool:");
+        tack_cat(tname, n, name);
+
+        tv_push(out, tname, src, name);
+
+        free(tname);
+        free(src);
+      }
+    } while (FindNextFileA(h, &fd));
+
+    FindClose(h);
+  }
+#else
+  {
+    DIR *d;
+    struct dirent *e;
+
+    d = opendir(g_tools_dir);
+    if (!d) return;
+
+    while ((e = readdir(d)) != 0) {
+      char *full;
+      if (streq(e->d_name, ".") || streq(e->d_name, "..")) continue;
+      full = path_join_alloc(g_tools_dir, e->d_name);
+      if (is_dir_path(full)) {
+        char *tname;
+        size_t n;
+        n = strlen("tool:") + strlen(e->d_name) + 1;
+        tname = (char*)xmalloc(n);
+        tack_copy(tname, n, "tool:");
+        tack_cat(tname, n, e->d_name);
+        tv_push(out, tname, full, e->d_name);
+        free(tname);
+    }
+      free(full);
+  }
+    closedir(d);
+  }
+#endif
+}
+  }
+}
+
+/* --------------------------- build paths --------------------------- */
+
+/* build/<target>/<profile>/{obj,dep,bin} */
+static void build_paths(char *root, size_t root_cap,
+                        char *objd, size_t objd_cap,
+                        char *depd, size_t depd_cap,
+                        char *bind, size_t bind_cap,
+                        const char *target_id, Profile p) {
+  char tdir[512];
+  char pdir[512];
+
+  path_join(tdir, sizeof(tdir), g_build_dir, target_id);
+  path_join(pdir, sizeof(pdir), tdir, profile_name(p));
+
+  tack_copy(root, root_cap, pdir);
+  path_join(objd, objd_cap, root, "obj");
+  path_join(depd, depd_cap, root, "dep");
+  path_join(bind, bind_cap, root, "bin");
+}
+
+static void exe_path(char *out, size_t out_cap, const char *target_id, Profile p, const char *bin_base) {
+  char root[512], objd[512], depd[512], bind[512];
+  char fn[256];
+
+  build_paths(root, sizeof(root),
+              objd, sizeof(objd),
+              depd, sizeof(depd),
+              bind, sizeof(bind),
+              target_id, p);
+
+#ifdef _WIN32
+  tack_copy(fn, sizeof(fn), bin_base);
+  tack_cat(fn, sizeof(fn), ".exe");
+#else
+  tack_copy(fn, sizeof(fn), bin_base);
+#endif
+  path_join(out, out_cap, bind, fn);
+}
+
+/* --------------------------- compilation helpers --------------------------- */
+
+/* release-pgo state: build/pgo/raw collects the training run, build/pgo/<hash>/
+ * holds the merged profile. The hash is part of every -fprofile-use flag, so a
+ * new profile changes the compile signature (and cache key) of the final objects.
+ */
+typedef struct {
+  int loaded;            /* build/pgo/current read */
+  char cur[17];          /* merged profile in use, "" = none */
+  char train[17];        /* signature of the instrumented build it was trained on */
+  char gen_flag[1100];   /* -fprofile-generate=<abs raw dir> */
+  char use_flag[1100];   /* -fprofile-use=<abs profile> */
+  int use_cc_clang;      /* use_flag was built for clang (a .profdata file) */
+  int warned;
+  const TargetVec *tv;   /* the project's targets: the enabled ones are the training set */
+} PgoState;
+
+static PgoState g_pgo;
+
+/* <cwd>/build/pgo[/sub]: absolute, the instrumented binaries may chdir */
+static void pgo_path(char *out, size_t cap, const char *sub) {
+  char cwd[1024], tmp[1024];
+#ifdef _WIN32
+  if (!_getcwd(cwd, (int)sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#else
+  if (!getcwd(cwd, sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#endif
+  path_join(tmp, sizeof(tmp), cwd, g_build_dir);
+  path_join(out, cap, tmp, "pgo");
+  if (sub) {
+    tack_copy(tmp, sizeof(tmp), out);
+    path_join(out, cap, tmp, sub);
+  }
+}
+
+/* build/pgo/current: "<profile hash> <training signature>" of the last merge */
+static void pgo_load(void) {
+  char path[1100], line[64];
+  FILE *f;
+
+  if (g_pgo.loaded) return;
+  g_pgo.loaded = 1;
+  pgo_path(path, sizeof(path), "current");
+  f = fopen(path, "rb");
+  if (!f) return;
+  if (fgets(line, sizeof(line), f) && strlen(line) >= 33 && line[16] == ' ') {
+    memcpy(g_pgo.cur, line, 16);
+    g_pgo.cur[16] = '\0';
+    memcpy(g_pgo.train, line + 17, 16);
+    g_pgo.train[16] = '\0';
+  }
+  fclose(f);
+}
+
+static void push_profile_flags(Argv *av, const char *cc, Profile p) {
+  if (p == PROF_DEBUG) {
+    av_push(av, "-g");
+    if (cc_is_tcc(cc)) av_push(av, "-bt20"); /* tcc: stack backtraces on crashes */
+    else if (g_config_split_dwarf) av_push(av, "-gsplit-dwarf");
+    av_push(av, "-DDEBUG=1");
+    return;
+  }
+  av_push(av, "-O2");
+  av_push(av, "-DNDEBUG=1");
+  if (p == PROF_RELEASE) return;
+
+  if (cc_is_tcc(cc)) {
+    if (!g_pgo.warned) fprintf(stderr, "tack: warning: %s has no LTO/PGO, %s builds as release\n", cc, profile_name(p));
+    g_pgo.warned = 1;
+    return;
+  }
+  if (p == PROF_PGO_GEN) {
+    if (!g_pgo.gen_flag[0]) {
+      char dir[1024];
+      pgo_path(dir, sizeof(dir), "raw");
+      tack_copy(g_pgo.gen_flag, sizeof(g_pgo.gen_flag), "-fprofile-generate=");
+      tack_cat(g_pgo.gen_flag, sizeof(g_pgo.gen_flag), dir);
+    }
+    av_push(av, g_pgo.gen_flag);
+    /* gcc stamps objects and .gcda with the compile time otherwise: same sources,
+     * same profile hash */
+    if (!cc_is_clang(cc)) av_push(av, "-frandom-seed=tack");
+    return;
+  }
+
+  /* gcc runs its LTRANS jobs through our jobserver (or on every cpu) */
+  av_push(av, cc_is_clang(cc) ? "-flto" : "-flto=auto");
+  if (p != PROF_RELEASE_PGO) return;
+
+  pgo_load();
+  if (!g_pgo.cur[0]) return; /* no profile yet (why/compdb before the first pgo build) */
+  if (!g_pgo.use_flag[0] || g_pgo.use_cc_clang != cc_is_clang(cc)) {
+    char dir[1024], file[1100];
+    pgo_path(dir, sizeof(dir), g_pgo.cur);
+    g_pgo.use_cc_clang = cc_is_clang(cc);
+    if (g_pgo.use_cc_clang) path_join(file, sizeof(file), dir, "merged.profdata");
+    else tack_copy(file, sizeof(file), dir);
+    tack_copy(g_pgo.use_flag, sizeof(g_pgo.use_flag), "-fprofile-use=");
+    tack_cat(g_pgo.use_flag, sizeof(g_pgo.use_flag), file);
+  }
+  av_push(av, g_pgo.use_flag);
+  if (!g_pgo.use_cc_clang) {
+    /* counters of threaded code may be inconsistent; untrained sources are fine */
+    av_push(av, "-fprofile-correction");
+    av_push(av, "-Wno-missing-profile");
+  }
+}
+
+/* -gsplit-dwarf: debug info goes to a .dwo next to the object, so the link reads less */
+static int split_dwarf_on(const char *cc, Profile p) {
+  return p == PROF_DEBUG && g_config_split_dwarf && !cc_is_tcc(cc);
+}
+
+/* -fuse-ld= from the target's linker, else [project] linker; tcc links itself */
+static void push_linker(Argv *av, const char *cc, const char *linker) {
+  static const char * const flags[] = { "-fuse-ld=mold", "-fuse-ld=lld", "-fuse-ld=gold", "-fuse-ld=bfd" };
+  int i;
+  if (!linker) linker = g_config_linker;
+  if (!linker || cc_is_tcc(cc)) return;
+  for (i = 0; g_linkers[i]; i++) if (streq(linker, g_linkers[i])) av_push(av, flags[i]);
+}
+
+static void push_common_warnings(Argv *av, int strict) {
+  av_push_list(av, g_warn_flags_base);
+  if (strict) av_push_list(av, g_warn_flags_strict_add);
+}
+
+/* --------------------------- build plan --------------------------- */
+/* One DAG per invocation: core compiles -> per-target compiles -> links.
+ * All jobs share a single JobPool, so links of finished targets overlap with
+ * compiles of other targets. Up-to-date objects never become jobs.
+ */
+
+typedef enum { JOB_COMPILE = 0, JOB_LINK = 1, JOB_ARCHIVE = 2, JOB_TEST = 3, JOB_PREPROCESS = 4, JOB_REMOTE = 5 } JobKind;
+#define JOB_KINDS 6
+static const char * const job_kind_name[] = { "compile", "link", "archive", "test", "preprocess", "remote" };
+typedef enum { JS_WAIT = 0, JS_READY = 1, JS_RUNNING = 2, JS_DONE = 3, JS_FAILED = 4 } JobState;
+
+typedef struct {
+  JobKind kind;
+  StrVec argv;      /* copies in the plan arena, 0-terminated */
+  char *label;      /* source (compile) or exe (link), for messages (plan arena) */
+  char *out;        /* primary output (plan arena) */
+  const char *target; /* target name, "core" or "tests" (trace) */
+  char *dep;        /* compile/remote: depfile, ingested into the build db on success */
+  char *in;         /* remote: preprocessed source, the worker's stdin */
+  StrVec fallback;  /* remote: the local compile argv, run when the worker fails */
+  int host;         /* remote: DistHost while running */
+  Hash64 cmd;       /* hash of argv */
+  int cache;        /* compile: store the object in the object cache on success */
+  Hash64 cache_key;
+  int test_keyed;   /* test: test_key is valid (exe hashed when the job became ready) */
+  Hash64 test_key;  /* test: results-cache key, H(test salt, exe content) */
+  int reused;       /* test: passed per the results cache, never ran */
+  long start_ms;    /* spawn time (now_ms) */
+  long ms;          /* wall time once finished */
+  int rc;           /* test: exit code; -1 = never ran */
+  StrVec inputs;    /* link/archive: objects compared against out at ready time */
+  int force;
+  long prio;        /* expected ms from this job's start to the end of its longest chain */
+  int pending;      /* unfinished predecessors */
+  IntVec succ;      /* dependent jobs */
+  JobState state;
+} PlanJob;
+
+typedef struct {
+  PlanJob *items;
+  int count;
+  int cap;
+
+  int verbose;
+  int keep_going;
+  int failed;
+  int tests_failed;   /* failing tests do not stop the plan (not counted in failed) */
+  const char *group;  /* target stamped on jobs added from now on */
+  int dry;            /* never run (compdb, why, affected): every compile is a job, unchecked */
+  int count_only;     /* compile_sources only counts dirty objects into ndirty: no jobs, no cache */
+  int ndirty;
+  StrVec compdb;      /* JSON objects for compile_commands.json */
+  int tests_cached;
+
+  /* test results cache: 0 = off; reuse = 0 records passes but runs everything */
+  struct TestResults *test_results;
+  int test_reuse;
+  Hash64 test_salt;    /* declared env + data files */
+
+  /* shared core: added once per plan, no matter how many targets link it */
+  int core_added;
+  int core_failed;     /* core could not be planned (pch): targets using it fail */
+  StrVec core_objs;
+  IntVec core_jobs;
+
+  Arena arena;        /* job argv, labels, outputs and -D strings: freed with the plan */
+} BuildPlan;
+
+static void plan_init(BuildPlan *bp, int verbose, int keep_going) {
+  bp->items = 0; bp->count = 0; bp->cap = 0;
+  bp->verbose = verbose;
+  bp->keep_going = keep_going;
+  bp->failed = 0;
+  bp->tests_failed = 0;
+  bp->group = 0;
+  bp->dry = 0;
+  bp->count_only = 0;
+  bp->ndirty = 0;
+  sv_init(&bp->compdb);
+  bp->tests_cached = 0;
+  bp->test_results = 0;
+  bp->test_reuse = 0;
+  bp->core_added = 0;
+  bp->core_failed = 0;
+  sv_init(&bp->core_objs);
+  iv_init(&bp->core_jobs);
+  arena_init(&bp->arena);
+}
+
+static void plan_free(BuildPlan *bp) {
+  int i;
+  for (i = 0; i < bp->count; i++) {
+    PlanJob *j = &bp->items[i];
+    sv_free(&j->argv);
+    sv_free(&j->inputs);
+    sv_free(&j->fallback);
+    iv_free(&j->succ);
+    free(j->dep);
+    free(j->in);
+  }
+  free(bp->items);
+  bp->items = 0; bp->count = 0; bp->cap = 0;
+  sv_free(&bp->compdb);
+  sv_free(&bp->core_objs);
+  iv_free(&bp->core_jobs);
+  arena_free(&bp->arena);
+}
+
+/* append a job whose argv hashes to cmd; argv is copied (must be 0-terminated) */
+static int plan_add_job_cmd(BuildPlan *bp, JobKind kind, char **argv, const char *label, const char *out,
+                            const Hash64 *cmd) {
+  PlanJob *j;
+  int i;
+
+  if (bp->count + 1 > bp->cap) {
+    int ncap = bp->cap ? bp->cap * 2 : 64;
+    bp->items = (PlanJob*)xrealloc(bp->items, (size_t)ncap * sizeof(PlanJob));
+    bp->cap = ncap;
+  }
+  j = &bp->items[bp->count];
+  memset(j, 0, sizeof(*j));
+  j->kind = kind;
+  sv_init_arena(&j->argv, &bp->arena);
+  for (i = 0; argv[i]; i++) sv_push(&j->argv, argv[i]);
+  sv_push_own(&j->argv, 0);
+  j->label = arena_strdup(&bp->arena, label);
+  j->out = arena_strdup(&bp->arena, out);
+  j->target = bp->group;
+  j->cmd = *cmd;
+  sv_init_arena(&j->inputs, &bp->arena);
+  sv_init_arena(&j->fallback, &bp->arena);
+  iv_init(&j->succ);
+  j->rc = -1;
+  j->state = JS_WAIT;
+  return bp->count++;
+}
+
+static int plan_add_job(BuildPlan *bp, JobKind kind, char **argv, const char *label, const char *out) {
+  Hash64 cmd;
+  h64_argv(&cmd, argv);
+  return plan_add_job_cmd(bp, kind, argv, label, out, &cmd);
+}
+
+static void plan_add_edge(BuildPlan *bp, int before, int after) {
+  iv_push(&bp->items[before].succ, after);
+  bp->items[after].pending++;
+}
+
+/* inputs of a link/archive (out_t = its mtime) that make it run: missing, or newer
+ * and not byte-identical to what it last read; direct builds also check their sources.
+ * Stops at the first one when quiet, else prints each (tack why). */
+static int plan_link_inputs_changed(const PlanJob *j, long out_t, int quiet) {
+  int i, n = 0;
+  if (j->dep && depfile_needs_rebuild(j->out, j->dep)) {
+    if (quiet) return 1;
+    printf("  a source of the direct build changed\n");
+    n++;
+  }
+  for (i = 0; i < j->inputs.count; i++) {
+    const char *in = j->inputs.items[i];
+    long it = file_mtime(in);
+    if (it < 0) {
+      if (quiet) return 1;
+      printf("  missing input: %s\n", in);
+      n++;
+    } else if (mtime_newer(it, out_t) && !db_input_unchanged(j->out, out_t, in, it)) {
+      if (quiet) return 1;
+      printf("  newer input: %s (+%lds)\n", in, it - out_t);
+      n++;
+    }
+  }
+  return n;
+}
+
+/* link/archive is needed if forced, missing, its command changed,
+ * or an input changed (plan_link_inputs_changed) */
+static int plan_link_needed(PlanJob *j) {
+  long exe_t;
+  if (j->force) return 1;
+  exe_t = file_mtime(j->out);
+  if (exe_t < 0) return 1;
+  if (!db_signature_matches(j->out, exe_t, &j->cmd)) return 1;
+  return plan_link_inputs_changed(j, exe_t, 1);
+}
+
+static void plan_mark_failed(BuildPlan *bp, int idx) {
+  int k;
+  PlanJob *j = &bp->items[idx];
+  if (j->state == JS_FAILED) return;
+  j->state = JS_FAILED;
+  bp->failed = 1;
+  /* dependents can never run */
+  for (k = 0; k < j->succ.count; k++) plan_mark_failed(bp, j->succ.items[k]);
+}
+
+static void plan_mark_done(BuildPlan *bp, int idx) {
+  int k;
+  PlanJob *j = &bp->items[idx];
+  j->state = JS_DONE;
+  for (k = 0; k < j->succ.count; k++) {
+    PlanJob *s = &bp->items[j->succ.items[k]];
+    if (s->state != JS_WAIT) continue;
+    if (--s->pending == 0) s->state = JS_READY;
+  }
+}
+
+/* critical path: prio = expected wall time (last run, from the build db) plus the
+ * longest prio among dependents, so long TUs and whatever gates a link start first.
+ * Jobs without history count as the mean of known jobs of their kind. */
+static long plan_prio(BuildPlan *bp, int idx, const long *mean) {
+  PlanJob *j = &bp->items[idx];
+  DbRec *r;
+  long tail = 0;
+  int k;
+
+  if (j->prio >= 0) return j->prio;
+  j->prio = 0; /* cycles cannot happen, but never recurse forever */
+  for (k = 0; k < j->succ.count; k++) {
+    long t = plan_prio(bp, j->succ.items[k], mean);
+    if (t > tail) tail = t;
+  }
+  r = db_find_rec(j->out);
+  j->prio = tail + (r && r->ms > 0 ? r->ms : mean[j->kind]);
+  return j->prio;
+}
+
+static void plan_prioritize(BuildPlan *bp) {
+  long sum[JOB_KINDS], mean[JOB_KINDS];
+  int cnt[JOB_KINDS], i;
+
+  db_load();
+  for (i = 0; i < JOB_KINDS; i++) { sum[i] = 0; cnt[i] = 0; }
+  for (i = 0; i < bp->count; i++) {
+    DbRec *r = db_find_rec(bp->items[i].out);
+    bp->items[i].prio = -1;
+    if (r && r->ms > 0) { sum[bp->items[i].kind] += r->ms; cnt[bp->items[i].kind]++; }
+  }
+  for (i = 0; i < JOB_KINDS; i++) mean[i] = cnt[i] ? sum[i] / cnt[i] : 1;
+  for (i = 0; i < bp->count; i++) plan_prio(bp, i, mean);
+}
+
+/* pick next ready job: highest prio; ties go to links/archives (they gate an output),
+ * then plan order. local/remote: whether a local (-j) or a remote slot is free. */
+static int plan_next_ready(BuildPlan *bp, int local, int remote) {
+  int i, best = -1;
+  for (i = 0; i < bp->count; i++) {
+    const PlanJob *j = &bp->items[i];
+    if (j->state != JS_READY) continue;
+    if (!(j->kind == JOB_REMOTE ? remote : local)) continue;
+    if (best < 0 || j->prio > bp->items[best].prio ||
+        (j->prio == bp->items[best].prio && j->kind != JOB_COMPILE && bp->items[best].kind == JOB_COMPILE)) best = i;
+  }
+  return best;
+}
+
+/* --------------------------- test results cache --------------------------- */
+/* build/tests/<profile>/results.cache remembers the key of every test's last PASS:
+ *   key = H(test binary contents, [project] test_env values + PATH, test_data contents)
+ * A test whose key is unchanged is reported as "cached PASS" without running it.
+ * Failures are never cached. Text format: "tackres 1" then "<key> <test source>" lines.
+ */
+
+typedef struct TestResults {
+  StrVec names;
+  Hash64 *keys;
+  int cap;
+  int dirty;
+} TestResults;
+
+static void test_results_init(TestResults *tr) {
+  sv_init(&tr->names);
+  tr->keys = 0;
+  tr->cap = 0;
+  tr->dirty = 0;
+}
+
+static void test_results_free(TestResults *tr) {
+  sv_free(&tr->names);
+  free(tr->keys);
+  test_results_init(tr);
+}
+
+static int test_results_find(const TestResults *tr, const char *name) {
+  int i;
+  for (i = 0; i < tr->names.count; i++) if (streq(tr->names.items[i], name)) return i;
+  return -1;
+}
+
+static void test_results_put(TestResults *tr, const char *name, const Hash64 *key) {
+  int i = test_results_find(tr, name);
+  if (i < 0) {
+    if (tr->names.count + 1 > tr->cap) {
+      int ncap = tr->cap ? tr->cap * 2 : 64;
+      tr->keys = (Hash64*)xrealloc(tr->keys, (size_t)ncap * sizeof(Hash64));
+      tr->cap = ncap;
+    }
+    sv_push(&tr->names, name);
+    i = tr->names.count - 1;
+  } else if (tr->keys[i].a == key->a && tr->keys[i].b == key->b) {
+    return;
+  }
+  tr->keys[i] = *key;
+  tr->dirty = 1;
+}
+
+static void test_results_load(TestResults *tr, const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[TACK_MAX_LINE];
+
+  if (!f) return;
+  if (!fgets(line, sizeof(line), f) || strncmp(line, "tackres 1", 9) != 0) { fclose(f); return; }
+  while (fgets(line, sizeof(line), f)) {
+    Hash64 k;
+    char *name;
+    if (strlen(line) < 18 || line[16] != ' ') continue;
+    if (sscanf(line, "%8lx%8lx", &k.a, &k.b) != 2) continue;
+    name = trim(line + 17);
+    if (*name) test_results_put(tr, name, &k);
+  }
+  fclose(f);
+  tr->dirty = 0;
+}
+
+static void test_results_save(TestResults *tr, const char *path) {
+  FILE *f;
+  int i;
+  if (!tr->dirty) return;
+  f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "tack: warning: cannot write %s\n", path); return; }
+  fprintf(f, "tackres 1\n");
+  for (i = 0; i < tr->names.count; i++) {
+    char hex[17];
+    if (!tr->keys[i].a && !tr->keys[i].b) continue; /* forgotten (last run failed) */
+    h64_hex(hex, &tr->keys[i]);
+    fprintf(f, "%s %s\n", hex, tr->names.items[i]);
+  }
+  fclose(f);
+  tr->dirty = 0;
+}
+
+static int cmp_str_ptr(const void *a, const void *b) {
+  return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+/* everything besides the binary that a test result depends on */
+static void test_salt(Hash64 *h) {
+  StrVec names, files;
+  int i;
+
+  h64_init(h);
+  sv_init(&names);
+  sv_init(&files);
+
+  sv_push(&names, "PATH");
+  if (g_config_test_env) split_list_tokens(&names, g_config_test_env, 1);
+  for (i = 0; i < names.count; i++) {
+    const char *v = getenv(names.items[i]);
+    h64_update(h, names.items[i], strlen(names.items[i]) + 1);
+    if (v) h64_update(h, v, strlen(v) + 1);
+    else h64_update(h, "", 1);
+  }
+
+  if (g_config_test_data) {
+    StrVec decl;
+    sv_init(&decl);
+    split_list_tokens(&decl, g_config_test_data, 0);
+    for (i = 0; i < decl.count; i++) {
+      if (is_dir_path(decl.items[i])) scan_dir_recursive_suffix(&files, decl.items[i], "");
+      else sv_push(&files, decl.items[i]);
+    }
+    sv_free(&decl);
+  }
+  if (files.count > 1) qsort(files.items, (size_t)files.count, sizeof(char*), cmp_str_ptr);
+
+  db_load();
+  for (i = 0; i < files.count; i++) {
+    Hash64 fh;
+    h64_update(h, files.items[i], strlen(files.items[i]) + 1);
+    if (db_file_hash(db_intern(files.items[i]), &fh) == 0) h64_update(h, &fh, sizeof(fh));
+  }
+
+  sv_free(&files);
+  sv_free(&names);
+}
+
+/* ready test: compute its key; 1 = unchanged since its last PASS (skip it) */
+static int plan_test_cached(BuildPlan *bp, PlanJob *j) {
+  Hash64 exe_h;
+  int i;
+
+  db_load();
+  if (db_file_hash(db_intern(j->argv.items[0]), &exe_h) != 0) return 0;
+  j->test_key = bp->test_salt;
+  h64_update(&j->test_key, &exe_h, sizeof(exe_h));
+  if (!j->test_key.a && !j->test_key.b) j->test_key.b = 1; /* 0 means "no entry" */
+  j->test_keyed = 1;
+
+  if (!bp->test_reuse) return 0;
+  i = test_results_find(bp->test_results, j->label);
+  if (i < 0) return 0;
+  return bp->test_results->keys[i].a == j->test_key.a && bp->test_results->keys[i].b == j->test_key.b;
+}
+
+/* copy a log file to stdout, indented */
+static void print_log(const char *path) {
+  FILE *f = fopen(path, "rb");
+  int c, bol = 1;
+  if (!f) return;
+  while ((c = fgetc(f)) != EOF) {
+    if (bol) fputs("    ", stdout);
+    fputc(c, stdout);
+    bol = c == '\n';
+  }
+  if (!bol) fputc('\n', stdout);
+  fclose(f);
+}
+
+/* test output is buffered in its log; show it on failure (always with -v) */
+static void plan_test_finished(BuildPlan *bp, PlanJob *j, int rc) {
+  j->rc = rc;
+  if (rc == 0) {
+    printf("PASS %s (%ld ms)\n", j->label, j->ms);
+    if (j->test_keyed) test_results_put(bp->test_results, j->label, &j->test_key);
+  } else {
+    Hash64 none;
+    printf("FAIL %s (exit %d, %ld ms)\n", j->label, rc, j->ms);
+    bp->tests_failed++;
+    none.a = none.b = 0;
+    if (bp->test_results && test_results_find(bp->test_results, j->label) >= 0)
+      test_results_put(bp->test_results, j->label, &none);
+  }
+  if (rc != 0 || bp->verbose) print_log(j->out);
+}
+
+static void plan_report_failure(PlanJob *j) {
+  if (j->kind == JOB_LINK) fprintf(stderr, "tack: link failed: %s\n", j->label);
+  else if (j->kind == JOB_ARCHIVE) fprintf(stderr, "tack: archive failed: %s\n", j->label);
+  else if (j->kind == JOB_TEST) fprintf(stderr, "tack: cannot run test: %s\n", j->label);
+  else fprintf(stderr, "tack: compile failed: %s\n", j->label);
+}
+
+/* run the whole plan with one -j pool
+ * keep_going = 0: fail-fast (stop spawning on first failure, reap running jobs)
+ * keep_going = 1: keep running everything that does not depend on a failed job
+ */
+/* remote cache, before anything runs: fetch manifests for every compile that missed
+ * the local cache, then the objects they match, in two concurrent rounds. Objects
+ * that arrive are merged into the local cache and their jobs finish right here. */
+static void plan_remote_prefetch(BuildPlan *bp) {
+  StrVec urls, files;
+  IntVec idx;
+  int *rcs, i;
+
+  if (bp->dry || !remote_enabled()) return;
+
+  sv_init(&urls);
+  sv_init(&files);
+  iv_init(&idx);
+  for (i = 0; i < bp->count; i++) {
+    PlanJob *j = &bp->items[i];
+    char url[1100], file[1100];
+    if (j->kind != JOB_COMPILE || !j->cache || j->state == JS_DONE) continue;
+    remote_url(url, sizeof(url), "m", &j->cache_key, "");
+    cache_sub(file, sizeof(file), "m", &j->cache_key, ".remote");
+    sv_push(&urls, url);
+    sv_push(&files, file);
+    iv_push(&idx, i);
+  }
+  if (!idx.count) { sv_free(&urls); sv_free(&files); iv_free(&idx); return; }
+  g_remote.lookups += idx.count;
+
+  {
+    char sub[1024];
+    ensure_dir(g_cache.dir);
+    path_join(sub, sizeof(sub), g_cache.dir, "o"); ensure_dir(sub);
+    path_join(sub, sizeof(sub), g_cache.dir, "m"); ensure_dir(sub);
+  }
+
+  rcs = (int*)xmalloc((size_t)idx.count * sizeof(int));
+  remote_batch(urls.items, files.items, rcs, idx.count, 0, "remote get manifests");
+
+  /* round 2: objects named by a matching remote entry and missing locally */
+  {
+    StrVec ourls, ofiles;
+    int *orcs, k;
+    sv_init(&ourls);
+    sv_init(&ofiles);
+    for (k = 0; k < idx.count; k++) {
+      CacheEntry es[TACK_CACHE_MAX_ENTRIES];
+      char url[1100], obj[1024];
+      int n, hit;
+      if (rcs[k] != 0) continue;
+      n = cache_read_manifest(files.items[k], es);
+      hit = cache_match(es, n);
+      if (hit >= 0) {
+        cache_sub(obj, sizeof(obj), "o", &es[hit].obj, ".o");
+        if (!file_exists(obj)) {
+          remote_url(url, sizeof(url), "o", &es[hit].obj, ".o");
+          tack_cat(obj, sizeof(obj), ".tmp");
+          sv_push(&ourls, url);
+          sv_push(&ofiles, obj);
+        }
+      } else {
+        rcs[k] = 1;
+      }
+      cache_entries_free(es, n);
+    }
+    orcs = (int*)xmalloc((size_t)(ourls.count ? ourls.count : 1) * sizeof(int));
+    remote_batch(ourls.items, ofiles.items, orcs, ourls.count, 0, "remote get objects");
+    for (k = 0; k < ofiles.count; k++) {
+      char obj[1024];
+      size_t n = strlen(ofiles.items[k]) - 4; /* drop ".tmp" */
+      memcpy(obj, ofiles.items[k], n);
+      obj[n] = '\0';
+#ifdef _WIN32
+      if (orcs[k] == 0) remove(obj);
+#endif
+      if (orcs[k] != 0 || rename(ofiles.items[k], obj) != 0) remove(ofiles.items[k]);
+    }
+    free(orcs);
+    sv_free(&ourls);
+    sv_free(&ofiles);
+  }
+
+  /* adopt the matching entry if its object is here now, then take the normal hit path */
+  for (i = 0; i < idx.count; i++) {
+    PlanJob *j = &bp->items[idx.items[i]];
+    CacheEntry es[TACK_CACHE_MAX_ENTRIES];
+    char obj[1024];
+    int n, hit, k;
+
+    if (rcs[i] != 0) { remove(files.items[i]); continue; }
+    n = cache_read_manifest(files.items[i], es);
+    remove(files.items[i]);
+    hit = cache_match(es, n);
+    if (hit >= 0) cache_sub(obj, sizeof(obj), "o", &es[hit].obj, ".o");
+    if (hit < 0 || !file_exists(obj)) { cache_entries_free(es, n); continue; }
+
+    cache_manifest_add(&j->cache_key, &es[hit]);
+    for (k = hit; k + 1 < n; k++) es[k] = es[k + 1];
+    cache_entries_free(es, n - 1);
+
+    if (cache_fetch(&j->cache_key, j->out, j->dep) != 0) { g_cache.misses--; continue; }
+    g_cache.misses--; /* the planning-time miss turned into a hit */
+    g_remote.hits++;
+    if (bp->verbose) printf("remote cached: %s\n", j->out);
+    db_ingest_depfile(j->out, j->dep, &j->cmd);
+    j->cache = 0;
+    plan_mark_done(bp, idx.items[i]);
+  }
+
+  free(rcs);
+  sv_free(&urls);
+  sv_free(&files);
+  iv_free(&idx);
+}
+
+/* the worker refused or never ran (host down, other compiler, no ssh): take the host
+ * out of this run and compile locally instead */
+static void plan_dist_fallback(BuildPlan *bp, int idx, int rc) {
+  PlanJob *j = &bp->items[idx];
+  DistHost *h = &g_dist.hosts[j->host];
+  if (!h->down) {
+    if (rc == 201) fprintf(stderr, "tack: warning: dist: %s has a different compiler; not using it\n", h->name);
+    else if (rc == 126 || rc == 127) fprintf(stderr, "tack: warning: dist: %s cannot start the worker (exit %d); compiling locally\n", h->name, rc);
+    else fprintf(stderr, "tack: warning: dist: %s failed (exit %d); compiling locally\n", h->name, rc);
+    h->down = 1;
+  }
+  remove(j->out);
+  remove(j->in);
+  stat_cache_forget(j->out);
+  sv_free(&j->argv);
+  j->argv = j->fallback;
+  sv_init(&j->fallback);
+  j->kind = JOB_COMPILE;
+  if (j->state != JS_WAIT) j->state = JS_READY;
+}
+
+static int plan_run(BuildPlan *bp, int jobs) {
+  JobPool pool;
+  int i, local_running = 0;
+  int remote_slots = g_dist.enabled ? g_dist.slots : 0;
+
+  if (jobs < 1) jobs = 1;
+  for (i = 0; i < bp->count; i++) {
+    if (bp->items[i].state == JS_WAIT && bp->items[i].pending == 0) bp->items[i].state = JS_READY;
+  }
+
+  plan_remote_prefetch(bp);
+  plan_prioritize(bp);
+  pool_init(&pool, jobs + remote_slots);
+
+  for (;;) {
+    int tag, rc, no_token = 0;
+
+    /* every host is down: whatever still waits for one compiles locally */
+    if (remote_slots && !dist_any_up()) {
+      for (i = 0; i < bp->count; i++) {
+        PlanJob *j = &bp->items[i];
+        if (j->kind == JOB_REMOTE && (j->state == JS_WAIT || j->state == JS_READY)) plan_dist_fallback(bp, i, 255);
+      }
+      remote_slots = 0;
+    }
+
+    while (!bp->failed || bp->keep_going) {
+      int local = !no_token && local_running < jobs, remote = remote_slots && dist_pick_host() >= 0;
+      int idx;
+      PlanJob *j;
+      if (!local && !remote) break;
+      idx = plan_next_ready(bp, local, remote);
+      if (idx < 0) break;
+      j = &bp->items[idx];
+
+      if (j->kind == JOB_TEST && bp->test_results && plan_test_cached(bp, j)) {
+        printf("cached PASS %s\n", j->label);
+        j->rc = 0;
+        j->reused = 1;
+        bp->tests_cached++;
+        plan_mark_done(bp, idx);
+        continue;
+      }
+
+      if ((j->kind == JOB_LINK || j->kind == JOB_ARCHIVE) && !plan_link_needed(j)) {
+        if (bp->verbose) printf("up to date: %s\n", j->out);
+        plan_mark_done(bp, idx);
+        continue;
+      }
+
+      if (j->kind == JOB_REMOTE) {
+        Argv av;
+        char *cmd;
+        j->host = dist_pick_host();
+        cmd = dist_argv(&av, j->host, j->argv.items);
+        if (bp->verbose) print_argv(av.a);
+        j->start_ms = now_ms();
+        rc = pool_spawn_io(&pool, av.a, j->in, j->out, 0, idx);
+        av_free(&av);
+        free(cmd);
+        if (rc != 0) { plan_dist_fallback(bp, idx, 255); continue; }
+        g_dist.hosts[j->host].running++;
+        j->state = JS_RUNNING;
+        continue;
+      }
+
+      /* under a make jobserver every job past the first needs a token */
+      if (!js_take(local_running)) { no_token = 1; continue; }
+
+      /* ar rcs only adds/replaces members: start from scratch so removed sources drop
+       * out. An archive that cannot be removed (in use on Windows) would keep them, so
+       * that fails the job instead of archiving into it. */
+      if (j->kind == JOB_ARCHIVE) {
+        stat_cache_forget(j->out);
+        if (remove(j->out) != 0 && file_exists(j->out)) {
+          js_release(local_running);
+          fprintf(stderr, "tack: cannot replace %s\n", j->out);
+          plan_report_failure(j);
+          plan_mark_failed(bp, idx);
+          continue;
+        }
+      }
+
+      if (bp->verbose) print_argv(j->argv.items);
+      j->start_ms = now_ms();
+      if (pool_spawn(&pool, j->argv.items, j->kind == JOB_TEST ? j->out : 0, idx) != 0) {
+        js_release(local_running);
+        plan_report_failure(j);
+        plan_mark_failed(bp, idx);
+        continue;
+      }
+      local_running++;
+      j->state = JS_RUNNING;
+    }
+
+    if (pool_wait_any(&pool, &tag, &rc) != 0) break; /* nothing running, nothing spawnable */
+
+    {
+      PlanJob *j = &bp->items[tag];
+      long end = now_ms();
+      long peak_kb = pool.procs[pool.last_slot].peak_kb;
+      j->ms = end - j->start_ms;
+      if (rc == 0 || j->kind == JOB_TEST) db_record_run(j->out, j->ms, peak_kb);
+      trace_event(job_kind_name[j->kind], j->label, j->target, j->out, pool.last_slot + 1,
+                  j->start_ms, end, rc, peak_kb);
+      if (j->kind == JOB_REMOTE) {
+        g_dist.hosts[j->host].running--;
+      } else {
+        local_running--;
+        js_release(local_running);
+      }
+    }
+    stat_cache_forget(bp->items[tag].out);
+
+    if (bp->items[tag].kind == JOB_TEST) {
+      plan_test_finished(bp, &bp->items[tag], rc);
+      plan_mark_done(bp, tag);
+    } else if (bp->items[tag].kind == JOB_REMOTE && dist_host_failed(rc)) {
+      plan_dist_fallback(bp, tag, rc);
+    } else if (rc != 0) {
+      if (bp->items[tag].kind == JOB_REMOTE) {
+        remove(bp->items[tag].out); /* partial object from stdout */
+        remove(bp->items[tag].in);
+      }
+      plan_report_failure(&bp->items[tag]);
+      plan_mark_failed(bp, tag);
+    } else if (bp->items[tag].kind == JOB_PREPROCESS) {
+      plan_mark_done(bp, tag); /* scratch .i: not tracked */
+    } else {
+      PlanJob *j = &bp->items[tag];
+      if (j->dep) db_ingest_depfile(j->out, j->dep, &j->cmd);
+      else db_record_output(j->out, &j->cmd, &j->inputs);
+      if (j->cache) cache_store(&j->cache_key, j->out, j->dep);
+      if (j->in) remove(j->in);
+      plan_mark_done(bp, tag);
+    }
+  }
+
+  pool_free(&pool);
+  return bp->failed ? 1 : 0;
+}
+
+/* --------------------------- compilation database --------------------------- */
+/* build/compile_commands.json from the exact argv compile_sources assembles, for every
+ * enabled target, core and the tests (a dry plan: nothing is compiled). Written with
+ * --compdb or [project] compdb = yes, and only rewritten when its content changes.
+ * The dry plan only runs when compdb_key (config snapshot, CC, profile, source set)
+ * differs from the one stored next to it in build/.tack_compdb.
+ */
+
+static void compdb_add(BuildPlan *bp, char **argv, const char *src, const char *out) {
+  char cwd[1024];
+  StrBuf b;
+  int i;
+
+#ifdef _WIN32
+  if (!_getcwd(cwd, (int)sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#else
+  if (!getcwd(cwd, sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#endif
+
+  sb_init(&b);
+  sb_puts(&b, "  {\n    \"directory\": ");
+  sb_json_str(&b, cwd);
+  sb_puts(&b, ",\n    \"file\": ");
+  sb_json_str(&b, src);
+  sb_puts(&b, ",\n    \"output\": ");
+  sb_json_str(&b, out);
+  sb_puts(&b, ",\n    \"arguments\": [");
+  for (i = 0; argv[i]; i++) {
+    if (i) sb_puts(&b, ", ");
+    sb_json_str(&b, argv[i]);
+  }
+  sb_puts(&b, "]\n  }");
+  sv_push_own(&bp->compdb, b.p);
+}
+
+/* precompiled header of one compile group (a target or core), see plan_add_pch */
+typedef struct {
+  char inc[1024];  /* stub header passed as -include; the compiler finds out next to it */
+  char out[1024];  /* <stub>.gch (gcc) or <stub>.pch (clang) */
+  long out_t;      /* mtime of out at plan time (-1 = missing) */
+  int job;         /* plan job rebuilding out, -1 = up to date */
+} Pch;
+
+/* distributed compile (see dist_enabled): a local -E job that also writes the depfile,
+ * then a remote job compiling the .i with the flags that still matter after
+ * preprocessing. argv: the local compile, kept as the fallback. Returns the remote job. */
+static int plan_add_dist(BuildPlan *bp, char **argv, const char *src, const char *obj, const char *dep) {
+  Argv pre, rem;
+  char *ipath;
+  size_t n = strlen(obj) + 3;
+  int i, pidx, ridx;
+  PlanJob *r;
+
+  ipath = (char*)xmalloc(n);
+  tack_copy(ipath, n, obj);
+  tack_cat(ipath, n, ".i");
+
+  av_init(&pre);
+  av_init(&rem);
+  av_push(&pre, argv[0]);
+  av_push(&pre, "-E");
+  av_push(&rem, argv[0]);
+  for (i = 1; argv[i]; i++) {
+    const char *a = argv[i];
+    if (streq(a, "-o") && argv[i + 1]) { i++; continue; }
+    if (argv[i + 1] == 0 && streq(a, src)) continue;
+    if (!streq(a, "-c")) av_push(&pre, a);
+    /* preprocessor-only options stay local */
+    if ((streq(a, "-I") || streq(a, "-include") || streq(a, "-isystem") || streq(a, "-iquote") ||
+         streq(a, "-MF") || streq(a, "-MT") || streq(a, "-MQ") || streq(a, "-D") || streq(a, "-U")) && argv[i + 1]) {
+      av_push(&pre, argv[++i]);
+      continue;
+    }
+    if (strncmp(a, "-I", 2) == 0 || strncmp(a, "-D", 2) == 0 || strncmp(a, "-U", 2) == 0 ||
+        streq(a, "-MD") || streq(a, "-MMD")) continue;
+    av_push(&rem, a);
+  }
+  av_push(&pre, "-MT");
+  av_push(&pre, obj);
+  av_push(&pre, "-o");
+  av_push(&pre, ipath);
+  av_push(&pre, src);
+  av_terminate(&pre);
+  av_terminate(&rem);
+
+  pidx = plan_add_job(bp, JOB_PREPROCESS, pre.a, src, ipath);
+  ridx = plan_add_job(bp, JOB_REMOTE, rem.a, src, obj);
+  r = &bp->items[ridx];
+  h64_argv(&r->cmd, argv); /* the signature of the compile it stands for */
+  r->dep = xstrdup(dep);
+  r->in = ipath;
+  for (i = 0; argv[i]; i++) sv_push(&r->fallback, argv[i]);
+  sv_push_own(&r->fallback, 0);
+  plan_add_edge(bp, pidx, ridx);
+
+  av_free(&pre);
+  av_free(&rem);
+  return ridx;
+}
+
+/* queue compile jobs for srcs; every object path goes to out_objs, dirty ones become jobs.
+ * Everything up to the per-file tail (depfile, object, source) is the same for all of
+ * srcs: that prefix and its hash are built once and each TU only appends its tail. */
+static void compile_sources(BuildPlan *bp, const char *cc, StrVec *srcs, const char *objd, const char *depd,
+                            const char * const *inc_common,
+                            const char * const *inc_extra,
+                            const char * const *def_extra,
+                            const char * const *cflags_extra,
+                            const Pch *pch,
+                            Profile p, int force, int strict,
+                            StrVec *out_objs, IntVec *out_jobs) {
+  Argv av;
+  Hash64 pre_h;
+  int i, k, npre;
+
+  av_init(&av);
+  av_push(&av, cc);
+  av_push(&av, "-c");
+
+  push_common_warnings(&av, strict);
+  push_profile_flags(&av, cc, p);
+
+  /* includes */
+  for (k = 0; inc_common && inc_common[k]; k++) {
+    av_push(&av, "-I");
+    av_push(&av, inc_common[k]);
+  }
+  for (k = 0; inc_extra && inc_extra[k]; k++) {
+    av_push(&av, "-I");
+    av_push(&av, inc_extra[k]);
+  }
+
+  /* extra defines */
+  for (k = 0; def_extra && def_extra[k]; k++) {
+    size_t n = strlen(def_extra[k]) + 3;
+    char *d = (char*)arena_alloc(&bp->arena, n);
+    tack_copy(d, n, "-D");
+    tack_cat(d, n, def_extra[k]);
+    av_push(&av, d);
+  }
+
+  /* extra cflags */
+  av_push_list(&av, cflags_extra);
+
+  if (pch) {
+    av_push(&av, "-include");
+    av_push(&av, pch->inc);
+  }
+
+  npre = av.n;
+  av_terminate(&av);
+  h64_argv(&pre_h, av.a);
+
+  for (i = 0; i < srcs->count; i++) {
+    const char *src = srcs->items[i];
+    char sid[512], obj_name[768], dep_name[768];
+    char obj_path[1024], dep_path[1024];
+    Hash64 cmd;
+
+    sanitize_path_to_id(sid, sizeof(sid), src);
+    tack_copy(obj_name, sizeof(obj_name), sid); tack_cat(obj_name, sizeof(obj_name), ".o");
+    tack_copy(dep_name, sizeof(dep_name), sid); tack_cat(dep_name, sizeof(dep_name), ".d");
+
+    path_join(obj_path, sizeof(obj_path), objd, obj_name);
+    path_join(dep_path, sizeof(dep_path), depd, dep_name);
+
+    sv_push(out_objs, obj_path);
+
+    /* build argv (always: its signature is part of the up-to-date check) */
+    av.n = npre;
+#if USE_DEPFILES
+    av_push(&av, "-MD");
+    av_push(&av, "-MF");
+    av_push(&av, dep_path);
+#endif
+
+    av_push(&av, "-o");
+    av_push(&av, obj_path);
+    av_push(&av, src);
+
+    av_terminate(&av);
+
+    cmd = pre_h;
+    h64_argv_update(&cmd, av.a + npre);
+    if (bp->dry) {
+      int idx;
+      compdb_add(bp, av.a, src, obj_path);
+      idx = plan_add_job_cmd(bp, JOB_COMPILE, av.a, src, obj_path, &cmd);
+#if USE_DEPFILES
+      bp->items[idx].dep = xstrdup(dep_path);
+#endif
+      /* why/affected follow it from the pch to its objects */
+      if (pch && pch->job >= 0) plan_add_edge(bp, pch->job, idx);
+      iv_push(out_jobs, idx);
+    } else if (bp->count_only) {
+      if (obj_needs_rebuild(obj_path, src, dep_path, &cmd, force) ||
+          (pch && (pch->job >= 0 || mtime_newer(pch->out_t, file_mtime(obj_path))))) bp->ndirty++;
+    } else if (obj_needs_rebuild(obj_path, src, dep_path, &cmd, force) ||
+               (pch && (pch->job >= 0 || mtime_newer(pch->out_t, file_mtime(obj_path))))) {
+      Hash64 key;
+      int cached = 0;
+#if USE_DEPFILES
+      /* with a pch the depfile misses the headers inside it: not content-addressable;
+       * a split-dwarf object is only half of the output (its .dwo is not cached) */
+      cached = !pch && !split_dwarf_on(cc, p) && cache_enabled() && cache_key(&key, av.a, src) == 0;
+      if (cached && cache_fetch(&key, obj_path, dep_path) == 0) {
+        if (bp->verbose) printf("cached: %s\n", obj_path);
+        db_ingest_depfile(obj_path, dep_path, &cmd);
+      } else
+#endif
+      {
+        int idx;
+#if USE_DEPFILES
+        /* the profile of release-pgo exists only here; a worker returns no .dwo */
+        if (!pch && p != PROF_RELEASE_PGO && !split_dwarf_on(cc, p) && dist_enabled(cc)) {
+          idx = plan_add_dist(bp, av.a, src, obj_path, dep_path);
+        } else {
+          idx = plan_add_job_cmd(bp, JOB_COMPILE, av.a, src, obj_path, &cmd);
+          bp->items[idx].dep = xstrdup(dep_path);
+        }
+#else
+        idx = plan_add_job_cmd(bp, JOB_COMPILE, av.a, src, obj_path, &cmd);
+#endif
+        bp->items[idx].cache = cached;
+        if (cached) bp->items[idx].cache_key = key;
+        if (pch && pch->job >= 0) plan_add_edge(bp, pch->job, idx);
+        iv_push(out_jobs, idx);
+      }
+    }
+  }
+  av_free(&av);
+}
+
+/* queue link job; runs after deps, decides at that point whether relinking is needed */
+static int link_executable(BuildPlan *bp, const char *cc, const char *out_exe,
+                           StrVec *objs,
+                           const char * const *inc_common,
+                           const char * const *inc_extra,
+                           const char * const *def_extra,
+                           const char * const *ldflags_extra,
+                           const char * const *libs_extra,
+                           const char *linker,
+                           Profile p, int force, int strict,
+                           IntVec *deps) {
+  Argv av;
+  int i, idx;
+  StrVec tmp_defs;
+
+  av_init(&av);
+  sv_init(&tmp_defs);
+
+  av_push(&av, cc);
+
+  push_common_warnings(&av, strict);
+  push_profile_flags(&av, cc, p);
+
+  /* includes (mostly irrelevant for link, but harmless with tcc) */
+  {
+    int k;
+    for (k = 0; inc_common && inc_common[k]; k++) {
+      av_push(&av, "-I");
+      av_push(&av, inc_common[k]);
+    }
+    for (k = 0; inc_extra && inc_extra[k]; k++) {
+      av_push(&av, "-I");
+      av_push(&av, inc_extra[k]);
+    }
+  }
+
+  /* extra defines */
+  {
+    int k;
+    for (k = 0; def_extra && def_extra[k]; k++) {
+      char *d;
+      size_t n;
+      n = strlen(def_extra[k]) + 3;
+      d = (char*)xmalloc(n);
+      tack_copy(d, n, "-D");
+      tack_cat(d, n, def_extra[k]);
+      sv_push_own(&tmp_defs, d);
+      av_push(&av, d);
+    }
+  }
+
+  push_linker(&av, cc, linker);
+  av_push_list(&av, ldflags_extra);
+
+  av_push(&av, "-o");
+  av_push(&av, out_exe);
+
+  for (i = 0; i < objs->count; i++) av_push(&av, objs->items[i]);
+
+  av_push_list(&av, libs_extra);
+
+  av_terminate(&av);
+
+  idx = plan_add_job(bp, JOB_LINK, av.a, out_exe, out_exe);
+  bp->items[idx].force = force;
+  for (i = 0; i < objs->count; i++) sv_push(&bp->items[idx].inputs, objs->items[i]);
+  for (i = 0; deps && i < deps->count; i++) plan_add_edge(bp, deps->items[i], idx);
+
+  sv_free(&tmp_defs);
+  av_free(&av);
+
+  return idx;
+}
+
+/* --------------------------- core + target build --------------------------- */
+
+/* src/core is scanned once per process (per profile). After a successful plan the core
+ * state is known to be clean, so later plans in the same process skip every core check.
+ */
+typedef struct {
+  int scanned;
+  Profile p;
+  StrVec srcs;
+  StrVec objs;   /* object paths (filled on first plan) */
+  int clean;     /* 1 = all core objects (and archive) up to date */
+} CoreCache;
+
+static CoreCache g_core_cache;
+
+static void core_cache_reset(void) {
+  sv_free(&g_core_cache.srcs);
+  sv_free(&g_core_cache.objs);
+  g_core_cache.scanned = 0;
+  g_core_cache.clean = 0;
+}
+
+/* returns number of core sources for profile p (0 = no core) */
+static int core_cache_scan(Profile p) {
+  if (g_core_cache.scanned && g_core_cache.p == p) return g_core_cache.srcs.count;
+  core_cache_reset();
+  g_core_cache.scanned = 1;
+  g_core_cache.p = p;
+  if (file_exists(g_core_dir) && is_dir_path(g_core_dir)) {
+    scan_dir_recursive_suffix(&g_core_cache.srcs, g_core_dir, ".c");
+  }
+  return g_core_cache.srcs.count;
+}
+
+static void core_archive_path(char *out, size_t cap, Profile p) {
+  char cdir[512], pdir[512];
+  path_join(cdir, sizeof(cdir), g_build_dir, "_core");
+  path_join(pdir, sizeof(pdir), cdir, profile_name(p));
+  path_join(out, cap, pdir, "libcore.a");
+}
+
+static int cc_is_tcc(const char *cc) { return strncmp(path_base(cc), "tcc", 3) == 0; }
+
+/* archiver: TACK_AR, otherwise "tcc -ar" for tcc and "ar" for everything else */
+static void push_archiver(Argv *av, const char *cc) {
+  const char *ar = getenv("TACK_AR");
+  if (ar && ar[0]) {
+    tack_check_len("TACK_AR", ar, TACK_MAX_CC);
+    av_push(av, ar);
+  } else if (cc_is_tcc(cc)) {
+    av_push(av, cc);
+    av_push(av, "-ar");
+  } else {
+    av_push(av, "ar");
+  }
+}
+
+static int plan_add_pch(BuildPlan *bp, Pch *pc, const char *cc, const char *header, const char *root,
+                        const char * const *inc_common,
+                        const char * const *inc_extra,
+                        const char * const *def_extra,
+                        const char * const *cflags_extra,
+                        Profile p, int force, int strict);
+
+/* add core compiles to the plan (once per plan); fills bp->core_objs/core_jobs
+ * core_objs are the link inputs: the objects, or build/_core/<profile>/libcore.a
+ * when [project] core_archive = yes
+ */
+/* nonzero when core cannot be planned (reported); repeated calls return the same */
+static int build_core(BuildPlan *bp, Profile p, int force, int strict) {
+  const char *cc;
+  char root[512], objd[512], depd[512], bind[512];
+  char lib[512];
+  const char *inc_common[4];
+  StrVec objs;
+  IntVec jobs;
+  Pch pch;
+  int use_pch;
+
+  if (bp->core_added) return bp->core_failed;
+  bp->core_added = 1;
+
+  if (core_cache_scan(p) == 0) return 0; /* no core */
+
+  core_archive_path(lib, sizeof(lib), p);
+
+  /* known clean in this process: link inputs only, no stats, no jobs */
+  if (g_core_cache.clean && !force && !bp->dry) {
+    int i;
+    if (g_config_core_archive) sv_push(&bp->core_objs, lib);
+    else for (i = 0; i < g_core_cache.objs.count; i++) sv_push(&bp->core_objs, g_core_cache.objs.items[i]);
+    return 0;
+  }
+
+  cc = get_cc();
+
+  /* build dirs: build/_core/<profile>/{obj,dep,bin} (bin unused) */
+  ensure_dir(g_build_dir);
+  {
+    char cdir[512];
+    path_join(cdir, sizeof(cdir), g_build_dir, "_core");
+    ensure_dir(cdir);
+  }
+  {
+    char cdir[512], pdir[512];
+    path_join(cdir, sizeof(cdir), g_build_dir, "_core");
+    path_join(pdir, sizeof(pdir), cdir, profile_name(p));
+    ensure_dir(pdir);
+  }
+  build_paths(root, sizeof(root), objd, sizeof(objd), depd, sizeof(depd), bind, sizeof(bind), "_core", p);
+  ensure_dir(objd);
+  ensure_dir(depd);
+  ensure_dir(bind);
+
+  /* common includes: include + src + src/core */
+  inc_common[0] = g_inc_dir;
+  inc_common[1] = g_src_dir;
+  inc_common[2] = g_core_dir;
+  inc_common[3] = 0;
+
+  sv_init(&objs);
+  iv_init(&jobs);
+
+  use_pch = plan_add_pch(bp, &pch, cc, g_config_core_pch, root, inc_common, 0, 0, 0, p, force, strict);
+  if (use_pch < 0) {
+    bp->core_failed = 1;
+    sv_free(&objs);
+    iv_free(&jobs);
+    return 1;
+  }
+
+  compile_sources(bp, cc, &g_core_cache.srcs, objd, depd,
+                  inc_common, 0, 0, 0,
+                  use_pch ? &pch : 0,
+                  p, force, strict,
+                  &objs, &jobs);
+
+  if (g_core_cache.objs.count == 0) {
+    int i;
+    for (i = 0; i < objs.count; i++) sv_push(&g_core_cache.objs, objs.items[i]);
+  }
+
+  if (g_config_core_archive) {
+    /* one archive job after all core compiles; links compare against one file */
+    Argv av;
+    int i, idx;
+
+    av_init(&av);
+    push_archiver(&av, cc);
+    av_push(&av, "rcs");
+    av_push(&av, lib);
+    for (i = 0; i < objs.count; i++) av_push(&av, objs.items[i]);
+    av_terminate(&av);
+
+    idx = plan_add_job(bp, JOB_ARCHIVE, av.a, lib, lib);
+    bp->items[idx].force = force;
+    for (i = 0; i < objs.count; i++) sv_push(&bp->items[idx].inputs, objs.items[i]);
+    for (i = 0; i < jobs.count; i++) plan_add_edge(bp, jobs.items[i], idx);
+    av_free(&av);
+
+    sv_push(&bp->core_objs, lib);
+    iv_push(&bp->core_jobs, idx);
+  } else {
+    int i;
+    for (i = 0; i < objs.count; i++) sv_push(&bp->core_objs, objs.items[i]);
+    for (i = 0; i < jobs.count; i++) iv_push(&bp->core_jobs, jobs.items[i]);
+  }
+
+  sv_free(&objs);
+  iv_free(&jobs);
+  return 0;
+}
+
+/* --------------------------- unity builds --------------------------- */
+/* unity = yes: instead of one compiler process per .c file, the (sorted) sources are
+ * grouped into build/<id>/<profile>/unity/unity_N.c files that #include unity_chunk
+ * sources each. The chunks are ordinary compile jobs (depfile per chunk, -j parallel).
+ * A chunk file is only rewritten when its content changes, so untouched chunks stay
+ * up to date. Sources must not clash on static names across one chunk.
+ */
+
+#define TACK_UNITY_CHUNK_DEFAULT 32
+
+/* "../" repeated once per component of dir, i.e. the way back to the project root */
+static void unity_up_prefix(char *out, size_t cap, const char *dir) {
+  const char *p;
+  out[0] = '\0';
+  tack_cat(out, cap, "../");
+  for (p = dir; *p; p++) {
+    if ((*p == '/' || *p == '\\') && p[1] && p[1] != '/' && p[1] != '\\') tack_cat(out, cap, "../");
+  }
+}
+
+/* write path only if its content differs; returns nonzero on error */
+static int write_file_if_changed(const char *path, const char *data, size_t n) {
+  FILE *f = fopen(path, "rb");
+  if (f) {
+    int same = 1;
+    size_t i;
+    for (i = 0; i < n && same; i++) {
+      int c = fgetc(f);
+      if (c == EOF || (char)c != data[i]) same = 0;
+    }
+    if (same && fgetc(f) != EOF) same = 0;
+    fclose(f);
+    if (same) return 0;
+  }
+  f = fopen(path, "wb");
+  if (!f) return 1;
+  if (fwrite(data, 1, n, f) != n) { fclose(f); return 1; }
+  stat_cache_forget(path);
+  return fclose(f) != 0;
+}
+
+/* replace srcs by unity chunks under root/unity */
+static int unity_sources(const char *root, StrVec *srcs, int chunk) {
+  StrVec chunks;
+  char udir[1024], up[256];
+  int i, n;
+
+  if (chunk < 1) chunk = TACK_UNITY_CHUNK_DEFAULT;
+
+  path_join(udir, sizeof(udir), root, "unity");
+  ensure_dir(udir);
+  unity_up_prefix(up, sizeof(up), udir);
+
+  /* stable order: adding one file only shifts the chunks after it */
+  if (srcs->count > 1) qsort(srcs->items, (size_t)srcs->count, sizeof(char*), cmp_str_ptr);
+
+  sv_init(&chunks);
+  for (i = 0, n = 0; i < srcs->count; i += chunk, n++) {
+    char name[64], path[1024];
+    char *buf;
+    size_t len = 0, cap = 256;
+    int k;
+
+    for (k = i; k < srcs->count && k < i + chunk; k++) cap += strlen(up) + strlen(srcs->items[k]) + 16;
+    buf = (char*)xmalloc(cap);
+    buf[0] = '\0';
+    tack_cat(buf, cap, "/* generated by tack (unity build); do not edit */\n");
+    for (k = i; k < srcs->count && k < i + chunk; k++) {
+      const char *q;
+      tack_cat(buf, cap, "#include \"");
+      tack_cat(buf, cap, up);
+      len = strlen(buf);
+      for (q = srcs->items[k]; *q; q++) buf[len++] = (*q == '\\') ? '/' : *q;
+      buf[len] = '\0';
+      tack_cat(buf, cap, "\"\n");
+    }
+    len = strlen(buf);
+
+    sprintf(name, "unity_%d.c", n);
+    path_join(path, sizeof(path), udir, name);
+    if (write_file_if_changed(path, buf, len) != 0) {
+      fprintf(stderr, "tack: cannot write %s\n", path);
+      free(buf);
+      sv_free(&chunks);
+      return 1;
+    }
+    free(buf);
+    sv_push(&chunks, path);
+  }
+
+  /* drop chunks left over from a larger source set */
+  for (;; n++) {
+    char name[64], path[1024];
+    sprintf(name, "unity_%d.c", n);
+    path_join(path, sizeof(path), udir, name);
+    if (!file_exists(path)) break;
+    remove(path);
+  }
+
+  sv_free(srcs);
+  *srcs = chunks;
+  return 0;
+}
+
+/* --------------------------- precompiled headers --------------------------- */
+/* pch = include/common.h ([target]) / core_pch = ... ([project]): the header is
+ * precompiled once per target and profile with the target's own compile flags into
+ * build/<id>/<profile>/pch/common.h.gch (gcc) or .pch (clang), and every compile of
+ * the group gets "-include build/<id>/<profile>/pch/common.h". That stub only
+ * #includes the real header, so a compiler that rejects the pch falls back to
+ * parsing it. The pch is a compile job with its own depfile; objects are rebuilt
+ * after it. tcc has no pch support, the option is ignored there.
+ */
+
+static int cc_is_clang(const char *cc) { return strstr(path_base(cc), "clang") != 0; }
+
+/* fill pc for header under root and queue its compile if dirty; 0 = no pch for cc,
+ * -1 = missing header or unwritable stub (reported; the caller fails its target) */
+static int plan_add_pch(BuildPlan *bp, Pch *pc, const char *cc, const char *header, const char *root,
+                        const char * const *inc_common,
+                        const char * const *inc_extra,
+                        const char * const *def_extra,
+                        const char * const *cflags_extra,
+                        Profile p, int force, int strict) {
+  char pdir[1024], up[512], dep_path[1024];
+  char *stub;
+  size_t n;
+  Argv av;
+  StrVec tmp_defs;
+  Hash64 cmd;
+  int k;
+
+  if (!header || !header[0] || cc_is_tcc(cc)) return 0;
+  if (!file_exists(header) || is_dir_path(header)) {
+    fprintf(stderr, "tack: pch header not found: %s\n", header);
+    return -1;
+  }
+
+  path_join(pdir, sizeof(pdir), root, "pch");
+  ensure_dir(pdir);
+  path_join(pc->inc, sizeof(pc->inc), pdir, path_base(header));
+  tack_copy(pc->out, sizeof(pc->out), pc->inc);
+  tack_cat(pc->out, sizeof(pc->out), cc_is_clang(cc) ? ".pch" : ".gch");
+  tack_copy(dep_path, sizeof(dep_path), pc->inc);
+  tack_cat(dep_path, sizeof(dep_path), ".d");
+  pc->job = -1;
+
+  /* stub next to the pch; quoted includes resolve relative to the stub's directory */
+  up[0] = '\0';
+  if (header[0] != '/' && header[0] != '\\' && !(header[0] && header[1] == ':')) unity_up_prefix(up, sizeof(up), pdir);
+  n = strlen(up) + strlen(header) + 64;
+  stub = (char*)xmalloc(n);
+  tack_copy(stub, n, "/* generated by tack (pch); do not edit */\n#include \"");
+  tack_cat(stub, n, up);
+  tack_cat(stub, n, header);
+  tack_cat(stub, n, "\"\n");
+  if (write_file_if_changed(pc->inc, stub, strlen(stub)) != 0) {
+    fprintf(stderr, "tack: cannot write %s\n", pc->inc);
+    free(stub);
+    return -1;
+  }
+  free(stub);
+
+  /* same flags as the objects that will use it */
+  av_init(&av);
+  sv_init(&tmp_defs);
+
+  av_push(&av, cc);
+
+  push_common_warnings(&av, strict);
+  push_profile_flags(&av, cc, p);
+
+  for (k = 0; inc_common && inc_common[k]; k++) {
+    av_push(&av, "-I");
+    av_push(&av, inc_common[k]);
+  }
+  for (k = 0; inc_extra && inc_extra[k]; k++) {
+    av_push(&av, "-I");
+    av_push(&av, inc_extra[k]);
+  }
+  for (k = 0; def_extra && def_extra[k]; k++) {
+    char *d;
+    n = strlen(def_extra[k]) + 3;
+    d = (char*)xmalloc(n);
+    tack_copy(d, n, "-D");
+    tack_cat(d, n, def_extra[k]);
+    sv_push_own(&tmp_defs, d);
+    av_push(&av, d);
+  }
+  av_push_list(&av, cflags_extra);
+
+  av_push(&av, "-x");
+  av_push(&av, "c-header");
+
+#if USE_DEPFILES
+  av_push(&av, "-MD");
+  av_push(&av, "-MF");
+  av_push(&av, dep_path);
+#endif
+
+  av_push(&av, "-o");
+  av_push(&av, pc->out);
+  av_push(&av, pc->inc);
+
+  av_terminate(&av);
+
+  pc->out_t = file_mtime(pc->out);
+  h64_argv(&cmd, av.a);
+  if (bp->dry || obj_needs_rebuild(pc->out, pc->inc, dep_path, &cmd, force)) {
+    pc->job = plan_add_job(bp, JOB_COMPILE, av.a, pc->inc, pc->out);
+#if USE_DEPFILES
+    bp->items[pc->job].dep = xstrdup(dep_path);
+#endif
+  }
+
+  sv_free(&tmp_defs);
+  av_free(&av);
+  return 1;
+}
+
+/* --------------------------- direct builds (tcc) --------------------------- */
+/* direct = yes / --direct: tcc compiles and links a whole target in one process
+ * ("tcc ... -MD -MF direct.d -o app a.c b.c ... libcore.a"), no objects at all.
+ * It is used when more than half of the target's objects would need a compile
+ * (clean builds, missing objects); otherwise tack keeps the per-object mode for
+ * incremental rebuilds, also right after a direct build (objects of earlier
+ * per-object builds are never removed). The count is a pure up-to-date check: no
+ * jobs, no object cache lookups. One depfile covers every source and header of the exe.
+ */
+
+static int direct_wanted(const char *cc) {
+  return (g_direct_cli || g_config_direct) && cc_is_tcc(cc);
+}
+
+static void direct_argv(Argv *av, StrVec *tmp_defs, const char *cc, const char *out_exe, const char *dep_path,
+                        StrVec *srcs, StrVec *inputs,
+                        const char * const *inc_common,
+                        const TargetOverride *ov,
+                        Profile p, int strict) {
+  int i, k;
+
+  av_push(av, cc);
+
+  push_common_warnings(av, strict);
+  push_profile_flags(av, cc, p);
+
+  for (k = 0; inc_common && inc_common[k]; k++) {
+    av_push(av, "-I");
+    av_push(av, inc_common[k]);
+  }
+  for (k = 0; ov && ov->includes && ov->includes[k]; k++) {
+    av_push(av, "-I");
+    av_push(av, ov->includes[k]);
+  }
+
+  for (k = 0; ov && ov->defines && ov->defines[k]; k++) {
+    char *d;
+    size_t n;
+    n = strlen(ov->defines[k]) + 3;
+    d = (char*)xmalloc(n);
+    tack_copy(d, n, "-D");
+    tack_cat(d, n, ov->defines[k]);
+    sv_push_own(tmp_defs, d);
+    av_push(av, d);
+  }
+
+  if (ov) av_push_list(av, ov->cflags);
+  if (ov) av_push_list(av, ov->ldflags);
+
+  av_push(av, "-MD");
+  av_push(av, "-MF");
+  av_push(av, dep_path);
+
+  av_push(av, "-o");
+  av_push(av, out_exe);
+
+  for (i = 0; i < srcs->count; i++) av_push(av, srcs->items[i]);
+  for (i = 0; inputs && i < inputs->count; i++) av_push(av, inputs->items[i]);
+
+  if (ov) av_push_list(av, ov->libs);
+
+  av_terminate(av);
+}
+
+/* add one target (core, compiles, link) to the plan */
+static int plan_add_target(BuildPlan *bp, const Target *t, Profile p, int force, int strict, int no_core) {
+  const char *cc;
+  const TargetOverride *ov;
+  int use_core;
+
+  StrVec srcs;
+  StrVec objs;
+  IntVec deps;
+
+  char root[512], objd[512], depd[512], bind[512];
+  char out_exe[512];
+
+  const char *inc_common[5];
+
+  cc = get_cc();
+  bp->group = t->name;
+
+  ov = find_override(t->name);
+
+  use_core = 0;
+  if (ov) use_core = ov->use_core;
+  if (no_core) use_core = 0;
+
+  /* prepare dirs */
+  ensure_dir(g_build_dir);
+  {
+    char tdir[512];
+    path_join(tdir, sizeof(tdir), g_build_dir, t->id);
+    ensure_dir(tdir);
+  }
+  {
+    char tdir[512], pdir[512];
+    path_join(tdir, sizeof(tdir), g_build_dir, t->id);
+    path_join(pdir, sizeof(pdir), tdir, profile_name(p));
+    ensure_dir(pdir);
+  }
+  build_paths(root, sizeof(root), objd, sizeof(objd), depd, sizeof(depd), bind, sizeof(bind), t->id, p);
+  ensure_dir(objd);
+  ensure_dir(depd);
+  ensure_dir(bind);
+
+  exe_path(out_exe, sizeof(out_exe), t->id, p, t->bin_base);
+
+  /* scan sources:
+   * - if app is using src/ (not src/app), skip "core" dir so we don't compile shared code twice
+   */
+  sv_init(&srcs);
+  if (streq(t->name, "app") && streq(t->src_dir, g_src_dir) && file_exists(g_core_dir) && is_dir_path(g_core_dir)) {
+    scan_dir_recursive_suffix_skip(&srcs, t->src_dir, ".c", "core");
+  } else {
+    scan_dir_recursive_suffix(&srcs, t->src_dir, ".c");
+  }
+
+  /* allow legacy src/main.c when using src/app */
+  if (streq(t->name, "app") && streq(t->src_dir, g_app_dir)) {
+    if (file_exists("src/main.c")) sv_push(&srcs, "src/main.c");
+  }
+
+  if (srcs.count == 0) {
+    if (!bp->dry) fprintf(stderr, "tack: build: no sources in %s for target %s\n", t->src_dir, t->name);
+    sv_free(&srcs);
+    return 1;
+  }
+
+  if (ov && ov->unity && unity_sources(root, &srcs, ov->unity_chunk) != 0) {
+    sv_free(&srcs);
+    return 1;
+  }
 
-  if (!f) return 1;
-  for (i = 0; lines[i]; i++) fputs(lines[i], f);
-  fclose(f);
-  return 0;
-}
+  sv_init(&objs);
+  iv_init(&deps);
 
-static int tackfile_prepare_generated_ini(void) {
-  const char *cc;
-  char dir[512], gen_c[512], gen_exe[512], gen_ini[512];
-  long tf_t;
+  /* common includes: include + target src dir + src (for shared headers) */
+  inc_common[0] = g_inc_dir;
+  inc_common[1] = t->src_dir;
+  inc_common[2] = g_src_dir;
+  if (file_exists(g_core_dir) && is_dir_path(g_core_dir)) inc_common[3] = g_core_dir;
+  else inc_common[3] = 0;
+  inc_common[4] = 0;
 
-  if (!file_exists("tackfile.c")) return 0;
+  /* core (shared by every target in this plan) */
+  if (use_core) {
+    int i;
+    bp->group = "core";
+    if (build_core(bp, p, force, strict) != 0) {
+      sv_free(&srcs);
+      sv_free(&objs);
+      iv_free(&deps);
+      return 1;
+    }
+    bp->group = t->name;
+    for (i = 0; i < bp->core_jobs.count; i++) iv_push(&deps, bp->core_jobs.items[i]);
+  }
 
-  cc = get_cc();
-  tf_t = file_mtime("tackfile.c");
+  /* direct (tcc): compile + link in one process when that is cheaper */
+  if (direct_wanted(cc) && !bp->dry) {
+    Argv dav;
+    StrVec ddefs, core_in;
+    char ddep[1024];
+    int use_direct = 1;
+
+    path_join(ddep, sizeof(ddep), depd, "direct.d");
+    sv_init(&core_in);
+    if (use_core) {
+      int i;
+      for (i = 0; i < bp->core_objs.count; i++) sv_push(&core_in, bp->core_objs.items[i]);
+    }
 
-  ensure_dir(g_build_dir);
-  path_join(dir, sizeof(dir), g_build_dir, "_tackfile");
-  ensure_dir(dir);
+    av_init(&dav);
+    sv_init(&ddefs);
+    direct_argv(&dav, &ddefs, cc, out_exe, ddep, &srcs, &core_in, inc_common, ov, p, strict);
 
-  tackfile_gen_paths(dir, sizeof(dir), gen_c, sizeof(gen_c), gen_exe, sizeof(gen_exe), gen_ini, sizeof(gen_ini));
+    /* what per-object mode would compile */
+    if (!force) {
+      bp->count_only = 1;
+      bp->ndirty = 0;
+      compile_sources(bp, cc, &srcs, objd, depd,
+                      inc_common,
+                      ov ? ov->includes : 0,
+                      ov ? ov->defines : 0,
+                      ov ? ov->cflags : 0,
+                      0, /* tcc: no pch */
+                      p, force, strict,
+                      &objs, &deps);
+      bp->count_only = 0;
+      sv_free(&objs);
+      if (bp->ndirty * 2 <= srcs.count) use_direct = 0;
+    }
 
-  strncpy(g_tackfile_generated_ini, gen_ini, sizeof(g_tackfile_generated_ini) - 1);
-  g_tackfile_generated_ini[sizeof(g_tackfile_generated_ini) - 1] = '\0';
+    if (use_direct) {
+      int i, idx = plan_add_job(bp, JOB_LINK, dav.a, out_exe, out_exe);
+      bp->items[idx].dep = xstrdup(ddep);
+      bp->items[idx].force = force;
+      for (i = 0; i < core_in.count; i++) sv_push(&bp->items[idx].inputs, core_in.items[i]);
+      for (i = 0; i < deps.count; i++) plan_add_edge(bp, deps.items[i], idx);
+    }
 
-  /* cache: if generated ini is newer than tackfile.c, reuse */
-  if (file_exists(gen_ini) && file_mtime(gen_ini) >= tf_t) return 0;
+    av_free(&dav);
+    sv_free(&ddefs);
+    sv_free(&core_in);
 
-  if (tackfile_write_generator_source(gen_c) != 0) {
-    fprintf(stderr, "tack: tackfile.c: cannot write generator source\n");
-    return 1;
+    if (use_direct) {
+      sv_free(&srcs);
+      sv_free(&objs);
+      iv_free(&deps);
+      return 0;
+    }
   }
 
-  /* compile generator */
   {
-    Argv av;
-    int rc;
-
-    av_init(&av);
-    av_push(&av, cc);
-    av_push(&av, "-I"); av_push(&av, ".");         /* to find tackfile.c */
-    av_push(&av, "-I"); av_push(&av, g_inc_dir);   /* allow includes */
-    av_push(&av, "-o"); av_push(&av, gen_exe);
-    av_push(&av, gen_c);
-    av_terminate(&av);
+    Pch pch;
+    int use_pch = plan_add_pch(bp, &pch, cc, ov ? ov->pch : 0, root,
+                               inc_common,
+                               ov ? ov->includes : 0,
+                               ov ? ov->defines : 0,
+                               ov ? ov->cflags : 0,
+                               p, force, strict);
 
-    rc = run_argv_wait(av.a, 0);
-    if (rc != 0) {
-      fprintf(stderr, "tack: tackfile.c: compile failed\n");
-      print_argv(av.a);
-      av_free(&av);
+    if (use_pch < 0) {
+      sv_free(&srcs);
+      sv_free(&objs);
+      iv_free(&deps);
       return 1;
     }
-    av_free(&av);
+
+    /* compile target sources */
+    compile_sources(bp, cc, &srcs, objd, depd,
+                    inc_common,
+                    ov ? ov->includes : 0,
+                    ov ? ov->defines : 0,
+                    ov ? ov->cflags : 0,
+                    use_pch ? &pch : 0,
+                    p, force, strict,
+                    &objs, &deps);
   }
 
-  /* run generator */
+  /* link: objs + (core objs if any) */
   {
-    char *runv[3];
-    int rc;
-
-    runv[0] = gen_exe;
-    runv[1] = gen_ini;
-    runv[2] = 0;
-
-    rc = run_argv_wait(runv, 0);
-    if (rc != 0) {
-      fprintf(stderr, "tack: tackfile.c: generator failed\n");
-      return 1;
+    int i;
+    if (use_core) {
+      for (i = 0; i < bp->core_objs.count; i++) sv_push(&objs, bp->core_objs.items[i]);
     }
+    link_executable(bp, cc, out_exe, &objs,
+                    inc_common,
+                    ov ? ov->includes : 0,
+                    ov ? ov->defines : 0,
+                    ov ? ov->ldflags : 0,
+                    ov ? ov->libs : 0,
+                    ov ? ov->linker : 0,
+                    p, force, strict, &deps);
   }
 
-  return 0;
-}
-#endif /* !TACK_USE_TACKFILE */
-
-static void config_reset(void) {
-  /* reset INI state and project globals for layered loads */
-  free(g_config_default_target);
-  g_config_default_target = 0;
-  g_config_disable_auto_tools = 0;
-
-  ini_targets_free();
-  ini_overrides_free();
-  ini_targets_init();
-  ini_overrides_init();
+  sv_free(&srcs);
+  sv_free(&objs);
+  iv_free(&deps);
 
-  g_config_loaded = 0;
-  g_config_path[0] = '\0';
+  return 0;
 }
 
-static int config_add_ini_layer(const char *path) {
-  if (!path || !path[0]) return 0;
-  if (ini_load_file(path) != 0) return 1;
+static int pgo_prepare(int verbose, int force, int jobs, int strict, int keep_going, int no_core);
 
-  /* record last loaded path (highest priority) */
-  tack_check_len("config path", path, TACK_MAX_CONFIG_PATH);
-  tack_copy(g_config_path, sizeof(g_config_path), path);
-  g_config_loaded = 1;
-  return 0;
-}
+/* build a list of targets as one DAG with one shared -j pool */
+static int build_targets(const Target **ts, int n, Profile p, int verbose, int force, int jobs, int strict,
+                         int keep_going, int no_core) {
+  BuildPlan bp;
+  int i, rc;
 
-static int config_auto_load(void) {
-  if (g_no_config) return 0;
+  if (p == PROF_RELEASE_PGO && pgo_prepare(verbose, force, jobs, strict, keep_going, no_core) != 0) return 1;
 
-  config_reset();
+  plan_init(&bp, verbose, keep_going);
 
-#ifndef TACK_USE_TACKFILE
-  /* low-priority layer: tackfile.c (compiled on the fly) */
-  if (!g_no_code_config && file_exists("tackfile.c")) {
-    if (tackfile_prepare_generated_ini() != 0) return 1;
-    if (g_tackfile_generated_ini[0]) {
-      if (config_add_ini_layer(g_tackfile_generated_ini) != 0) return 1;
+  for (i = 0; i < n; i++) {
+    if (plan_add_target(&bp, ts[i], p, force, strict, no_core) != 0) {
+      bp.failed = 1;
+      if (!keep_going) { plan_free(&bp); return 1; }
     }
   }
-#endif
 
-  /* high-priority layer: explicit --config, otherwise tack.ini */
-  if (g_config_path_cli && g_config_path_cli[0]) {
-    if (config_add_ini_layer(g_config_path_cli) != 0) return 1;
-  } else if (file_exists("tack.ini")) {
-    if (config_add_ini_layer("tack.ini") != 0) return 1;
-  }
+  rc = plan_run(&bp, jobs);
+  db_save();
+  scan_save();
+  cache_finish(verbose);
 
-  /* finally build override list */
-  ini_materialize_overrides();
-  return 0;
+  /* core is now known clean for the rest of this process */
+  if (rc == 0 && bp.core_added) g_core_cache.clean = 1;
+
+  plan_free(&bp);
+  return rc;
 }
 
-static void config_free(void) {
-  ini_targets_free();
-  ini_overrides_free();
-  free(g_config_default_target);
-  g_config_default_target = 0;
-  g_config_loaded = 0;
-  g_config_path[0] = '\0';
+static int build_one_target(const Target *t, Profile p, int verbose, int force, int jobs, int strict,
+                            int keep_going, int no_core) {
+  return build_targets(&t, 1, p, verbose, force, jobs, strict, keep_going, no_core);
 }
 
+/* --------------------------- tests --------------------------- */
 
-static const Target *find_target(TargetVec *v, const char *name_or_id) {
-  int i;
-  for (i = 0; i < v->count; i++) {
-    if (!v->items[i].enabled) continue;
-    if (streq(v->items[i].name, name_or_id)) return &v->items[i];
-    if (streq(v->items[i].id, name_or_id)) return &v->items[i];
-  }
-  return 0;
+/* build/tests/<profile> (created) */
+static void tests_root_path(char *out, size_t cap, Profile p) {
+  ensure_dir(g_build_dir);
+  path_join(out, cap, g_build_dir, "tests");
+  ensure_dir(out);
+  path_join(out, cap, out, profile_name(p));
+  ensure_dir(out);
 }
 
-static void discover_targets(TargetVec *out, int disable_auto_tools) {
-  /* app: prefer src/app if it exists, otherwise src */
-  if (file_exists(g_app_dir) && is_dir_path(g_app_dir)) {
-    tv_push(out, "app", g_app_dir, "app");
-  } else {
-    tv_push(out, "app", g_src_dir, "app");
-  }
+/* build/tests/<profile>/log/<id>.log (id: the mangled source path, as for objects, so
+ * tests/a/x_test.c and tests/b/x_test.c never share a file): the run job's out, so the
+ * db keys its duration by it */
+static void test_log_path(char *out, size_t cap, const char *tests_root, const char *src) {
+  char name[512];
+  sanitize_path_to_id(name, sizeof(name), src);
+  tack_cat(name, sizeof(name), ".log");
+  path_join(out, cap, tests_root, "log");
+  path_join(out, cap, out, name);
+}
 
-#ifdef TACKFILE_DISABLE_AUTO_TOOLS
-  disable_auto_tools = 1;
-#endif
+/* queue compile (if dirty) + run jobs for every test source; a dry plan only
+ * records the compile commands */
+static void plan_add_tests(BuildPlan *bp, StrVec *tests, const char *tests_root, Profile p, int force, int strict) {
+  int i;
+  const char *cc;
 
-  /* tools/<name> */
-  if (!disable_auto_tools) {
-  if (file_exists(g_tools_dir) && is_dir_path(g_tools_dir)) {
+  char tests_bin[512];
+  char tests_dep[512];
+  char tests_log[512];
+
+  const char *inc_common[4];
+
+  cc = get_cc();
+
+  path_join(tests_bin, sizeof(tests_bin), tests_root, "bin");
+  ensure_dir(tests_bin);
+  path_join(tests_dep, sizeof(tests_dep), tests_root, "dep");
+  ensure_dir(tests_dep);
+  path_join(tests_log, sizeof(tests_log), tests_root, "log");
+  ensure_dir(tests_log);
+
+  inc_common[0] = g_inc_dir;
+  inc_common[1] = g_tests_dir;
+  inc_common[2] = g_src_dir;
+  inc_common[3] = 0;
+
+  bp->group = "tests";
+
+  for (i = 0; i < tests->count; i++) {
+    const char *src = tests->items[i];
+    char name[512], out_exe[1024], dep_path[1024], log_path[1024];
+    int compile_idx = -1, run_idx;
+    Argv av;
+    Hash64 cmd;
+    char *runv[2];
+
+    /* bin/, dep/ and log/ are flat: name by the whole path (tests_a_x_test_c) */
+    sanitize_path_to_id(name, sizeof(name), src);
 
 #ifdef _WIN32
-  {
-    char pattern[1024];
-    WIN32_FIND_DATAA fd;
-    HANDLE h;
+    {
+      char tmp[512];
+      tack_copy(tmp, sizeof(tmp), name);
+      tack_cat(tmp, sizeof(tmp), ".exe");
+      path_join(out_exe, sizeof(out_exe), tests_bin, tmp);
+    }
+#else
+    path_join(out_exe, sizeof(out_exe), tests_bin, name);
+#endif
 
-    tack_copy(pattern, sizeof(pattern), g_tools_dir);
     {
-      size_t ld = strlen(pattern);
-      if (ld > 0 && pattern[ld - 1] != '\\' && pattern[ld - 1] != '/') {
-        pattern[ld] = '\\';
-        pattern[ld + 1] = '\0';
+      char tmp[512];
+      tack_copy(tmp, sizeof(tmp), name);
+      tack_cat(tmp, sizeof(tmp), ".d");
+      path_join(dep_path, sizeof(dep_path), tests_dep, tmp);
+    }
+    test_log_path(log_path, sizeof(log_path), tests_root, src);
+
+    av_init(&av);
+
+    av_push(&av, cc);
+
+    push_common_warnings(&av, strict);
+    push_profile_flags(&av, cc, p);
+
+    /* includes */
+    {
+      int k;
+      for (k = 0; inc_common[k]; k++) {
+        av_push(&av, "-I");
+        av_push(&av, inc_common[k]);
       }
     }
-    tack_cat(pattern, sizeof(pattern), "*");
 
-    h = FindFirstFileA(pattern, &fd);
-    if (h == INVALID_HANDLE_VALUE) return;
+#if USE_DEPFILES
+    av_push(&av, "-MD");
+    av_push(&av, "-MF");
+    av_push(&av, dep_path);
+#endif
 
-    do {
-      if (streq(fd.cFileName, ".") || streq(fd.cFileName, "..")) continue;
-      if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-        char name[256];
-        char *src;
-        char *tname;
-        size_t n;
+    push_linker(&av, cc, 0);
+    av_push(&av, "-o");
+    av_push(&av, out_exe);
+    av_push(&av, src);
 
-        tack_copy(name, sizeof(name), fd.cFileName);
+    av_terminate(&av);
 
-        src = path_join_alloc(g_tools_dir, name);
+    if (bp->dry) {
+      int idx;
+      compdb_add(bp, av.a, src, out_exe);
+      idx = plan_add_job(bp, JOB_COMPILE, av.a, src, out_exe);
+#if USE_DEPFILES
+      bp->items[idx].dep = xstrdup(dep_path);
+#endif
+      av_free(&av);
+      continue;
+    }
 
-        n = strlen("tool:") + strlen(name) + 1;
-        tname = (char*)xmalloc(n);
-        tack_copy(tname, n, "tool:");
-        tack_cat(tname, n, name);
+    h64_argv(&cmd, av.a);
+    if (obj_needs_rebuild(out_exe, src, dep_path, &cmd, force)) {
+      compile_idx = plan_add_job(bp, JOB_COMPILE, av.a, src, out_exe);
+#if USE_DEPFILES
+      bp->items[compile_idx].dep = xstrdup(dep_path);
+#endif
+    }
+    av_free(&av);
 
-        tv_push(out, tname, src, name);
+    /* run test */
+    runv[0] = out_exe;
+    runv[1] = 0;
+    run_idx = plan_add_job(bp, JOB_TEST, runv, src, log_path);
+    if (compile_idx >= 0) plan_add_edge(bp, compile_idx, run_idx);
+  }
+}
 
-        free(tname);
-        free(src);
+/* --------------------------- test selection and reports --------------------------- */
+/* For CI: --filter keeps the tests whose path contains the pattern; --shard I/N sorts
+ * the rest by path and keeps shard I. Every node must compute the same split, so it
+ * only depends on the command line and the files: without --shard-timings it is
+ * round-robin over the sorted paths; --shard-timings FILE (repeatable; --json reports
+ * of an earlier run, e.g. a CI artifact) deals the tests out longest first, each to
+ * the least loaded shard (tests missing from the files count as the mean). The
+ * "split" checksum covers the whole assignment: equal on every node or the nodes
+ * disagree. --junit/--json FILE write the results of the tests that ran here. */
+#define TACK_MAX_TIMINGS 16
+
+typedef struct {
+  const char *filter;   /* substring of the path ('/' separators), 0 = all */
+  int shard, shards;    /* 1-based; shards = 0: no sharding */
+  const char *timings[TACK_MAX_TIMINGS];
+  int ntimings;
+  const char *junit;    /* report files, 0 = none */
+  const char *json;
+  char split[17];       /* checksum of the shard assignment, "" = not sharded */
+} TestSel;
+
+typedef struct { long ms; int idx; } TestWeight;
+
+static int test_weight_cmp(const void *a, const void *b) {
+  const TestWeight *x = (const TestWeight*)a, *y = (const TestWeight*)b;
+  if (x->ms != y->ms) return x->ms > y->ms ? -1 : 1;
+  return x->idx - y->idx;
+}
+
+/* --shard I/N */
+static int parse_shard(const char *v, int *shard, int *shards) {
+  const char *slash = strchr(v, '/');
+  char num[16];
+  size_t n;
+  if (!slash || (n = (size_t)(slash - v)) == 0 || n >= sizeof(num)) return 0;
+  memcpy(num, v, n);
+  num[n] = '\0';
+  *shard = parse_int(num);
+  *shards = parse_int(slash + 1);
+  return *shards >= 1 && *shard >= 1 && *shard <= *shards;
+}
+
+/* the JSON string at *p (escapes of our own reports: \" \\ \uXXXX) into out */
+static const char *timings_str(const char *p, char *out, size_t cap) {
+  size_t n = 0;
+  if (*p != '"') return 0;
+  for (p++; *p && *p != '"'; p++) {
+    char c = *p;
+    if (c == '\\' && p[1]) {
+      p++;
+      if (*p == 'u') { c = '?'; if (strlen(p) > 4) p += 4; }
+      else c = *p;
+    }
+    if (n + 1 >= cap) return 0;
+    out[n++] = c;
+  }
+  out[n] = '\0';
+  return *p ? p + 1 : 0;
+}
+
+/* "name"/"ms" of every test in a --json report; later files override earlier ones */
+static int timings_load(const char *path, StrVec *names, long **ms) {
+  FILE *f = fopen(path, "rb");
+  StrBuf b;
+  const char *p;
+  int c;
+
+  if (!f) { fprintf(stderr, "tack: test: cannot read --shard-timings %s\n", path); return 1; }
+  sb_init(&b);
+  while ((c = fgetc(f)) != EOF) sb_putc(&b, c ? (char)c : ' ');
+  fclose(f);
+  for (p = b.p; p && (p = strstr(p, "{\"name\": ")) != 0; ) {
+    char name[1024];
+    const char *q = timings_str(p + 9, name, sizeof(name)), *end, *m;
+    if (!q) break;
+    end = strchr(q, '}');
+    m = strstr(q, "\"ms\": ");
+    if (end && m && m < end) {
+      long v = strtol(m + 6, 0, 10);
+      int i, k = -1;
+      for (i = 0; i < names->count; i++) if (streq(names->items[i], name)) { k = i; break; }
+      if (k < 0) {
+        sv_push(names, name);
+        *ms = (long*)xrealloc(*ms, (size_t)names->count * sizeof(long));
+        k = names->count - 1;
+        (*ms)[k] = 0;
       }
-    } while (FindNextFileA(h, &fd));
+      if (v > 0) (*ms)[k] = v; /* cached or unrun entries keep the earlier time */
+    }
+    p = q;
+  }
+  sb_free(&b);
+  return 0;
+}
 
-    FindClose(h);
+/* narrow tests to sel and fill sel->split; returns the expected ms of the kept tests
+ * (-1 = error, 0 = no timings) */
+static long test_select(StrVec *tests, TestSel *sel) {
+  StrVec keep, tnames;
+  TestWeight *w;
+  long *load, *tms = 0, sum = 0, mine = 0;
+  int i, known = 0;
+  Hash64 h;
+  char norm[1024];
+
+  sv_init(&keep);
+  for (i = 0; i < tests->count; i++) {
+    path_normalize(norm, sizeof(norm), tests->items[i]);
+    if (!sel->filter || strstr(norm, sel->filter)) sv_push(&keep, tests->items[i]);
   }
-#else
-  {
-    DIR *d;
-    struct dirent *e;
+  sv_free(tests);
+  *tests = keep;
+  if (sel->shards <= 1 || tests->count == 0) return 0;
 
-    d = opendir(g_tools_dir);
-    if (!d) return;
+  sv_init(&tnames);
+  for (i = 0; i < sel->ntimings; i++) {
+    if (timings_load(sel->timings[i], &tnames, &tms) != 0) { sv_free(&tnames); free(tms); return -1; }
+  }
 
-    while ((e = readdir(d)) != 0) {
-      char *full;
-      if (streq(e->d_name, ".") || streq(e->d_name, "..")) continue;
-      full = path_join_alloc(g_tools_dir, e->d_name);
-      if (is_dir_path(full)) {
-        char *tname;
-        size_t n;
-        n = strlen("tool:") + strlen(e->d_name) + 1;
-        tname = (char*)xmalloc(n);
-        tack_copy(tname, n, "tool:");
-        tack_cat(tname, n, e->d_name);
-        tv_push(out, tname, full, e->d_name);
-        free(tname);
-    }
-      free(full);
+  qsort(tests->items, (size_t)tests->count, sizeof(char*), cmp_str_ptr);
+  w = (TestWeight*)xmalloc((size_t)tests->count * sizeof(TestWeight));
+  for (i = 0; i < tests->count; i++) {
+    int k;
+    path_normalize(norm, sizeof(norm), tests->items[i]);
+    w[i].ms = -1;
+    w[i].idx = i;
+    for (k = 0; k < tnames.count; k++) if (streq(tnames.items[k], norm) && tms[k] > 0) { w[i].ms = tms[k]; break; }
+    if (w[i].ms > 0) { sum += w[i].ms; known++; }
   }
-    closedir(d);
+  sv_free(&tnames);
+  free(tms);
+  for (i = 0; i < tests->count; i++) if (w[i].ms < 0) w[i].ms = known ? sum / known : 1;
+  if (known) qsort(w, (size_t)tests->count, sizeof(TestWeight), test_weight_cmp);
+
+  load = (long*)xmalloc((size_t)sel->shards * sizeof(long));
+  for (i = 0; i < sel->shards; i++) load[i] = 0;
+  h64_init(&h);
+  sv_init(&keep);
+  for (i = 0; i < tests->count; i++) {
+    int k, best = 0;
+    unsigned char sb[2];
+    for (k = 1; k < sel->shards; k++) if (load[k] < load[best]) best = k;
+    load[best] += w[i].ms;
+    path_normalize(norm, sizeof(norm), tests->items[w[i].idx]);
+    h64_update(&h, norm, strlen(norm) + 1);
+    sb[0] = (unsigned char)(best & 0xff);
+    sb[1] = (unsigned char)((best >> 8) & 0xff);
+    h64_update(&h, sb, 2);
+    if (best == sel->shard - 1) { sv_push(&keep, tests->items[w[i].idx]); mine += w[i].ms; }
   }
-#endif
+  h64_hex(sel->split, &h);
+  free(load);
+  free(w);
+  sv_free(tests);
+  *tests = keep;
+  /* run in path order, not weight order */
+  if (tests->count > 1) qsort(tests->items, (size_t)tests->count, sizeof(char*), cmp_str_ptr);
+  return known ? mine : 0;
 }
+
+/* s with XML markup and the control characters XML 1.0 forbids escaped */
+static void sb_xml_str(StrBuf *b, const char *s) {
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '<') sb_puts(b, "&lt;");
+    else if (c == '>') sb_puts(b, "&gt;");
+    else if (c == '&') sb_puts(b, "&amp;");
+    else if (c == '"') sb_puts(b, "&quot;");
+    else if (c < 0x20 && c != '\t' && c != '\n' && c != '\r') sb_putc(b, '?');
+    else sb_putc(b, (char)c);
   }
 }
 
-/* --------------------------- build paths --------------------------- */
+/* the first 64 KiB of a test log */
+static void test_log_read(StrBuf *b, const char *path) {
+  FILE *f = fopen(path, "rb");
+  int c;
+  size_t n = 0;
+  if (!f) return;
+  while ((c = fgetc(f)) != EOF) {
+    if (n++ == 65536) { sb_puts(b, "\n[log truncated]\n"); break; }
+    sb_putc(b, c ? (char)c : '?');
+  }
+  fclose(f);
+}
 
-/* build/<target>/<profile>/{obj,dep,bin} */
-static void build_paths(char *root, size_t root_cap,
-                        char *objd, size_t objd_cap,
-                        char *depd, size_t depd_cap,
-                        char *bind, size_t bind_cap,
-                        const char *target_id, Profile p) {
-  char tdir[512];
-  char pdir[512];
+static int test_write_junit(const char *path, const BuildPlan *bp, const TestSel *sel, Profile p, long ms) {
+  FILE *f;
+  StrBuf b;
+  int i, n = 0, failed = 0, skipped = 0;
+
+  for (i = 0; i < bp->count; i++) {
+    const PlanJob *j = &bp->items[i];
+    if (j->kind != JOB_TEST) continue;
+    n++;
+    if (j->rc > 0) failed++;
+    else if (j->rc < 0) skipped++;
+  }
 
-  path_join(tdir, sizeof(tdir), g_build_dir, target_id);
-  path_join(pdir, sizeof(pdir), tdir, profile_name(p));
+  f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "tack: test: cannot write %s\n", path); return 1; }
+  fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n", f);
+  fprintf(f, "<testsuites tests=\"%d\" failures=\"%d\" skipped=\"%d\" time=\"%ld.%03ld\">\n",
+          n, failed, skipped, ms / 1000, ms % 1000);
+  fprintf(f, "  <testsuite name=\"tack %s", profile_name(p));
+  if (sel->shards > 1) fprintf(f, " shard %d/%d", sel->shard, sel->shards);
+  fprintf(f, "\" tests=\"%d\" failures=\"%d\" skipped=\"%d\" time=\"%ld.%03ld\">\n",
+          n, failed, skipped, ms / 1000, ms % 1000);
+  sb_init(&b);
+  for (i = 0; i < bp->count; i++) {
+    const PlanJob *j = &bp->items[i];
+    char norm[1024];
+    if (j->kind != JOB_TEST) continue;
+    path_normalize(norm, sizeof(norm), j->label);
+    sb_clear(&b);
+    sb_xml_str(&b, norm);
+    fprintf(f, "    <testcase name=\"%s\" classname=\"", b.p);
+    {
+      /* classname: the directory, dotted (tests.sub) */
+      char *slash = strrchr(norm, '/'), *c;
+      if (slash) *slash = '\0'; else tack_copy(norm, sizeof(norm), "tests");
+      for (c = norm; *c; c++) if (*c == '/') *c = '.';
+      sb_clear(&b);
+      sb_xml_str(&b, norm);
+    }
+    fprintf(f, "%s\" time=\"%ld.%03ld\"", b.p, j->ms / 1000, j->ms % 1000);
+    if (j->rc == 0) {
+      fputs(j->reused ? ">\n      <system-out>cached PASS</system-out>\n    </testcase>\n" : "/>\n", f);
+    } else if (j->rc < 0) {
+      fputs(">\n      <skipped message=\"not run\"/>\n    </testcase>\n", f);
+    } else {
+      StrBuf log;
+      sb_init(&log);
+      test_log_read(&log, j->out);
+      sb_clear(&b);
+      if (log.p) sb_xml_str(&b, log.p);
+      fprintf(f, ">\n      <failure message=\"exit %d\">%s</failure>\n    </testcase>\n", j->rc, b.p ? b.p : "");
+      sb_free(&log);
+    }
+  }
+  fputs("  </testsuite>\n</testsuites>\n", f);
+  sb_free(&b);
+  return fclose(f) != 0;
+}
 
-  tack_copy(root, root_cap, pdir);
-  path_join(objd, objd_cap, root, "obj");
-  path_join(depd, depd_cap, root, "dep");
-  path_join(bind, bind_cap, root, "bin");
+static int test_write_json(const char *path, const BuildPlan *bp, const TestSel *sel, Profile p, long ms) {
+  FILE *f;
+  StrBuf b;
+  int i, first = 1;
+
+  f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "tack: test: cannot write %s\n", path); return 1; }
+  fprintf(f, "{\n  \"profile\": \"%s\",\n  \"shard\": %d,\n  \"shards\": %d,\n",
+          profile_name(p), sel->shards > 1 ? sel->shard : 1, sel->shards > 1 ? sel->shards : 1);
+  sb_init(&b);
+  sb_json_str(&b, sel->filter ? sel->filter : "");
+  fprintf(f, "  \"filter\": %s,\n  \"split\": \"%s\",\n  \"ms\": %ld,\n  \"tests\": [", b.p, sel->split, ms);
+  for (i = 0; i < bp->count; i++) {
+    const PlanJob *j = &bp->items[i];
+    char norm[1024];
+    const char *status;
+    if (j->kind != JOB_TEST) continue;
+    status = j->rc == 0 ? (j->reused ? "cached" : "pass") : j->rc > 0 ? "fail" : "not_run";
+    path_normalize(norm, sizeof(norm), j->label);
+    sb_clear(&b);
+    sb_json_str(&b, norm);
+    fprintf(f, "%s\n    {\"name\": %s, \"status\": \"%s\", \"exit\": %d, \"ms\": %ld, ",
+            first ? "" : ",", b.p, status, j->rc, j->ms);
+    path_normalize(norm, sizeof(norm), j->out);
+    sb_clear(&b);
+    sb_json_str(&b, norm);
+    fprintf(f, "\"log\": %s}", b.p);
+    first = 0;
+  }
+  fputs(first ? "]\n}\n" : "\n  ]\n}\n", f);
+  sb_free(&b);
+  return fclose(f) != 0;
 }
 
-static void exe_path(char *out, size_t out_cap, const char *target_id, Profile p, const char *bin_base) {
-  char root[512], objd[512], depd[512], bind[512];
-  char fn[256];
+/* tests: every tests/..._test.c is compiled into its own binary (depfile + build db, like
+ * objects) and run as a plan job after its compile, up to -j at once. Each test's
+ * stdout/stderr goes to build/tests/<profile>/log/<id>.log and is shown on failure.
+ * sel (0 = all, no reports): see test selection above.
+ */
+static int build_and_run_tests(Profile p, int verbose, int force, int jobs, int strict, int keep_going,
+                               int test_cache, TestSel *sel) {
+  StrVec tests;
+  BuildPlan bp;
+  TestResults results;
+  char results_path[1024];
+  char tests_root[512];
+  int i, rc, passed = 0, failed = 0, skipped = 0;
+  long t0, ms;
 
-  build_paths(root, sizeof(root),
-              objd, sizeof(objd),
-              depd, sizeof(depd),
-              bind, sizeof(bind),
-              target_id, p);
+  sv_init(&tests);
+  scan_dir_recursive_suffix(&tests, g_tests_dir, "_test.c");
+  if (tests.count == 0) {
+    printf("tack: test: no tests found under %s\n", g_tests_dir);
+    sv_free(&tests);
+    return 0;
+  }
 
-#ifdef _WIN32
-  tack_copy(fn, sizeof(fn), bin_base);
-  tack_cat(fn, sizeof(fn), ".exe");
-#else
-  tack_copy(fn, sizeof(fn), bin_base);
-#endif
-  path_join(out, out_cap, bind, fn);
-}
+  tests_root_path(tests_root, sizeof(tests_root), p);
+  if (sel) {
+    int all = tests.count;
+    long est = test_select(&tests, sel);
+    if (est < 0) {
+      sv_free(&tests);
+      return 1;
+    }
+    if (sel->shards > 1) {
+      printf("tests: shard %d/%d: %d of %d", sel->shard, sel->shards, tests.count, all);
+      if (est > 0) printf(" (~%ld ms expected)", est);
+      printf(", split %s\n", sel->split);
+    } else if (sel->filter) {
+      printf("tests: %d of %d match %s\n", tests.count, all, sel->filter);
+    }
+  }
 
-/* --------------------------- compilation helpers --------------------------- */
+  if (tests.count && p == PROF_RELEASE_PGO && pgo_prepare(verbose, force, jobs, strict, keep_going, 0) != 0) {
+    sv_free(&tests);
+    return 1;
+  }
 
-static void push_profile_flags(Argv *av, Profile p) {
-  if (p == PROF_DEBUG) {
-    av_push(av, "-g");
-    av_push(av, "-bt20");
-    av_push(av, "-DDEBUG=1");
-  } else {
-    av_push(av, "-O2");
-    av_push(av, "-DNDEBUG=1");
+  plan_init(&bp, verbose, keep_going);
+
+  test_results_init(&results);
+  path_join(results_path, sizeof(results_path), tests_root, "results.cache");
+  test_results_load(&results, results_path);
+  bp.test_results = &results;
+  bp.test_reuse = test_cache;
+  test_salt(&bp.test_salt);
+
+  plan_add_tests(&bp, &tests, tests_root, p, force, strict);
+
+  t0 = now_ms();
+  rc = plan_run(&bp, jobs);
+  db_save();
+  scan_save();
+  test_results_save(&results, results_path);
+
+  for (i = 0; i < bp.count; i++) {
+    PlanJob *j = &bp.items[i];
+    if (j->kind != JOB_TEST) continue;
+    if (j->rc == 0) passed++;
+    else if (j->rc > 0) failed++;
+    else skipped++;
   }
+  printf("tests: %d passed, %d failed", passed, failed);
+  if (bp.tests_cached) printf(", %d cached", bp.tests_cached);
+  if (skipped) printf(", %d not run", skipped);
+  ms = now_ms() - t0;
+  printf(" (%ld ms)\n", ms);
+
+  if (sel && sel->junit && test_write_junit(sel->junit, &bp, sel, p, ms) != 0) rc = 1;
+  if (sel && sel->json && test_write_json(sel->json, &bp, sel, p, ms) != 0) rc = 1;
+  if (bp.tests_failed || skipped) rc = 1;
+  plan_free(&bp);
+  test_results_free(&results);
+  sv_free(&tests);
+  return rc;
 }
 
-static void push_common_warnings(Argv *av, int strict) {
-  av_push_list(av, g_warn_flags_base);
-  if (strict) av_push_list(av, g_warn_flags_strict_add);
+/* --------------------------- pgo --------------------------- */
+/* release-pgo: build release-pgo-gen, train it, merge build/pgo/raw into
+ * build/pgo/<hash>/, then build release-pgo against that profile. The training set
+ * is always every enabled target, whichever command asked (build --target X, test),
+ * so they all share one live profile. Training is [project] pgo_train, run once per
+ * target with TACK_PGO_EXE set to its instrumented binary; it is required, a test
+ * suite rarely exercises the app's hot paths. gcc names each .gcda after its object
+ * path, so the merge renames release-pgo-gen to release-pgo and fails when a target
+ * got no profile at all; clang's .profraw files go through llvm-profdata
+ * (TACK_PROFDATA). Training is skipped while the command and the instrumented
+ * binaries are unchanged.
+ */
+
+static int pgo_hash_file(Hash64 *h, const char *path) {
+  FILE *f;
+  char buf[16384];
+  size_t n;
+
+  f = fopen(path, "rb");
+  if (!f) return 1;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) h64_update(h, buf, n);
+  fclose(f);
+  return 0;
 }
 
-/* spawn compile jobs with -j pool */
-static int compile_sources(const char *cc, StrVec *srcs, const char *objd, const char *depd,
-                           const char * const *inc_common,
-                           const char * const *inc_extra,
-                           const char * const *def_extra,
-                           const char * const *cflags_extra,
-                           Profile p, int verbose, int force, int jobs, int strict,
-                           StrVec *out_objs) {
-  Proc *running;
-  int running_n;
+/* sorted names of the regular files in dir */
+static void pgo_list(StrVec *out, const char *dir) {
+  ScanDir e;
   int i;
 
-  if (jobs < 1) jobs = 1;
+  memset(&e, 0, sizeof(e));
+  scan_read_dir(&e, dir);
+  for (i = 0; i < e.names.count; i++) {
+    if (e.kinds[i] == SCAN_FILE) sv_push(out, e.names.items[i]);
+  }
+  scan_clear_entry(&e);
+  if (out->count > 1) qsort(out->items, (size_t)out->count, sizeof(char*), cmp_str_ptr);
+}
 
-  running = (Proc*)xmalloc((size_t)jobs * sizeof(Proc));
-  running_n = 0;
+/* the .gcda name the release-pgo object looks for */
+static void pgo_gcda_name(char *out, size_t cap, const char *name) {
+  const char *gen = strstr(name, "release-pgo-gen");
+  if (!gen) { tack_copy(out, cap, name); return; }
+  if ((size_t)(gen - name) >= cap) tack_die("path too long");
+  memcpy(out, name, (size_t)(gen - name));
+  out[gen - name] = '\0';
+  tack_cat(out, cap, "release-pgo");
+  tack_cat(out, cap, gen + strlen("release-pgo-gen"));
+}
 
-  for (i = 0; i < srcs->count; i++) {
-    const char *src = srcs->items[i];
-    char sid[512], obj_name[768], dep_name[768];
-    char obj_path[1024], dep_path[1024];
+/* what a pgo_train run depends on: the command and every instrumented binary */
+static void pgo_train_sig(char *hex, const Target **ts, int n) {
+  Hash64 h;
+  char exe[512];
+  int i;
 
-    sanitize_path_to_id(sid, sizeof(sid), src);
-    tack_copy(obj_name, sizeof(obj_name), sid); tack_cat(obj_name, sizeof(obj_name), ".o");
-    tack_copy(dep_name, sizeof(dep_name), sid); tack_cat(dep_name, sizeof(dep_name), ".d");
+  h64_init(&h);
+  h64_update(&h, g_config_pgo_train, strlen(g_config_pgo_train) + 1);
+  for (i = 0; i < n; i++) {
+    exe_path(exe, sizeof(exe), ts[i]->id, PROF_PGO_GEN, ts[i]->bin_base);
+    h64_update(&h, exe, strlen(exe) + 1);
+    pgo_hash_file(&h, exe);
+  }
+  h64_hex(hex, &h);
+}
 
-    path_join(obj_path, sizeof(obj_path), objd, obj_name);
-    path_join(dep_path, sizeof(dep_path), depd, dep_name);
+static int pgo_train(const Target **ts, int n, int verbose) {
+  static char env[600];
+  int i, rc;
 
-    sv_push(out_objs, obj_path);
+  for (i = 0; i < n; i++) {
+    char exe[512];
+    char *argv[4];
 
-    if (!obj_needs_rebuild(obj_path, src, dep_path, force)) continue;
+    exe_path(exe, sizeof(exe), ts[i]->id, PROF_PGO_GEN, ts[i]->bin_base);
+    tack_copy(env, sizeof(env), "TACK_PGO_EXE=");
+    tack_cat(env, sizeof(env), exe);
+#ifdef _WIN32
+    _putenv(env);
+    argv[0] = "cmd";
+    argv[1] = "/c";
+#else
+    putenv(env);
+    argv[0] = "sh";
+    argv[1] = "-c";
+#endif
+    argv[2] = g_config_pgo_train;
+    argv[3] = 0;
 
-    /* build argv */
-    {
-      Argv av;
-      StrVec tmp_defs;
-      av_init(&av);
-      sv_init(&tmp_defs);
+    printf("pgo: training %s\n", ts[i]->name);
+    rc = run_argv_wait(argv, verbose, 0);
+    if (rc != 0) {
+      fprintf(stderr, "tack: pgo: training %s failed (exit %d): %s\n", ts[i]->name, rc, g_config_pgo_train);
+      return 1;
+    }
+  }
+  return 0;
+}
 
-      av_push(&av, cc);
-      av_push(&av, "-c");
+/* gcc: a target's objects left <...>#<id>#release-pgo[-gen]#<...>.gcda behind */
+static int pgo_covers(const StrVec *names, const Target *t) {
+  char pat[600];
+  int i;
+  tack_copy(pat, sizeof(pat), "#");
+  tack_cat(pat, sizeof(pat), t->id);
+  tack_cat(pat, sizeof(pat), "#release-pgo");
+  for (i = 0; i < names->count; i++) if (strstr(names->items[i], pat)) return 1;
+  return 0;
+}
 
-      push_common_warnings(&av, strict);
-      push_profile_flags(&av, p);
+/* raw -> build/pgo/<hash>/ and build/pgo/current; train = signature recorded with it */
+static int pgo_merge(const char *cc, const char *train, const Target **ts, int n, int verbose) {
+  char raw[1024], dir[1024], file[1100], hex[17], old[17];
+  StrVec names;
+  Hash64 h;
+  int i, rc = 0;
+
+  pgo_path(raw, sizeof(raw), "raw");
+  sv_init(&names);
+  pgo_list(&names, raw);
+  if (names.count == 0) {
+    fprintf(stderr, "tack: pgo: the training run wrote no profile to %s\n", raw);
+    sv_free(&names);
+    return 1;
+  }
+  if (!cc_is_clang(cc)) {
+    for (i = 0; i < n; i++) {
+      if (pgo_covers(&names, ts[i])) continue;
+      fprintf(stderr, "tack: pgo: training left no profile for target %s (does pgo_train run \"$TACK_PGO_EXE\"?)\n",
+              ts[i]->name);
+      rc = 1;
+    }
+    if (rc != 0) { sv_free(&names); return 1; }
+  }
 
-      /* includes */
-      {
-        int k;
-        for (k = 0; inc_common && inc_common[k]; k++) {
-          av_push(&av, "-I");
-          av_push(&av, inc_common[k]);
-        }
-        for (k = 0; inc_extra && inc_extra[k]; k++) {
-          av_push(&av, "-I");
-          av_push(&av, inc_extra[k]);
-        }
-      }
+  h64_init(&h);
+  if (cc_is_clang(cc)) {
+    const char *tool = getenv("TACK_PROFDATA");
+    StrVec full;
+    Argv av;
 
-      /* extra defines */
-      {
-        int k;
-        for (k = 0; def_extra && def_extra[k]; k++) {
-          char *d;
-          size_t n;
-          n = strlen(def_extra[k]) + 3;
-          d = (char*)xmalloc(n);
-          tack_copy(d, n, "-D");
-          tack_cat(d, n, def_extra[k]);
-          sv_push_own(&tmp_defs, d);
-          av_push(&av, d);
-        }
+    pgo_path(file, sizeof(file), "merged.tmp");
+    sv_init(&full);
+    av_init(&av);
+    av_push(&av, (tool && tool[0]) ? tool : "llvm-profdata");
+    av_push(&av, "merge");
+    av_push(&av, "-o");
+    av_push(&av, file);
+    for (i = 0; i < names.count; i++) sv_push_own(&full, path_join_alloc(raw, names.items[i]));
+    for (i = 0; i < full.count; i++) av_push(&av, full.items[i]);
+    av_terminate(&av);
+    rc = run_argv_wait(av.a, verbose, 0);
+    av_free(&av);
+    sv_free(&full);
+    if (rc != 0) fprintf(stderr, "tack: pgo: %s merge failed\n", (tool && tool[0]) ? tool : "llvm-profdata");
+    else if (pgo_hash_file(&h, file) != 0) rc = 1;
+  } else {
+    for (i = 0; i < names.count && rc == 0; i++) {
+      char name[512], *from;
+      pgo_gcda_name(name, sizeof(name), names.items[i]);
+      h64_update(&h, name, strlen(name) + 1);
+      from = path_join_alloc(raw, names.items[i]);
+      if (pgo_hash_file(&h, from) != 0) rc = 1;
+      free(from);
+    }
+  }
+  if (rc != 0) { sv_free(&names); return 1; }
+
+  h64_hex(hex, &h);
+  pgo_path(dir, sizeof(dir), hex);
+  if (!is_dir_path(dir)) {
+    ensure_dir(dir);
+    if (cc_is_clang(cc)) {
+      char to[1100];
+      path_join(to, sizeof(to), dir, "merged.profdata");
+      if (rename(file, to) != 0) rc = 1;
+    } else {
+      for (i = 0; i < names.count && rc == 0; i++) {
+        char name[512], to[1100], *from;
+        pgo_gcda_name(name, sizeof(name), names.items[i]);
+        path_join(to, sizeof(to), dir, name);
+        from = path_join_alloc(raw, names.items[i]);
+        if (copy_file(from, to) != 0) rc = 1;
+        free(from);
       }
+    }
+    if (rc != 0) {
+      fprintf(stderr, "tack: pgo: cannot write %s\n", dir);
+      rm_rf(dir);
+      sv_free(&names);
+      return 1;
+    }
+  } else if (cc_is_clang(cc)) {
+    remove(file);
+  }
 
+  /* one profile is live at a time */
+  pgo_load();
+  tack_copy(old, sizeof(old), g_pgo.cur);
+  if (old[0] && !streq(old, hex)) {
+    char odir[1024];
+    pgo_path(odir, sizeof(odir), old);
+    stat_cache_forget(odir);
+    if (rm_rf(odir) != 0) fprintf(stderr, "tack: pgo: cannot remove %s\n", odir);
+  }
+  tack_copy(g_pgo.cur, sizeof(g_pgo.cur), hex);
+  tack_copy(g_pgo.train, sizeof(g_pgo.train), train);
+  g_pgo.use_flag[0] = '\0';
+  {
+    FILE *f;
+    pgo_path(file, sizeof(file), "current");
+    f = fopen(file, "wb");
+    if (f) {
+      fprintf(f, "%s %s\n", g_pgo.cur, g_pgo.train);
+      fclose(f);
+    }
+  }
+  printf("pgo: profile %s (%d file%s)\n", hex, names.count, names.count == 1 ? "" : "s");
+  sv_free(&names);
+  return 0;
+}
 
-      /* extra cflags */
-      av_push_list(&av, cflags_extra);
+static int pgo_prepare_set(const char *cc, const Target **ts, int n, int verbose, int force, int jobs,
+                           int strict, int keep_going, int no_core) {
+  char train[17], raw[1024];
 
-#if USE_DEPFILES
-      av_push(&av, "-MD");
-      av_push(&av, "-MF");
-      av_push(&av, dep_path);
-#endif
+  if (build_targets(ts, n, PROF_PGO_GEN, verbose, force, jobs, strict, keep_going, no_core) != 0) return 1;
 
-      av_push(&av, "-o");
-      av_push(&av, obj_path);
-      av_push(&av, src);
+  pgo_train_sig(train, ts, n);
+  pgo_load();
+  if (g_pgo.cur[0] && streq(g_pgo.train, train) && !force) {
+    char dir[1024];
+    pgo_path(dir, sizeof(dir), g_pgo.cur);
+    if (is_dir_path(dir)) {
+      if (verbose) printf("pgo: profile %s is current\n", g_pgo.cur);
+      return 0;
+    }
+  }
 
-      av_terminate(&av);
+  ensure_dir(g_build_dir);
+  pgo_path(raw, sizeof(raw), 0);
+  ensure_dir(raw);
+  pgo_path(raw, sizeof(raw), "raw");
+  ensure_dir(raw);
+  rm_rf_contents(raw);
+
+  if (pgo_train(ts, n, verbose) != 0) return 1;
+  return pgo_merge(cc, train, ts, n, verbose);
+}
 
-      if (verbose) print_argv(av.a);
+/* everything release-pgo needs before its own plan: instrumented build of the training
+ * set, training, merge */
+static int pgo_prepare(int verbose, int force, int jobs, int strict, int keep_going, int no_core) {
+  const char *cc = get_cc();
+  const Target **ts;
+  int i, n = 0, rc;
 
-      if (jobs == 1) {
-        int rc = run_argv_wait(av.a, 0);
-        sv_free(&tmp_defs);
-        av_free(&av);
-        if (rc != 0) { free(running); return 1; }
-      } else {
-        if (running_n >= jobs) {
-          int rcw = proc_wait(&running[0]);
-          int m;
-          for (m = 1; m < running_n; m++) running[m - 1] = running[m];
-          running_n--;
-          if (rcw != 0) { sv_free(&tmp_defs); av_free(&av); free(running); return 1; }
-        }
-        if (proc_spawn_nowait(av.a, &running[running_n]) != 0) { sv_free(&tmp_defs); av_free(&av); free(running); return 1; }
-        running_n++;
-        sv_free(&tmp_defs);
-        av_free(&av);
-      }
-    }
+  if (cc_is_tcc(cc)) return 0; /* push_profile_flags warns: plain release */
+
+  if (!g_config_pgo_train) {
+    fprintf(stderr, "tack: release-pgo needs [project] pgo_train, a command that runs \"$TACK_PGO_EXE\"\n"
+                    "tack: (once per enabled target, with its instrumented binary)\n");
+    return 1;
+  }
+  ts = (const Target**)xmalloc((size_t)(g_pgo.tv ? g_pgo.tv->count + 1 : 1) * sizeof(Target*));
+  for (i = 0; g_pgo.tv && i < g_pgo.tv->count; i++) {
+    if (g_pgo.tv->items[i].enabled) ts[n++] = &g_pgo.tv->items[i];
+  }
+  if (n == 0) {
+    fprintf(stderr, "tack: release-pgo: no enabled target to train\n");
+    rc = 1;
+  } else {
+    rc = pgo_prepare_set(cc, ts, n, verbose, force, jobs, strict, keep_going, no_core);
   }
+  free((void*)ts);
+  return rc;
+}
 
-  if (jobs > 1) {
-    int k;
-    for (k = 0; k < running_n; k++) {
-      int rc = proc_wait(&running[k]);
-      if (rc != 0) { free(running); return 1; }
-    }
+/* dry plan of every enabled target, core and the tests (nothing is checked or run) */
+static void plan_dry_all(BuildPlan *bp, TargetVec *tv, Profile p, int strict) {
+  StrVec tests;
+  int i;
+
+  plan_init(bp, 0, 1);
+  bp->dry = 1;
+
+  for (i = 0; i < tv->count; i++) {
+    if (tv->items[i].enabled) plan_add_target(bp, &tv->items[i], p, 0, strict, 0);
   }
 
-  free(running);
-  return 0;
+  sv_init(&tests);
+  scan_dir_recursive_suffix(&tests, g_tests_dir, "_test.c");
+  if (tests.count) {
+    char tests_root[512];
+    tests_root_path(tests_root, sizeof(tests_root), p);
+    plan_add_tests(bp, &tests, tests_root, p, 0, strict);
+  }
+  sv_free(&tests);
 }
 
-static int link_executable(const char *cc, const char *out_exe,
-                           StrVec *objs,
-                           const char * const *inc_common,
-                           const char * const *inc_extra,
-                           const char * const *def_extra,
-                           const char * const *ldflags_extra,
-                           const char * const *libs_extra,
-                           Profile p, int verbose, int strict) {
-  Argv av;
-  int i;
-  StrVec tmp_defs;
+static void config_snap_key(Hash64 *h, long *newest);
 
-  av_init(&av);
-  sv_init(&tmp_defs);
+/* everything the compdb's command lines derive from: the config snapshot key, CC,
+ * profile, --strict, the pgo profile dir, cwd and the source set every dry plan scans
+ * (names only: edits inside a source never change a command line). *newest: latest
+ * config input mtime, as for the snapshot */
+static void compdb_key(Hash64 *h, long *newest, const TargetVec *tv, Profile p, int strict) {
+  StrVec srcs;
+  Hash64 ck;
+  long sw[2];
+  char cwd[1024];
+  int i, k;
+
+  config_snap_key(&ck, newest);
+  h64_init(h);
+  h64_update(h, &ck, sizeof(ck));
+  h64_update(h, get_cc(), strlen(get_cc()) + 1);
+  sw[0] = (long)p;
+  sw[1] = (long)strict;
+  h64_update(h, sw, sizeof(sw));
+  h64_update(h, g_pgo.cur, strlen(g_pgo.cur) + 1);
+#ifdef _WIN32
+  if (!_getcwd(cwd, (int)sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#else
+  if (!getcwd(cwd, sizeof(cwd))) tack_copy(cwd, sizeof(cwd), ".");
+#endif
+  h64_update(h, cwd, strlen(cwd) + 1);
 
-  av_push(&av, cc);
+  sv_init(&srcs);
+  for (i = 0; i < tv->count; i++) {
+    if (!tv->items[i].enabled) continue;
+    h64_update(h, tv->items[i].name, strlen(tv->items[i].name) + 1);
+    scan_dir_recursive_suffix(&srcs, tv->items[i].src_dir, ".c");
+  }
+  scan_dir_recursive_suffix(&srcs, g_core_dir, ".c");
+  scan_dir_recursive_suffix(&srcs, g_tests_dir, "_test.c");
+  if (file_exists("src/main.c")) sv_push(&srcs, "src/main.c");
+  for (k = 0; k < srcs.count; k++) h64_update(h, srcs.items[k], strlen(srcs.items[k]) + 1);
+  sv_free(&srcs);
+}
 
-  push_common_warnings(&av, strict);
-  push_profile_flags(&av, p);
+/* write build/compile_commands.json for every enabled target, core and the tests;
+ * skipped while build/.tack_compdb holds the compdb_key it was last written for */
+static int compdb_write(TargetVec *tv, Profile p, int strict) {
+  BuildPlan bp;
+  StrBuf out;
+  Hash64 key;
+  char path[1024], key_path[1024], hex[17], old[17];
+  FILE *f;
+  long newest;
+  int i, rc;
 
-  /* includes (mostly irrelevant for link, but harmless with tcc) */
-  {
-    int k;
-    for (k = 0; inc_common && inc_common[k]; k++) {
-      av_push(&av, "-I");
-      av_push(&av, inc_common[k]);
-    }
-    for (k = 0; inc_extra && inc_extra[k]; k++) {
-      av_push(&av, "-I");
-      av_push(&av, inc_extra[k]);
-    }
+  ensure_dir(g_build_dir);
+  path_join(path, sizeof(path), g_build_dir, "compile_commands.json");
+  path_join(key_path, sizeof(key_path), g_build_dir, ".tack_compdb");
+  compdb_key(&key, &newest, tv, p, strict);
+  h64_hex(hex, &key);
+  old[0] = '\0';
+  f = fopen(key_path, "rb");
+  if (f) {
+    size_t n = fread(old, 1, 16, f);
+    old[n] = '\0';
+    fclose(f);
   }
+  if (streq(old, hex) && file_exists(path)) return 0;
 
-  /* extra defines */
-  {
-    int k;
-    for (k = 0; def_extra && def_extra[k]; k++) {
-      char *d;
-      size_t n;
-      n = strlen(def_extra[k]) + 3;
-      d = (char*)xmalloc(n);
-      tack_copy(d, n, "-D");
-      tack_cat(d, n, def_extra[k]);
-      sv_push_own(&tmp_defs, d);
-      av_push(&av, d);
-    }
+  plan_dry_all(&bp, tv, p, strict);
+
+  sb_init(&out);
+  sb_puts(&out, "[\n");
+  for (i = 0; i < bp.compdb.count; i++) {
+    if (i) sb_puts(&out, ",\n");
+    sb_puts(&out, bp.compdb.items[i]);
   }
+  sb_puts(&out, "\n]\n");
 
+  rc = write_file_if_changed(path, out.p, out.len);
+  if (rc != 0) fprintf(stderr, "tack: cannot write %s\n", path);
+  else if (newest >= (long)time(0) - 1) remove(key_path); /* racy config: check again next time */
+  else if (write_file_if_changed(key_path, hex, 16) != 0) fprintf(stderr, "tack: warning: cannot write %s\n", key_path);
 
-  av_push_list(&av, ldflags_extra);
+  sb_free(&out);
+  plan_free(&bp);
+  return rc;
+}
 
-  av_push(&av, "-o");
-  av_push(&av, out_exe);
+/* --------------------------- why / affected --------------------------- */
+/* Both answer from the build db against a dry plan of the current configuration, so
+ * they see the same command lines a build would, without running or touching anything.
+ *   tack why <output|source>...  the reasons an output would be rebuilt
+ *   tack affected <file>...      objects, targets and tests a change to file rebuilds,
+ *                                via the reverse dependency index (db_dependents)
+ */
 
-  for (i = 0; i < objs->count; i++) av_push(&av, objs->items[i]);
+/* why j would run (printed unless quiet); returns the number of reasons, 0 = up to date */
+static int why_job(const BuildPlan *bp, const PlanJob *j, int quiet) {
+  DbRec *r;
+  long out_t;
+  int i, k, s, n = 0;
+  int self = (int)(j - bp->items);
+
+  out_t = file_mtime(j->out);
+  if (out_t < 0) { if (!quiet) printf("  output missing\n"); return 1; }
+  r = db_find_rec(j->out);
+  if (!r) { if (!quiet) printf("  no record in the build db\n"); return 1; }
+  if (!db_rec_current(j->out, out_t)) { if (!quiet) printf("  output changed since it was recorded\n"); return 1; }
+  if (r->cmd.a != j->cmd.a || r->cmd.b != j->cmd.b) { if (!quiet) printf("  command line changed\n"); n++; }
+
+  if (j->kind == JOB_COMPILE) {
+    for (i = 0; i < r->ndeps; i++) {
+      const DbDep *d = &r->deps[i];
+      const char *dp = g_db.paths.items[d->path];
+      long dt = file_mtime(dp);
+      if (dt < 0) { if (!quiet) printf("  missing: %s\n", dp); n++; continue; }
+      if (g_hash_deps && d->hashed) {
+        Hash64 h;
+        if (dt == d->mtime) continue;
+        if (db_file_hash(d->path, &h) != 0 || h.a != d->hash.a || h.b != d->hash.b) {
+          if (!quiet) printf("  changed: %s\n", dp);
+          n++;
+        }
+        continue;
+      }
+      if (mtime_newer(dt, out_t)) { if (!quiet) printf("  newer: %s (+%lds)\n", dp, dt - out_t); n++; }
+    }
+  } else {
+    /* the predicate plan_link_needed applies when the job becomes ready */
+    n += plan_link_inputs_changed(j, out_t, quiet);
+    /* an input that is rebuilt first comes out newer; the link runs unless the
+     * rebuild reproduces it byte for byte (db_input_unchanged) */
+    for (i = 0; i < j->inputs.count && (!n || !quiet); i++) {
+      const char *in = j->inputs.items[i];
+      long it = file_mtime(in);
+      if (it < 0 || (mtime_newer(it, out_t) && !db_input_unchanged(j->out, out_t, in, it))) continue;
+      for (k = 0; k < bp->count; k++) {
+        if (&bp->items[k] != j && streq(bp->items[k].out, in) && why_job(bp, &bp->items[k], 1)) {
+          if (!quiet) printf("  input rebuilt first: %s (reruns unless it comes out identical)\n", in);
+          n++;
+          break;
+        }
+      }
+    }
+  }
 
-  av_push_list(&av, libs_extra);
+  /* any other job with a plan edge into j (the pch before its objects) reruns j */
+  for (k = 0; k < bp->count && (!n || !quiet); k++) {
+    const PlanJob *pj = &bp->items[k];
+    int pred = 0;
+    if (k == self) continue;
+    for (s = 0; s < pj->succ.count; s++) if (pj->succ.items[s] == self) pred = 1;
+    /* link inputs were judged above */
+    for (s = 0; pred && s < j->inputs.count; s++) if (streq(j->inputs.items[s], pj->out)) pred = 0;
+    if (pred && why_job(bp, pj, 1)) {
+      if (!quiet) printf("  rebuilt first: %s\n", pj->out);
+      n++;
+    }
+  }
 
-  av_terminate(&av);
+  if (!n && !quiet) printf("  up to date\n");
+  return n;
+}
 
-  i = run_argv_wait(av.a, verbose);
-  sv_free(&tmp_defs);
-  av_free(&av);
+static int cmd_why(TargetVec *tv, Profile p, int strict, char **args, int nargs) {
+  BuildPlan bp;
+  int i, k, rc = 0;
+
+  plan_dry_all(&bp, tv, p, strict);
+  db_load();
+
+  for (i = 0; i < nargs; i++) {
+    char want[1024];
+    int found = 0;
+    path_normalize(want, sizeof(want), args[i]);
+    for (k = 0; k < bp.count; k++) {
+      const PlanJob *j = &bp.items[k];
+      char o[1024], l[1024];
+      path_normalize(o, sizeof(o), j->out);
+      path_normalize(l, sizeof(l), j->label);
+      if (!streq(o, want) && !(j->kind == JOB_COMPILE && streq(l, want))) continue;
+      if (j->kind == JOB_COMPILE) printf("%s (%s):\n", j->out, j->label);
+      else printf("%s:\n", j->out);
+      why_job(&bp, j, 0);
+      found = 1;
+    }
+    if (!found) {
+      fprintf(stderr, "tack: why: %s is neither an output nor a source of any target\n", args[i]);
+      rc = 2;
+    }
+  }
 
-  return i;
+  plan_free(&bp);
+  return rc;
 }
 
-/* --------------------------- core + target build --------------------------- */
+/* jobs of the test suite carry the plan group plan_add_tests sets */
+static int is_test_job(const PlanJob *j) {
+  return j->target != 0 && streq(j->target, "tests");
+}
 
-static int build_core(Profile p, int verbose, int force, int jobs, int strict, StrVec *out_core_objs) {
-  const char *cc;
-  StrVec core_srcs;
-  char root[512], objd[512], depd[512], bind[512];
-  const char *inc_common[4];
+static int cmd_affected(TargetVec *tv, Profile p, int strict, char **args, int nargs) {
+  BuildPlan bp;
+  StrVec want;
+  IntVec job_of;      /* db path id -> dry job producing it, -1 = none */
+  char *hit;          /* per job */
+  char *test;         /* per job: planned by plan_add_tests */
+  int i, k, n;
+
+  plan_dry_all(&bp, tv, p, strict);
+  db_load();
+
+  test = (char*)xmalloc((size_t)bp.count + 1);
+  for (k = 0; k < bp.count; k++) test[k] = is_test_job(&bp.items[k]);
+
+  sv_init(&want);
+  for (i = 0; i < nargs; i++) {
+    char w[1024];
+    path_normalize(w, sizeof(w), args[i]);
+    sv_push(&want, w);
+  }
 
-  cc = get_cc();
+  iv_init(&job_of);
+  for (i = 0; i < g_db.paths.count; i++) iv_push(&job_of, -1);
+  for (k = 0; k < bp.count; k++) {
+    int id = db_find_path(bp.items[k].out);
+    if (id >= 0) job_of.items[id] = k;
+  }
 
-  sv_init(&core_srcs);
+  hit = (char*)xmalloc((size_t)bp.count + 1);
+  memset(hit, 0, (size_t)bp.count + 1);
 
-  if (!file_exists(g_core_dir) || !is_dir_path(g_core_dir)) {
-    /* no core */
-    return 0;
+  /* compiles: the file is the source, or a dep recorded by the last build */
+  for (k = 0; k < bp.count; k++) {
+    char l[1024];
+    if (bp.items[k].kind != JOB_COMPILE) continue;
+    path_normalize(l, sizeof(l), bp.items[k].label);
+    for (i = 0; i < want.count; i++) if (streq(l, want.items[i])) hit[k] = 1;
+  }
+  for (i = 0; i < g_db.paths.count; i++) {
+    char dp[1024];
+    const IntVec *rv;
+    int w, match = 0;
+    path_normalize(dp, sizeof(dp), g_db.paths.items[i]);
+    for (w = 0; w < want.count; w++) if (streq(dp, want.items[w])) match = 1;
+    if (!match || !(rv = db_dependents(i))) continue;
+    for (w = 0; w < rv->count; w++) {
+      int j = job_of.items[g_db.recs[rv->items[w]].out];
+      if (j >= 0) hit[j] = 1;
+    }
   }
 
-  scan_dir_recursive_suffix(&core_srcs, g_core_dir, ".c");
-  if (core_srcs.count == 0) {
-    sv_free(&core_srcs);
-    return 0;
+  /* plans add producers before their consumers: the pch before its objects (plan
+   * edges), objects before the archives and links that read them (inputs) */
+  for (k = 0; k < bp.count; k++) {
+    const PlanJob *j = &bp.items[k];
+    for (i = 0; i < j->inputs.count && !hit[k]; i++) {
+      int id = db_find_path(j->inputs.items[i]);
+      if (id >= 0 && job_of.items[id] >= 0 && hit[job_of.items[id]]) hit[k] = 1;
+    }
+    if (hit[k]) for (i = 0; i < j->succ.count; i++) hit[j->succ.items[i]] = 1;
   }
 
-  /* build dirs: build/_core/<profile>/{obj,dep,bin} (bin unused) */
-  ensure_dir(g_build_dir);
-  {
-    char cdir[512];
-    path_join(cdir, sizeof(cdir), g_build_dir, "_core");
-    ensure_dir(cdir);
+  printf("objects:\n");
+  for (k = 0, n = 0; k < bp.count; k++) {
+    if (hit[k] && !test[k] && bp.items[k].kind == JOB_COMPILE) { printf("  %s\n", bp.items[k].out); n++; }
   }
-  {
-    char cdir[512], pdir[512];
-    path_join(cdir, sizeof(cdir), g_build_dir, "_core");
-    path_join(pdir, sizeof(pdir), cdir, profile_name(p));
-    ensure_dir(pdir);
+  if (!n) printf("  (none)\n");
+
+  printf("targets:\n");
+  for (i = 0, n = 0; i < tv->count; i++) {
+    const Target *t = &tv->items[i];
+    char exe[1024];
+    if (!t->enabled) continue;
+    exe_path(exe, sizeof(exe), t->id, p, t->bin_base);
+    for (k = 0; k < bp.count; k++) {
+      if (hit[k] && !test[k] && bp.items[k].kind == JOB_LINK && streq(bp.items[k].out, exe)) { printf("  %s\n", t->name); n++; break; }
+    }
   }
-  build_paths(root, sizeof(root), objd, sizeof(objd), depd, sizeof(depd), bind, sizeof(bind), "_core", p);
-  ensure_dir(objd);
-  ensure_dir(depd);
-  ensure_dir(bind);
-
-  /* common includes: include + src + src/core */
-  inc_common[0] = g_inc_dir;
-  inc_common[1] = g_src_dir;
-  inc_common[2] = g_core_dir;
-  inc_common[3] = 0;
+  if (!n) printf("  (none)\n");
 
-  if (compile_sources(cc, &core_srcs, objd, depd,
-                      inc_common, 0, 0, 0,
-                      p, verbose, force, jobs, strict,
-                      out_core_objs) != 0) {
-    sv_free(&core_srcs);
-    return 1;
+  printf("tests:\n");
+  for (k = 0, n = 0; k < bp.count; k++) {
+    if (hit[k] && test[k] && bp.items[k].kind == JOB_COMPILE) { printf("  %s\n", bp.items[k].label); n++; }
   }
+  if (!n) printf("  (none)\n");
 
-  sv_free(&core_srcs);
+  free(test);
+  free(hit);
+  iv_free(&job_of);
+  sv_free(&want);
+  plan_free(&bp);
   return 0;
 }
 
-static int build_one_target(const Target *t, Profile p, int verbose, int force, int jobs, int strict, int no_core) {
-  const char *cc;
-  const TargetOverride *ov;
-  int use_core;
+/* --------------------------- config snapshot --------------------------- */
+/* build/.tack_config: the fully merged configuration (project keys, INI/tackfile.c
+ * overrides) and the resulting target graph, so a warm start skips the tackfile.c
+ * check, INI parsing and tool discovery. Valid while its key matches:
+ *   key = H(tack version, config CLI switches, stat tuple of tack.ini, tackfile.c,
+ *           --config, the generated INI, src/app and tools/ (discovery lists it))
+ * Inputs modified in the last second make the snapshot racy: it is not written then.
+ * Layout (little endian u32 words, strings as len + bytes, len ~0 = none):
+ *   "TACKCF\r\n" version key(2) flags config_path default_target core_pch test_env
+ *   test_data pgo_train linker noverrides { name pch linker use_core unity unity_chunk lists(5) }*
+ *   ntargets { name id src_dir bin_base enabled }*
+ * where a list is count + 1 strings (0 = no list).
+ */
 
-  StrVec srcs;
-  StrVec objs;
-  StrVec core_objs;
+#define TACK_CONFIG_SNAP_MAGIC   "TACKCF\r\n"
+#define TACK_CONFIG_SNAP_VERSION 3UL
 
-  char root[512], objd[512], depd[512], bind[512];
-  char out_exe[512];
+static void config_snap_path(char *out, size_t cap) {
+  path_join(out, cap, g_build_dir, ".tack_config");
+}
 
-  const char *inc_common[5];
+/* *newest: newest mtime among the stamped inputs */
+static void config_snap_key(Hash64 *h, long *newest) {
+  const char *files[6];
+  unsigned long sw[4];
+  int i;
+#ifndef TACK_USE_TACKFILE
+  char dir[1024], gen_c[1024], gen_exe[1024], gen_ini[1024];
+  tackfile_gen_paths(dir, sizeof(dir), gen_c, sizeof(gen_c), gen_exe, sizeof(gen_exe), gen_ini, sizeof(gen_ini));
+  files[3] = gen_ini;
+#else
+  files[3] = 0;
+#endif
+  files[0] = "tack.ini";
+  files[1] = "tackfile.c";
+  files[2] = g_config_path_cli;
+  files[4] = g_app_dir;
+  files[5] = g_tools_dir;
+
+  h64_init(h);
+  h64_update(h, TACK_VERSION, sizeof(TACK_VERSION));
+  sw[0] = (unsigned long)g_no_config;
+  sw[1] = (unsigned long)g_no_code_config;
+  sw[2] = (unsigned long)g_no_auto_tools_cli;
+  sw[3] = g_config_path_cli ? 1UL : 0UL;
+  h64_update(h, sw, sizeof(sw));
+  if (g_config_path_cli) h64_update(h, g_config_path_cli, strlen(g_config_path_cli));
+
+  *newest = 0;
+  for (i = 0; i < 6; i++) {
+    STAT_ST st;
+    long v[3];
+    v[0] = v[1] = v[2] = -1;
+    if (files[i] && STAT_FN(files[i], &st) == 0) {
+      v[0] = (long)st.st_mtime;
+      v[1] = (long)st.st_size;
+      v[2] = (st.st_mode & S_IFMT) == S_IFDIR;
+      if (v[0] > *newest) *newest = v[0];
+    }
+    h64_update(h, v, sizeof(v));
+  }
+}
 
-  cc = get_cc();
+static void snap_put_str(FILE *f, const char *s) {
+  size_t len;
+  if (!s) { db_put_u32(f, 0xffffffffUL); return; }
+  len = strlen(s);
+  db_put_u32(f, (unsigned long)len);
+  fwrite(s, 1, len, f);
+}
 
-  ov = find_override(t->name);
+/* *out: copy in a (or malloc'd if a is 0), 0 for none */
+static int snap_get_str_in(FILE *f, char **out, Arena *a) {
+  unsigned long len;
+  char *s;
+  *out = 0;
+  if (db_get_u32(f, &len)) return 1;
+  if (len == 0xffffffffUL) return 0;
+  if (len > TACK_MAX_TOKEN) return 1;
+  s = a ? (char*)arena_alloc(a, (size_t)len + 1) : (char*)xmalloc((size_t)len + 1);
+  if (fread(s, 1, (size_t)len, f) != (size_t)len) { if (!a) free(s); return 1; }
+  s[len] = '\0';
+  *out = s;
+  return 0;
+}
 
-  use_core = 0;
-  if (ov) use_core = ov->use_core;
-  if (no_core) use_core = 0;
+static int snap_get_str(FILE *f, char **out) { return snap_get_str_in(f, out, 0); }
 
-  /* prepare dirs */
-  ensure_dir(g_build_dir);
-  {
-    char tdir[512];
-    path_join(tdir, sizeof(tdir), g_build_dir, t->id);
-    ensure_dir(tdir);
+static void snap_put_list(FILE *f, const char * const *lst) {
+  unsigned long n = 0;
+  if (!lst) { db_put_u32(f, 0); return; }
+  while (lst[n]) n++;
+  db_put_u32(f, n + 1);
+  for (n = 0; lst[n]; n++) snap_put_str(f, lst[n]);
+}
+
+static int snap_get_list(FILE *f, const char * const **out) {
+  unsigned long n, i;
+  char **lst;
+  *out = 0;
+  if (db_get_u32(f, &n)) return 1;
+  if (!n) return 0;
+  if (n > TACK_MAX_LIST_ITEMS + 1) return 1;
+  lst = (char**)arena_alloc(&g_cfg_arena, (size_t)n * sizeof(char*));
+  for (i = 0; i < n; i++) lst[i] = 0;
+  *out = (const char * const *)lst;
+  for (i = 0; i + 1 < n; i++) {
+    if (snap_get_str_in(f, &lst[i], &g_cfg_arena) || !lst[i]) return 1;
   }
-  {
-    char tdir[512], pdir[512];
-    path_join(tdir, sizeof(tdir), g_build_dir, t->id);
-    path_join(pdir, sizeof(pdir), tdir, profile_name(p));
-    ensure_dir(pdir);
+  return 0;
+}
+
+static int config_snap_read(FILE *f, const Hash64 *key, TargetVec *tv) {
+  char magic[8];
+  unsigned long ver, flags, n, i;
+  Hash64 k;
+  char *path;
+
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TACK_CONFIG_SNAP_MAGIC, 8) != 0) return 1;
+  if (db_get_u32(f, &ver) || ver != TACK_CONFIG_SNAP_VERSION) return 1;
+  if (db_get_u32(f, &k.a) || db_get_u32(f, &k.b)) return 1;
+  if (k.a != key->a || k.b != key->b) return 1;
+
+  if (db_get_u32(f, &flags)) return 1;
+  g_config_loaded = (flags & 1UL) != 0;
+  g_config_disable_auto_tools = (flags & 2UL) != 0;
+  g_config_core_archive = (flags & 4UL) != 0;
+  g_config_direct = (flags & 8UL) != 0;
+  g_config_compdb = (flags & 16UL) != 0;
+  g_config_split_dwarf = (flags & 32UL) != 0;
+  if (snap_get_str(f, &path)) return 1;
+  if (path) {
+    if (strlen(path) > TACK_MAX_CONFIG_PATH) { free(path); return 1; }
+    tack_copy(g_config_path, sizeof(g_config_path), path);
+    free(path);
+  }
+  if (snap_get_str(f, &g_config_default_target) || snap_get_str(f, &g_config_core_pch) ||
+      snap_get_str(f, &g_config_test_env) || snap_get_str(f, &g_config_test_data) ||
+      snap_get_str(f, &g_config_pgo_train) || snap_get_str(f, &g_config_linker)) return 1;
+
+  if (db_get_u32(f, &n)) return 1;
+  for (i = 0; i < n; i++) {
+    TargetOverride *ov;
+    char *name, *pch;
+    unsigned long v[3];
+    if (snap_get_str(f, &name) || !name) return 1;
+    ov = ini_get_or_add_override(name);
+    free(name);
+    if (snap_get_str(f, &pch)) return 1;
+    ov->pch = pch;
+    if (snap_get_str(f, &pch)) return 1;
+    ov->linker = pch;
+    if (db_get_u32(f, &v[0]) || db_get_u32(f, &v[1]) || db_get_u32(f, &v[2])) return 1;
+    ov->use_core = (int)v[0];
+    ov->unity = (int)v[1];
+    ov->unity_chunk = (int)v[2];
+    if (snap_get_list(f, &ov->includes) || snap_get_list(f, &ov->defines) || snap_get_list(f, &ov->cflags) ||
+        snap_get_list(f, &ov->ldflags) || snap_get_list(f, &ov->libs)) return 1;
   }
-  build_paths(root, sizeof(root), objd, sizeof(objd), depd, sizeof(depd), bind, sizeof(bind), t->id, p);
-  ensure_dir(objd);
-  ensure_dir(depd);
-  ensure_dir(bind);
 
-  exe_path(out_exe, sizeof(out_exe), t->id, p, t->bin_base);
+  if (db_get_u32(f, &n)) return 1;
+  for (i = 0; i < n; i++) {
+    char *s[4];
+    unsigned long en;
+    int k2, bad = 0;
+    for (k2 = 0; k2 < 4; k2++) if (snap_get_str(f, &s[k2]) || !s[k2]) bad = 1;
+    if (!bad && db_get_u32(f, &en)) bad = 1;
+    if (!bad) {
+      tv_push(tv, s[0], s[2], s[3]);
+      free(tv->items[tv->count - 1].id);
+      tv->items[tv->count - 1].id = s[1];
+      s[1] = 0;
+      tv->items[tv->count - 1].enabled = en != 0;
+    }
+    for (k2 = 0; k2 < 4; k2++) free(s[k2]);
+    if (bad) return 1;
+  }
+  return 0;
+}
 
-  /* scan sources:
-   * - if app is using src/ (not src/app), skip "core" dir so we don't compile shared code twice
-   */
-  sv_init(&srcs);
-  if (streq(t->name, "app") && streq(t->src_dir, g_src_dir) && file_exists(g_core_dir) && is_dir_path(g_core_dir)) {
-    scan_dir_recursive_suffix_skip(&srcs, t->src_dir, ".c", "core");
-  } else {
-    scan_dir_recursive_suffix(&srcs, t->src_dir, ".c");
+/* 0 = config and tv restored from the snapshot */
+static int config_snap_load(const Hash64 *key, TargetVec *tv) {
+  char path[1024];
+  FILE *f;
+  int rc;
+
+  config_snap_path(path, sizeof(path));
+  f = fopen(path, "rb");
+  if (!f) return 1;
+  config_reset();
+  tv_init(tv);
+  rc = config_snap_read(f, key, tv);
+  fclose(f);
+  if (rc != 0) {
+    config_reset();
+    tv_free(tv);
   }
+  return rc;
+}
 
-  /* allow legacy src/main.c when using src/app */
-  if (streq(t->name, "app") && streq(t->src_dir, g_app_dir)) {
-    if (file_exists("src/main.c")) sv_push(&srcs, "src/main.c");
+/* never creates build/ on its own */
+static void config_snap_save(const TargetVec *tv) {
+  char path[1024], tmp[1024];
+  Hash64 key;
+  long newest;
+  unsigned long flags;
+  FILE *f;
+  int i;
+
+  if (!is_dir_path(g_build_dir)) return;
+  config_snap_key(&key, &newest);
+  if (newest >= (long)time(0) - 1) return; /* racy: an edit in this second would go unseen */
+
+  config_snap_path(path, sizeof(path));
+  tack_copy(tmp, sizeof(tmp), path);
+  tack_cat(tmp, sizeof(tmp), ".tmp");
+  f = fopen(tmp, "wb");
+  if (!f) return;
+
+  fwrite(TACK_CONFIG_SNAP_MAGIC, 1, 8, f);
+  db_put_u32(f, TACK_CONFIG_SNAP_VERSION);
+  db_put_u32(f, key.a);
+  db_put_u32(f, key.b);
+
+  flags = 0;
+  if (g_config_loaded) flags |= 1UL;
+  if (g_config_disable_auto_tools) flags |= 2UL;
+  if (g_config_core_archive) flags |= 4UL;
+  if (g_config_direct) flags |= 8UL;
+  if (g_config_compdb) flags |= 16UL;
+  if (g_config_split_dwarf) flags |= 32UL;
+  db_put_u32(f, flags);
+  snap_put_str(f, g_config_path[0] ? g_config_path : 0);
+  snap_put_str(f, g_config_default_target);
+  snap_put_str(f, g_config_core_pch);
+  snap_put_str(f, g_config_test_env);
+  snap_put_str(f, g_config_test_data);
+  snap_put_str(f, g_config_pgo_train);
+  snap_put_str(f, g_config_linker);
+
+  db_put_u32(f, (unsigned long)g_ini_overrides.count);
+  for (i = 0; i < g_ini_overrides.count; i++) {
+    const TargetOverride *ov = &g_ini_overrides.items[i];
+    snap_put_str(f, ov->name);
+    snap_put_str(f, ov->pch);
+    snap_put_str(f, ov->linker);
+    db_put_u32(f, (unsigned long)ov->use_core);
+    db_put_u32(f, (unsigned long)ov->unity);
+    db_put_u32(f, (unsigned long)ov->unity_chunk);
+    snap_put_list(f, ov->includes);
+    snap_put_list(f, ov->defines);
+    snap_put_list(f, ov->cflags);
+    snap_put_list(f, ov->ldflags);
+    snap_put_list(f, ov->libs);
   }
 
-  if (srcs.count == 0) {
-    fprintf(stderr, "tack: build: no sources in %s for target %s\n", t->src_dir, t->name);
-    sv_free(&srcs);
-    return 1;
+  db_put_u32(f, (unsigned long)tv->count);
+  for (i = 0; i < tv->count; i++) {
+    snap_put_str(f, tv->items[i].name);
+    snap_put_str(f, tv->items[i].id);
+    snap_put_str(f, tv->items[i].src_dir);
+    snap_put_str(f, tv->items[i].bin_base);
+    db_put_u32(f, tv->items[i].enabled ? 1UL : 0UL);
   }
 
-  sv_init(&objs);
-  sv_init(&core_objs);
+  if (fclose(f) != 0) { remove(tmp); return; }
+#ifdef _WIN32
+  remove(path);
+#endif
+  if (rename(tmp, path) != 0) remove(tmp);
+}
 
-  /* common includes: include + target src dir + src (for shared headers) */
-  inc_common[0] = g_inc_dir;
-  inc_common[1] = t->src_dir;
-  inc_common[2] = g_src_dir;
-  if (file_exists(g_core_dir) && is_dir_path(g_core_dir)) inc_common[3] = g_core_dir;
-  else inc_common[3] = 0;
-  inc_common[4] = 0;
+/* config + target graph (tack.ini, tackfile.c, discovery); main and watch reloads */
+static int load_project(TargetVec *tv) {
+  int disable_auto_tools;
+  Hash64 key;
+  long newest;
 
-  /* build core (once per target build invocation) */
-  if (use_core) {
-    if (build_core(p, verbose, force, jobs, strict, &core_objs) != 0) {
-      sv_free(&srcs); sv_free(&objs); sv_free(&core_objs);
-      return 1;
-    }
-  }
+  config_snap_key(&key, &newest);
+  if (config_snap_load(&key, tv) == 0) return 0;
 
-  /* compile target sources */
-  if (compile_sources(cc, &srcs, objd, depd,
-                      inc_common,
-                      ov ? ov->includes : 0,
-                      ov ? ov->defines : 0,
-                      ov ? ov->cflags : 0,
-                      p, verbose, force, jobs, strict,
-                      &objs) != 0) {
-    sv_free(&srcs); sv_free(&objs); sv_free(&core_objs);
+  if (config_auto_load() != 0) {
+    fprintf(stderr, "tack: config: failed to load\n");
     return 1;
   }
 
-  /* link: objs + (core objs if any) */
-  {
-    StrVec all;
-    int i;
-    int need_link;
+  disable_auto_tools = 0;
+#ifdef TACKFILE_DISABLE_AUTO_TOOLS
+  disable_auto_tools = 1;
+#else
+  if (g_no_auto_tools_cli) disable_auto_tools = 1;
+  else if (g_config_loaded && g_config_disable_auto_tools) disable_auto_tools = 1;
+#endif
 
-    sv_init(&all);
+  tv_init(tv);
+  discover_targets(tv, disable_auto_tools);
 
-    for (i = 0; i < objs.count; i++) sv_push(&all, objs.items[i]);
-    for (i = 0; i < core_objs.count; i++) sv_push(&all, core_objs.items[i]);
+  /* tackfile.c may add/modify/remove/disable targets (compile-time) */
+  apply_tackfile_targets(tv);
 
-    need_link = force || !file_exists(out_exe);
-    if (!need_link) {
-      long exe_t = file_mtime(out_exe);
-      for (i = 0; i < all.count; i++) {
-        long ot = file_mtime(all.items[i]);
-        if (ot < 0 || ot > exe_t) { need_link = 1; break; }
-      }
-    }
+  /* tack.ini may add/modify/remove/disable targets (runtime) */
+  apply_ini_targets(tv);
 
-    if (need_link) {
-      int rc = link_executable(cc, out_exe, &all,
-                               inc_common,
-                               ov ? ov->includes : 0,
-                               ov ? ov->defines : 0,
-                               ov ? ov->ldflags : 0,
-                               ov ? ov->libs : 0,
-                               p, verbose, strict);
-      sv_free(&all);
-      if (rc != 0) { sv_free(&srcs); sv_free(&objs); sv_free(&core_objs); return 1; }
-    } else if (verbose) {
-      printf("up to date: %s\n", out_exe);
-    }
+  config_snap_save(tv);
+  return 0;
+}
 
-    sv_free(&all);
-  }
+/* --------------------------- watch --------------------------- */
+/* tack watch [PROFILE] [--target NAME] [--run|--test] ...: one long-running
+ * process that keeps config, targets, build db and directory listings in memory and
+ * rebuilds when watched files change. Events are debounced (TACK_WATCH_DEBOUNCE_MS).
+ * Only the directories named by events are re-listed; the stat cache is dropped per
+ * batch (a depfile may spell a header differently than the event), which costs one
+ * stat per dependency instead of a whole tack start. Changes to tack.ini, tackfile.c
+ * or --config reload the configuration. --run stops the binary before each build (so
+ * its exe can be replaced) and starts it again on success; --test reruns the tests.
+ * Backends: inotify (Linux), FindFirstChangeNotification (Windows), otherwise a
+ * snapshot of the watched trees every tick.
+ */
 
-  sv_free(&srcs);
-  sv_free(&objs);
-  sv_free(&core_objs);
+#define TACK_WATCH_DEBOUNCE_MS 100
+#define TACK_WATCH_TICK_MS     250
 
-  return 0;
-}
+#define WATCH_BUILD 0
+#define WATCH_RUN   1
+#define WATCH_TEST  2
 
-/* --------------------------- tests --------------------------- */
+typedef struct {
+  Profile p;
+  int verbose, jobs, strict, keep_going, no_core, test_cache;
+  int mode;              /* WATCH_* */
+  const char *target;
+  char **run_args;       /* arguments for the binary (--run) */
+  int run_argc;
+} WatchOpts;
 
-static int build_and_run_tests(Profile p, int verbose, int force, int strict) {
-  StrVec tests;
+typedef struct {
+  StrVec roots;          /* watched trees */
+  int all;               /* batch: no path information, re-list every directory */
+  StrVec dirs;           /* batch: directories whose entries changed */
+#if defined(_WIN32)
+  HANDLE h[MAXIMUM_WAIT_OBJECTS];
+  int nh;
+#elif defined(__linux__)
+  int fd;
+  IntVec wds;            /* inotify watch descriptors ... */
+  StrVec wd_dirs;        /* ... and their directories */
+#else
+  Hash64 snap;           /* polling: fingerprint of every (path, mtime, size) */
+#endif
+} Watcher;
+
+static void watch_add_root(Watcher *w, const char *dir) {
   int i;
-  const char *cc;
+  size_t n;
+  if (!dir || !dir[0] || !is_dir_path(dir)) return;
+  for (i = 0; i < w->roots.count; i++) {
+    n = strlen(w->roots.items[i]);
+    if (streq(w->roots.items[i], dir)) return;
+    if (strncmp(w->roots.items[i], dir, n) == 0 && (dir[n] == '/' || dir[n] == '\\')) return;
+  }
+  sv_push(&w->roots, dir);
+}
 
-  char tests_root[512];
-  char tests_bin[512];
+/* mtime/size of the config inputs; a change means reload */
+static void watch_config_stamp(Hash64 *h) {
+  const char *files[3];
+  int i;
+  files[0] = "tack.ini";
+  files[1] = "tackfile.c";
+  files[2] = g_config_path_cli;
+  h64_init(h);
+  for (i = 0; i < 3; i++) {
+    STAT_ST st;
+    long v[2];
+    v[0] = v[1] = -1;
+    if (files[i] && STAT_FN(files[i], &st) == 0) { v[0] = (long)st.st_mtime; v[1] = (long)st.st_size; }
+    h64_update(h, v, sizeof(v));
+  }
+}
 
-  const char *inc_common[4];
+#if defined(_WIN32)
 
-  cc = get_cc();
+static void watch_open(Watcher *w) {
+  int i;
+  w->nh = 0;
+  for (i = 0; i < w->roots.count && w->nh < MAXIMUM_WAIT_OBJECTS; i++) {
+    HANDLE h = FindFirstChangeNotificationA(w->roots.items[i], TRUE,
+                                            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+    if (h != INVALID_HANDLE_VALUE) w->h[w->nh++] = h;
+  }
+}
 
-  sv_init(&tests);
-  scan_dir_recursive_suffix(&tests, g_tests_dir, "_test.c");
-  if (tests.count == 0) {
-    printf("tack: test: no tests found under %s\n", g_tests_dir);
-    sv_free(&tests);
-    return 0;
+static void watch_close(Watcher *w) {
+  int i;
+  for (i = 0; i < w->nh; i++) FindCloseChangeNotification(w->h[i]);
+  w->nh = 0;
+}
+
+/* 1 = something changed within timeout_ms (no paths: w->all) */
+static int watch_read(Watcher *w, int timeout_ms) {
+  DWORD r;
+  if (!w->nh) { Sleep((DWORD)timeout_ms); return 0; }
+  r = WaitForMultipleObjects((DWORD)w->nh, w->h, FALSE, (DWORD)timeout_ms);
+  if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + (DWORD)w->nh) {
+    FindNextChangeNotification(w->h[r - WAIT_OBJECT_0]);
+    w->all = 1;
+    return 1;
   }
+  return 0;
+}
 
-  ensure_dir(g_build_dir);
-  path_join(tests_root, sizeof(tests_root), g_build_dir, "tests");
-  ensure_dir(tests_root);
-  path_join(tests_root, sizeof(tests_root), tests_root, profile_name(p));
-  ensure_dir(tests_root);
-  path_join(tests_bin, sizeof(tests_bin), tests_root, "bin");
-  ensure_dir(tests_bin);
+#elif defined(__linux__)
+
+static void watch_add_tree(Watcher *w, const char *dir, int depth) {
+  const ScanDir *e;
+  StrVec subdirs;
+  int wd, i;
+
+  if (depth > TACK_MAX_SCAN_DEPTH) return;
+  wd = inotify_add_watch(w->fd, dir, IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+                                     IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB);
+  if (wd < 0) return;
+  for (i = 0; i < w->wds.count; i++) if (w->wds.items[i] == wd) return; /* already watched */
+  iv_push(&w->wds, wd);
+  sv_push(&w->wd_dirs, dir);
+
+  /* listed after the watch is in place, so nothing created in between is lost */
+  scan_unverify(dir);
+  e = scan_listing(dir);
+  if (!e) return;
+  sv_init(&subdirs);
+  for (i = 0; i < e->names.count; i++) {
+    if (e->kinds[i] == SCAN_DIR && !streq(e->names.items[i], "build")) {
+      sv_push_own(&subdirs, path_join_alloc(dir, e->names.items[i]));
+    }
+  }
+  for (i = 0; i < subdirs.count; i++) watch_add_tree(w, subdirs.items[i], depth + 1);
+  sv_free(&subdirs);
+}
 
-  inc_common[0] = g_inc_dir;
-  inc_common[1] = g_tests_dir;
-  inc_common[2] = g_src_dir;
-  inc_common[3] = 0;
+static void watch_open(Watcher *w) {
+  int i;
+  iv_init(&w->wds);
+  sv_init(&w->wd_dirs);
+  w->fd = inotify_init();
+  if (w->fd < 0) {
+    fprintf(stderr, "tack: watch: inotify unavailable (%s)\n", strerror(errno));
+    return;
+  }
+  for (i = 0; i < w->roots.count; i++) watch_add_tree(w, w->roots.items[i], 0);
+}
 
-  for (i = 0; i < tests.count; i++) {
-    const char *src = tests.items[i];
-    const char *base = path_base(src);
-    char out_exe[1024];
+static void watch_close(Watcher *w) {
+  if (w->fd >= 0) close(w->fd);
+  w->fd = -1;
+  iv_free(&w->wds);
+  sv_free(&w->wd_dirs);
+}
 
-#ifdef _WIN32
-    {
-      char tmp[512];
-      char *dot;
-      tack_copy(tmp, sizeof(tmp), base);
-      dot = strrchr(tmp, '.');
-      if (dot) *dot = '\0';
-      tack_cat(tmp, sizeof(tmp), ".exe");
-      path_join(out_exe, sizeof(out_exe), tests_bin, tmp);
+/* 1 = something changed within timeout_ms (directories in w->dirs) */
+static int watch_read(Watcher *w, int timeout_ms) {
+  union { struct inotify_event ev; char b[16384]; } buf;
+  struct pollfd pfd;
+  long n;
+  char *q;
+  int got = 0;
+
+  if (w->fd < 0) { poll(0, 0, timeout_ms); return 0; }
+  pfd.fd = w->fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+  n = (long)read(w->fd, buf.b, sizeof(buf.b));
+  if (n <= 0) return 0;
+
+  for (q = buf.b; q < buf.b + n; ) {
+    struct inotify_event *ev = (struct inotify_event*)q;
+    int i, k = -1;
+    q += sizeof(struct inotify_event) + ev->len;
+    if (ev->mask & IN_Q_OVERFLOW) { w->all = 1; got = 1; continue; }
+    for (i = 0; i < w->wds.count; i++) if (w->wds.items[i] == ev->wd) { k = i; break; }
+    if (k < 0) continue;
+    /* editor droppings: swap files, backups */
+    if (ev->len && (ev->name[0] == '.' || ends_with(ev->name, "~"))) continue;
+    sv_push(&w->dirs, w->wd_dirs.items[k]);
+    if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) && !streq(ev->name, "build")) {
+      char *sub = path_join_alloc(w->wd_dirs.items[k], ev->name);
+      watch_add_tree(w, sub, 0);
+      free(sub);
     }
+    got = 1;
+  }
+  return got;
+}
+
 #else
-    {
-      char tmp[512];
-      char *dot;
-      tack_copy(tmp, sizeof(tmp), base);
-      dot = strrchr(tmp, '.');
-      if (dot) *dot = '\0';
-      path_join(out_exe, sizeof(out_exe), tests_bin, tmp);
+
+static void watch_snapshot(Watcher *w, Hash64 *h) {
+  int i, k;
+  h64_init(h);
+  scan_unverify(0);
+  stat_cache_clear();
+  for (i = 0; i < w->roots.count; i++) {
+    StrVec files;
+    sv_init(&files);
+    scan_dir_recursive_suffix(&files, w->roots.items[i], "");
+    for (k = 0; k < files.count; k++) {
+      const StatEntry *e = stat_cache_get(files.items[k]);
+      h64_update(h, files.items[k], strlen(files.items[k]) + 1);
+      h64_update(h, &e->mtime, sizeof(e->mtime));
+      h64_update(h, &e->size, sizeof(e->size));
     }
-#endif
+    sv_free(&files);
+  }
+}
 
-    if (force || !file_exists(out_exe) || file_mtime(src) > file_mtime(out_exe)) {
-      Argv av;
-      int rc;
+static void watch_open(Watcher *w) { watch_snapshot(w, &w->snap); }
+static void watch_close(Watcher *w) { (void)w; }
+
+/* 1 = something changed within timeout_ms (no paths: w->all) */
+static int watch_read(Watcher *w, int timeout_ms) {
+  Hash64 h;
+  poll(0, 0, timeout_ms);
+  watch_snapshot(w, &h);
+  if (h.a == w->snap.a && h.b == w->snap.b) return 0;
+  w->snap = h;
+  w->all = 1;
+  return 1;
+}
 
-      av_init(&av);
+#endif
 
-      av_push(&av, cc);
+static void watch_start(Watcher *w, TargetVec *tv) {
+  int i;
+  sv_init(&w->roots);
+  sv_init(&w->dirs);
+  w->all = 0;
+  watch_add_root(w, g_src_dir);
+  watch_add_root(w, g_inc_dir);
+  watch_add_root(w, g_tools_dir);
+  watch_add_root(w, g_tests_dir);
+  for (i = 0; i < tv->count; i++) {
+    if (tv->items[i].enabled) watch_add_root(w, tv->items[i].src_dir);
+  }
+  watch_open(w);
+}
 
-      push_common_warnings(&av, strict);
-      push_profile_flags(&av, p);
+static void watch_stop(Watcher *w) {
+  watch_close(w);
+  sv_free(&w->roots);
+  sv_free(&w->dirs);
+}
 
-      /* includes */
-      {
-        int k;
-        for (k = 0; inc_common[k]; k++) {
-          av_push(&av, "-I");
-          av_push(&av, inc_common[k]);
-        }
-      }
+/* one build (+ run/test) cycle */
+static int watch_build(TargetVec *tv, const WatchOpts *o, Proc *app, int *app_running) {
+  const Target *t;
+  long t0 = now_ms();
+  int rc;
 
-      av_push(&av, "-o");
-      av_push(&av, out_exe);
-      av_push(&av, src);
+  if (*app_running) { proc_kill(app); *app_running = 0; }
 
+  if (o->mode == WATCH_TEST) {
+    rc = build_and_run_tests(o->p, o->verbose, 0, o->jobs, o->strict, o->keep_going, o->test_cache, 0);
+  } else {
+    t = find_target(tv, o->target);
+    if (!t) {
+      fprintf(stderr, "tack: unknown or disabled target: %s\n", o->target);
+      return 2;
+    }
+    rc = build_one_target(t, o->p, o->verbose, 0, o->jobs, o->strict, o->keep_going, o->no_core);
+    if (rc == 0 && o->mode == WATCH_RUN) {
+      char exe[512];
+      Argv av;
+      int k;
+      exe_path(exe, sizeof(exe), t->id, o->p, t->bin_base);
+      av_init(&av);
+      av_push(&av, exe);
+      for (k = 0; k < o->run_argc; k++) av_push(&av, o->run_args[k]);
       av_terminate(&av);
-
-      rc = run_argv_wait(av.a, verbose);
+      if (o->verbose) print_argv(av.a);
+      if (proc_spawn_nowait(av.a, 0, app) == 0) *app_running = 1;
+      else fprintf(stderr, "tack: spawn failed: %s\n", exe);
       av_free(&av);
+    }
+  }
+
+  if (g_trace_path) { trace_flush(); trace_reset(); }
+  printf("tack: watch: %s (%ld ms), waiting for changes\n", rc == 0 ? "ok" : "failed", now_ms() - t0);
+  fflush(stdout);
+  return rc;
+}
+
+/* runs until interrupted */
+static void watch_loop(TargetVec *tv, const WatchOpts *o) {
+  Watcher w;
+  Proc app;
+  int app_running = 0;
+  Hash64 cfg, now;
+  int i;
+
+  g_watch = 1;
+  watch_start(&w, tv);
+  watch_config_stamp(&cfg);
+  printf("tack: watch: %d tree(s)\n", w.roots.count);
 
-      if (rc != 0) { sv_free(&tests); return 1; }
+  watch_build(tv, o, &app, &app_running);
+
+  for (;;) {
+    if (!watch_read(&w, TACK_WATCH_TICK_MS)) {
+      int rc;
+      if (app_running && proc_poll(&app, &rc)) {
+        app_running = 0;
+        printf("tack: watch: %s exited (%d)\n", o->target, rc);
+        fflush(stdout);
+      }
+      watch_config_stamp(&now);
+      if (now.a == cfg.a && now.b == cfg.b) continue;
     }
 
-    /* run test */
-    {
-      char *runv[2];
-      runv[0] = out_exe;
-      runv[1] = 0;
-      if (run_argv_wait(runv, verbose) != 0) { sv_free(&tests); return 1; }
+    /* debounce: an editor save or a checkout is a burst of events */
+    while (watch_read(&w, TACK_WATCH_DEBOUNCE_MS)) { /* collect */ }
+
+    stat_cache_clear();
+    core_cache_reset();
+    if (w.all) scan_unverify(0);
+    for (i = 0; i < w.dirs.count; i++) scan_unverify(w.dirs.items[i]);
+    w.all = 0;
+    sv_free(&w.dirs);
+
+    watch_config_stamp(&now);
+    if (now.a != cfg.a || now.b != cfg.b) {
+      cfg = now;
+      printf("tack: watch: configuration changed, reloading\n");
+      watch_stop(&w);
+      tv_free(tv);
+      scan_unverify(0);
+      if (load_project(tv) != 0) tv_init(tv);
+      watch_start(&w, tv);
     }
-  }
 
-  sv_free(&tests);
-  return 0;
+    watch_build(tv, o, &app, &app_running);
+  }
 }
 
 /* --------------------------- commands --------------------------- */
@@ -2477,11 +8392,19 @@ static void print_help(void) {
          "  tack version\n"
          "  tack doctor\n"
          "  tack init\n"
-         "  tack list\n"
-         "  tack build [debug|release] [--target NAME] [-v] [--rebuild] [-j N] [--strict] [--no-core]\n"
-         "  tack run  [debug|release] [--target NAME] [-v] [--rebuild] [-j N] [--strict] [--no-core] [-- <args...>]\n"
-         "  tack test [debug|release] [-v] [--rebuild] [--strict]\n"
-         "  tack clean\n"
+         "  tack list\n");
+  printf("  tack build [PROFILE] [--target NAME]... [--all] [-v] [--rebuild] [--hash-deps] [--cache] [--direct] [--compdb] [--trace FILE] [-j N|auto] [-k] [--strict] [--no-core]\n"
+         "  tack run  [PROFILE] [--target NAME] [-v] [--rebuild] [--hash-deps] [--cache] [--direct] [-j N|auto] [-k] [--strict] [--no-core] [-- <args...>]\n"
+         "  tack test [PROFILE] [-v] [--rebuild] [--hash-deps] [--trace FILE] [-j N|auto] [-k] [--strict] [--no-test-cache]\n");
+  printf("            [--filter TEXT] [--shard I/N] [--shard-timings FILE]... [--junit FILE] [--json FILE]\n"
+         "  tack cache [stats|clear]\n");
+  printf("  tack watch [PROFILE] [--target NAME] [--run|--test] [-v] [-j N|auto] [-k] [--strict] [-- <args...>]\n");
+  printf("  tack why [PROFILE] [--strict] [--hash-deps] <output|source>...\n"
+         "  tack affected [PROFILE] [--strict] [--hash-deps] <file>...\n"
+         "  tack worker ID CC [args...]   (remote end of TACK_DIST_HOSTS, started over ssh)\n");
+  printf("  tack bench [PROFILE] [--files N] [--headers N] [--fanin N] [--core N] [--tools N] [--tests N]\n"
+         "             [--reps N] [-j N|auto] [--out FILE]\n");
+  printf("  tack clean\n"
          "  tack clobber\n");
   printf("\nGlobal options (must come before the command):\n"
          "  --no-config         ignore tack.ini and tackfile.c\n"
@@ -2493,10 +8416,37 @@ static void print_help(void) {
          "  shared core : src/core/ (linked if enabled for target)\n"
          "  tools       : tools/<name>/  (target name: tool:<name>)\n"
          "  tests       : tests/ (recursive _test.c files)\n");
+  printf("\nProfiles:\n"
+         "  debug (default), release (-O2), release-lto (-O2 -flto),\n"
+         "  release-pgo = build release-pgo-gen (instrumented), train it ([project] pgo_train,\n"
+         "            required, with TACK_PGO_EXE per enabled target), merge into build/pgo, build with\n"
+         "            -fprofile-use (gcc, clang; tcc builds them as release)\n");
   printf("\nNotes:\n"
          "  clean   = remove contents under build/ (keep the build directory)\n"
          "  clobber = remove build/ itself\n"
-         "  --strict enables -Wunsupported\n");
+         "  --strict enables -Wunsupported\n"
+         "  -j N    = parallel jobs; on failure tack stops spawning and reaps running jobs\n"
+         "  -k      = keep going: compile remaining sources after a failure, fail at the end\n"
+         "  --all   = build every enabled target (or repeat --target) as one graph, one -j pool\n"
+         "  --hash-deps = compare source/header contents instead of mtimes (checkouts, CI caches)\n");
+  printf("  -j auto = online CPUs, capped by available RAM / largest recorded job peak RSS\n"
+         "            (default: TACK_JOBS, else 1; under a make jobserver its tokens limit -j)\n");
+  printf("  --cache = reuse objects from the local object cache (or TACK_CACHE=1;\n"
+         "            TACK_CACHE_DIR, TACK_CACHE_SIZE=MiB, default ~/.cache/tack, 1024)\n");
+  printf("  TACK_REMOTE_CACHE=URL = shared HTTP cache behind it (curl GET/PUT; MODE=read|write,\n"
+         "            TIMEOUT=s, HEADER, JOBS); unreachable or slow -> compile locally\n");
+  printf("  --compdb = write build/compile_commands.json first (or [project] compdb = yes)\n");
+  printf("  --trace FILE = write every spawned job as Chrome trace JSON (Perfetto, chrome://tracing)\n");
+  printf("  --shard I/N = run part I of N of the tests (after --filter TEXT, a path substring):\n"
+         "            round-robin by path, or balanced by --shard-timings (earlier --json reports);\n"
+         "            compare the printed split checksum across nodes; --junit/--json FILE = results\n");
+  printf("  watch   = stay running, rebuild on changes (--run restarts the binary, --test reruns tests)\n");
+  printf("  bench   = time clean/no-op/header-touch builds and tests of a generated project\n"
+         "            (build/_bench; tack's own share vs. children; JSON to build/_bench/results.json)\n");
+  printf("  TACK_DIST_HOSTS=\"host[/slots] ...\" = compile on other hosts via ssh HOST tack worker\n"
+         "            (preprocessed locally; slots on top of -j; TACK_DIST_SSH, TACK_DIST_WORKER)\n");
+  printf("  why      = explain from the build db why an output would be rebuilt\n"
+         "  affected = list the objects, targets and tests a change to the files rebuilds\n");
 }
 
 static void cmd_version(void) { printf("tack %s\n", TACK_VERSION); }
@@ -2535,6 +8485,12 @@ static void cmd_doctor(void) {
   else printf("Auto tool discovery: enabled\n");
 #endif
 
+  if (getenv("TACK_DIST_HOSTS") && *getenv("TACK_DIST_HOSTS")) {
+    const char *cc = get_cc();
+    if (!dist_enabled(cc)) printf("Dist      : off (%s is tcc or has no --version)\n", cc);
+    else printf("Dist      : %d hosts, %d remote slots, compiler id %s\n", g_dist.nhosts, g_dist.slots, g_dist.cc_id);
+  }
+  printf("Core link : %s\n", g_config_core_archive ? "archive (build/_core/<profile>/libcore.a)" : "objects");
   printf("Overrides : built-ins + optional tackfile.c + optional tack.ini\n");
 }
 
@@ -2605,6 +8561,430 @@ static int cmd_clobber(void) {
   return 0;
 }
 
+/* --------------------------- bench --------------------------- */
+/* tack bench: generate a synthetic project under build/_bench/proj and time this tack
+ * binary on it, spawned as a child per run (TACK_STATS reports its share):
+ *   clean  build --all from nothing        noop   the same again
+ *   touch  after touching one header       test   tack test --no-test-cache
+ * The object/remote cache and distribution are off in the children. Results, every
+ * run plus medians, go to build/_bench/results.json (--out FILE).
+ */
+
+typedef struct {
+  int files, headers, fanin, core, tools, tests;
+} BenchShape;
+
+typedef struct {
+  long wall_ms, idle_ms, jobs, jobs_ms, self_cpu_ms, child_cpu_ms;
+} BenchRun;
+
+#define BENCH_SCENARIOS 4
+static const char * const bench_names[BENCH_SCENARIOS] = { "clean", "noop", "touch", "test" };
+
+static int bench_emit(const char *dir, const char *name, const char *text) {
+  char path[1024];
+  FILE *f;
+  path_join(path, sizeof(path), dir, name);
+  f = fopen(path, "wb");
+  if (!f) { fprintf(stderr, "tack: bench: cannot write %s\n", path); return 1; }
+  fputs(text, f);
+  return fclose(f) != 0;
+}
+
+/* deterministic: the same shape always yields the same sources */
+static int bench_generate(const char *root, const BenchShape *b) {
+  char d[1024], name[64], text[4096];
+  StrBuf sb;
+  int k, i, step = b->headers / b->fanin;
+
+  if (file_exists(root) && rm_rf(root) != 0) { fprintf(stderr, "tack: bench: cannot clear %s\n", root); return 1; }
+  ensure_dir(root);
+  path_join(d, sizeof(d), root, "include"); ensure_dir(d);
+  for (k = 0; k < b->headers; k++) {
+    sprintf(name, "bench_h%d.h", k);
+    sprintf(text, "#ifndef BENCH_H%d_H\n#define BENCH_H%d_H\n\ntypedef struct { int v[%d]; } bench_t%d;\nint bench_h%d(int x);\n\n#endif\n",
+            k, k, k + 1, k, k);
+    if (bench_emit(d, name, text)) return 1;
+  }
+
+  path_join(d, sizeof(d), root, "src"); ensure_dir(d);
+  if (bench_emit(d, "main.c", "int main(void) { return 0; }\n")) return 1;
+  path_join(d, sizeof(d), root, "src/app"); ensure_dir(d);
+  for (k = 0; k < b->files; k++) {
+    sb_init(&sb);
+    for (i = 0; i < b->fanin; i++) {
+      sprintf(text, "#include \"bench_h%d.h\"\n", (k + i * (step ? step : 1)) % b->headers);
+      sb_puts(&sb, text);
+    }
+    sprintf(text, "\nint bench_f%d(int x) {\n  int i, s = x;\n  for (i = 0; i < %d; i++) s = s * 31 + i;\n  return s;\n}\n", k, k % 17 + 1);
+    sb_puts(&sb, text);
+    sprintf(name, "f%d.c", k);
+    if (bench_emit(d, name, sb.p)) { sb_free(&sb); return 1; }
+    sb_free(&sb);
+  }
+
+  path_join(d, sizeof(d), root, "src/core"); ensure_dir(d);
+  for (k = 0; k < b->core; k++) {
+    sprintf(name, "c%d.c", k);
+    sprintf(text, "#include \"bench_h0.h\"\n\nint bench_c%d(int x) { return x + %d; }\n", k, k);
+    if (bench_emit(d, name, text)) return 1;
+  }
+
+  path_join(d, sizeof(d), root, "tools"); ensure_dir(d);
+  for (k = 0; k < b->tools; k++) {
+    char td[1024];
+    sprintf(name, "tool%d", k);
+    path_join(td, sizeof(td), d, name);
+    ensure_dir(td);
+    if (bench_emit(td, "main.c", "int main(void) { return 0; }\n")) return 1;
+  }
+
+  path_join(d, sizeof(d), root, "tests"); ensure_dir(d);
+  for (k = 0; k < b->tests; k++) {
+    sprintf(name, "t%d_test.c", k);
+    if (bench_emit(d, name, "int main(void) { return 0; }\n")) return 1;
+  }
+  return 0;
+}
+
+/* run self with args in the current dir (the bench project); 0 = ok */
+static int bench_run(const char *self, const char * const *args, BenchRun *r) {
+  char *argv[16];
+  FILE *f;
+  Proc p;
+  long t0;
+  int i, rc;
+
+  argv[0] = (char*)self;
+  for (i = 0; args[i] && i < 14; i++) argv[i + 1] = (char*)args[i];
+  argv[i + 1] = 0;
+  remove("bench.stats");
+  memset(r, 0, sizeof(*r));
+  t0 = now_ms();
+  if (proc_spawn_nowait(argv, "bench.log", &p) != 0) {
+    fprintf(stderr, "tack: bench: cannot run %s\n", self);
+    return 1;
+  }
+  rc = proc_wait(&p);
+  r->wall_ms = now_ms() - t0;
+  if (rc != 0) {
+    fprintf(stderr, "tack: bench: %s %s failed (exit %d):\n", self, args[0], rc);
+    print_log("bench.log");
+    return 1;
+  }
+  f = fopen("bench.stats", "r");
+  if (f) {
+    long wall;
+    if (fscanf(f, "wall_ms %ld idle_ms %ld jobs %ld jobs_ms %ld self_cpu_ms %ld child_cpu_ms %ld",
+               &wall, &r->idle_ms, &r->jobs, &r->jobs_ms, &r->self_cpu_ms, &r->child_cpu_ms) != 6) {
+      memset(r, 0, sizeof(*r));
+    }
+    fclose(f);
+  }
+  r->wall_ms = now_ms() - t0;
+  return 0;
+}
+
+/* mtimes have one-second resolution: let the clock pass the last build's writes */
+static void bench_next_second(void) {
+  time_t t = time(0);
+  while (time(0) == t) {
+#ifdef _WIN32
+    Sleep(50);
+#else
+    poll(0, 0, 50);
+#endif
+  }
+}
+
+static int bench_cmp_long(const void *a, const void *b) {
+  long x = *(const long*)a, y = *(const long*)b;
+  return x < y ? -1 : (x > y);
+}
+
+static long bench_median(const BenchRun *runs, int n, size_t off) {
+  long v[64];
+  int i;
+  for (i = 0; i < n; i++) v[i] = *(const long*)((const char*)&runs[i] + off);
+  qsort(v, (size_t)n, sizeof(long), bench_cmp_long);
+  return v[n / 2];
+}
+
+static void bench_json_run(FILE *f, const BenchRun *r) {
+  fprintf(f, "{\"wall_ms\": %ld, \"tack_ms\": %ld, \"jobs\": %ld, \"jobs_ms\": %ld, \"self_cpu_ms\": %ld, \"child_cpu_ms\": %ld}",
+          r->wall_ms, r->idle_ms, r->jobs, r->jobs_ms, r->self_cpu_ms, r->child_cpu_ms);
+}
+
+static int bench_write_json(const char *path, Profile p, int jobs, int reps, const BenchShape *b,
+                            BenchRun (*runs)[64]) {
+  FILE *f = fopen(path, "w");
+  StrBuf cc;
+  int s, r;
+
+  if (!f) { fprintf(stderr, "tack: bench: cannot write %s\n", path); return 1; }
+  sb_init(&cc);
+  sb_json_str(&cc, get_cc());
+  fprintf(f, "{\n  \"tack\": \"%s\",\n  \"cc\": %s,\n  \"profile\": \"%s\",\n  \"jobs\": %d,\n  \"reps\": %d,\n",
+          TACK_VERSION, cc.p, profile_name(p), jobs, reps);
+  fprintf(f, "  \"shape\": {\"files\": %d, \"headers\": %d, \"fanin\": %d, \"core\": %d, \"tools\": %d, \"tests\": %d},\n",
+          b->files, b->headers, b->fanin, b->core, b->tools, b->tests);
+  fputs("  \"scenarios\": {\n", f);
+  for (s = 0; s < BENCH_SCENARIOS; s++) {
+    BenchRun m;
+    memset(&m, 0, sizeof(m));
+    m.wall_ms = bench_median(runs[s], reps, offsetof(BenchRun, wall_ms));
+    m.idle_ms = bench_median(runs[s], reps, offsetof(BenchRun, idle_ms));
+    m.jobs = bench_median(runs[s], reps, offsetof(BenchRun, jobs));
+    m.jobs_ms = bench_median(runs[s], reps, offsetof(BenchRun, jobs_ms));
+    m.self_cpu_ms = bench_median(runs[s], reps, offsetof(BenchRun, self_cpu_ms));
+    m.child_cpu_ms = bench_median(runs[s], reps, offsetof(BenchRun, child_cpu_ms));
+    fprintf(f, "    \"%s\": {\n      \"median\": ", bench_names[s]);
+    bench_json_run(f, &m);
+    fputs(",\n      \"runs\": [", f);
+    for (r = 0; r < reps; r++) {
+      fputs(r ? ",\n        " : "\n        ", f);
+      bench_json_run(f, &runs[s][r]);
+    }
+    fprintf(f, "\n      ]\n    }%s\n", s + 1 < BENCH_SCENARIOS ? "," : "");
+  }
+  fputs("  }\n}\n", f);
+  sb_free(&cc);
+  return fclose(f) != 0;
+}
+
+static int bench_opt(int *argi, int argc, char **argv, const char *name, int *out, int min) {
+  int v;
+  if (!streq(argv[*argi], name)) return 0;
+  if (*argi + 1 >= argc || (v = parse_int(argv[*argi + 1])) < min) {
+    fprintf(stderr, "tack: bench: %s needs a number >= %d\n", name, min);
+    return -1;
+  }
+  *out = v;
+  (*argi)++;
+  return 1;
+}
+
+static int cmd_bench(const char *self0, int argi, int argc, char **argv) {
+  static char env_stats[] = "TACK_STATS=bench.stats";
+  static char env_cache[] = "TACK_CACHE=0";
+  static char env_remote[] = "TACK_REMOTE_CACHE=";
+  static char env_dist[] = "TACK_DIST_HOSTS=";
+  static BenchRun runs[BENCH_SCENARIOS][64];
+  BenchShape b;
+  Profile p = parse_profile(&argi, argc, argv);
+  int reps = 3, jobs = 0, r, s;
+  const char *out = 0, *prof = profile_name(p);
+  char self[1024], root[1024], proj[1024], out_path[1024], cwd[1024], header[64], jobs_s[16];
+  const char *build_args[6], *test_args[6], *clean_args[2];
+
+  b.files = 200; b.headers = 50; b.fanin = 10; b.core = 20; b.tools = 4; b.tests = 10;
+  for (; argi < argc; argi++) {
+    int rc = 0;
+    if ((rc = bench_opt(&argi, argc, argv, "--files", &b.files, 1)) ||
+        (rc = bench_opt(&argi, argc, argv, "--headers", &b.headers, 1)) ||
+        (rc = bench_opt(&argi, argc, argv, "--fanin", &b.fanin, 1)) ||
+        (rc = bench_opt(&argi, argc, argv, "--core", &b.core, 0)) ||
+        (rc = bench_opt(&argi, argc, argv, "--tools", &b.tools, 0)) ||
+        (rc = bench_opt(&argi, argc, argv, "--tests", &b.tests, 0)) ||
+        (rc = bench_opt(&argi, argc, argv, "--reps", &reps, 1))) {
+      if (rc < 0) return 2;
+      continue;
+    }
+    if ((streq(argv[argi], "-j") || streq(argv[argi], "--jobs")) && argi + 1 < argc) {
+      jobs = parse_jobs(argv[++argi]);
+      if (jobs < 1) { fprintf(stderr, "tack: invalid -j %s\n", argv[argi]); return 2; }
+    } else if (streq(argv[argi], "--out") && argi + 1 < argc) {
+      out = argv[++argi];
+    } else {
+      fprintf(stderr, "tack: bench: unknown arg: %s\n", argv[argi]);
+      return 2;
+    }
+  }
+  if (reps > 64) reps = 64;
+  if (b.fanin > b.headers) b.fanin = b.headers;
+  if (jobs < 1) jobs = cpu_count();
+  sprintf(jobs_s, "%d", jobs);
+
+#ifdef _WIN32
+  if (!_getcwd(cwd, (int)sizeof(cwd))) return 1;
+#else
+  if (!getcwd(cwd, sizeof(cwd))) return 1;
+#endif
+  /* children run inside the bench project: a relative path to this binary must not break */
+  if ((strchr(self0, '/') || strchr(self0, '\\')) && self0[0] != '/' && self0[0] != '\\' &&
+      !(isalpha((unsigned char)self0[0]) && self0[1] == ':')) path_join(self, sizeof(self), cwd, self0);
+  else tack_copy(self, sizeof(self), self0);
+
+  ensure_dir(g_build_dir);
+  path_join(root, sizeof(root), g_build_dir, "_bench");
+  ensure_dir(root);
+  path_join(proj, sizeof(proj), root, "proj");
+  if (out) tack_copy(out_path, sizeof(out_path), out);
+  else path_join(out_path, sizeof(out_path), root, "results.json");
+
+  printf("bench: %d files, %d headers (fan-in %d), %d core, %d tools, %d tests; %s -j %d, %d reps\n",
+         b.files, b.headers, b.fanin, b.core, b.tools, b.tests, prof, jobs, reps);
+  if (bench_generate(proj, &b) != 0) return 1;
+
+  putenv(env_stats);
+  putenv(env_cache);
+  putenv(env_remote);
+  putenv(env_dist);
+
+  clean_args[0] = "clean"; clean_args[1] = 0;
+  build_args[0] = "build"; build_args[1] = prof; build_args[2] = "--all";
+  build_args[3] = "-j"; build_args[4] = jobs_s; build_args[5] = 0;
+  test_args[0] = "test"; test_args[1] = prof; test_args[2] = "--no-test-cache";
+  test_args[3] = "-j"; test_args[4] = jobs_s; test_args[5] = 0;
+  sprintf(header, "include%cbench_h%d.h", PATH_SEP, b.headers > 1 ? 1 : 0);
+
+#ifdef _WIN32
+  if (_chdir(proj) != 0) { fprintf(stderr, "tack: bench: cannot enter %s\n", proj); return 1; }
+#else
+  if (chdir(proj) != 0) { fprintf(stderr, "tack: bench: cannot enter %s\n", proj); return 1; }
+#endif
+  for (r = 0; r < reps; r++) {
+    BenchRun junk;
+    int bad = bench_run(self, clean_args, &junk);
+    if (!bad) bad = bench_run(self, build_args, &runs[0][r]);
+    if (!bad) { bench_next_second(); bad = bench_run(self, build_args, &runs[1][r]); }
+    if (!bad) { cache_touch(header); bad = bench_run(self, build_args, &runs[2][r]); }
+    if (!bad) bad = bench_run(self, test_args, &runs[3][r]);
+    if (bad) {
+#ifdef _WIN32
+      _chdir(cwd);
+#else
+      if (chdir(cwd) != 0) { /* reported below */ }
+#endif
+      return 1;
+    }
+    printf("bench: rep %d/%d:", r + 1, reps);
+    for (s = 0; s < BENCH_SCENARIOS; s++) printf(" %s %ld ms (tack %ld)", bench_names[s], runs[s][r].wall_ms, runs[s][r].idle_ms);
+    printf("\n");
+  }
+#ifdef _WIN32
+  if (_chdir(cwd) != 0) return 1;
+#else
+  if (chdir(cwd) != 0) return 1;
+#endif
+
+  printf("\n%-6s  %9s  %9s  %6s  %9s\n", "", "wall ms", "tack ms", "jobs", "jobs ms");
+  for (s = 0; s < BENCH_SCENARIOS; s++) {
+    printf("%-6s  %9ld  %9ld  %6ld  %9ld\n", bench_names[s],
+           bench_median(runs[s], reps, offsetof(BenchRun, wall_ms)),
+           bench_median(runs[s], reps, offsetof(BenchRun, idle_ms)),
+           bench_median(runs[s], reps, offsetof(BenchRun, jobs)),
+           bench_median(runs[s], reps, offsetof(BenchRun, jobs_ms)));
+  }
+  if (bench_write_json(out_path, p, jobs, reps, &b, runs) != 0) return 1;
+  printf("bench: results in %s\n", out_path);
+  return 0;
+}
+
+/* tack worker ID CC ARGS...: the remote end of a distributed compile (see dist_enabled).
+ * Preprocessed source on stdin, the object on stdout, diagnostics on stderr; exit
+ * code = the compiler's, 201 = different compiler (ID), 202 = local i/o failure.
+ * Scratch files live in a private mkdtemp dir (dir), removed by cmd_worker. */
+static int worker_compile(const char *dir, int argc, char **argv) {
+  char id[17], ipath[1100], opath[1100], vpath[1100], buf[16384];
+  FILE *in, *f;
+  Argv av;
+  Proc p;
+  size_t n;
+  int i, rc;
+
+  path_join(ipath, sizeof(ipath), dir, "tu.i");
+  path_join(opath, sizeof(opath), dir, "tu.o");
+  path_join(vpath, sizeof(vpath), dir, "cc.ver");
+
+  if (cc_version_id(argv[1], vpath, id) != 0 || !streq(id, argv[0])) {
+    fprintf(stderr, "tack worker: compiler %s differs from the client's\n", argv[1]);
+    return 201;
+  }
+
+  in = fopen(ipath, "wb");
+  if (!in) { fprintf(stderr, "tack worker: cannot write %s\n", ipath); return 202; }
+  while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+    if (fwrite(buf, 1, n, in) != n) { fclose(in); return 202; }
+  }
+  if (fclose(in) != 0) return 202;
+
+  av_init(&av);
+  for (i = 1; i < argc; i++) av_push(&av, argv[i]);
+  av_push(&av, "-o");
+  av_push(&av, opath);
+  av_push(&av, ipath);
+  av_terminate(&av);
+  /* stdout is the object channel: the compiler's own stdout (normally empty) is dropped */
+#ifdef _WIN32
+  rc = proc_spawn_io(av.a, 0, "NUL", 0, &p);
+#else
+  rc = proc_spawn_io(av.a, 0, "/dev/null", 0, &p);
+#endif
+  av_free(&av);
+  if (rc != 0) { fprintf(stderr, "tack worker: cannot run %s\n", argv[1]); return 202; }
+  rc = proc_wait(&p);
+  if (rc >= 200) rc = 1; /* keep >= 200 for "not compiled here" */
+
+  if (rc == 0) {
+    f = fopen(opath, "rb");
+    if (!f) return 202;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      if (fwrite(buf, 1, n, stdout) != n) { rc = 202; break; }
+    }
+    fclose(f);
+    if (fflush(stdout) != 0) rc = 202;
+  }
+  return rc;
+}
+
+static int cmd_worker(int argc, char **argv) {
+  char dir[1024];
+  int rc;
+
+  if (argc < 2) { fprintf(stderr, "tack worker: needs ID CC [args...]\n"); return 202; }
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  if (tmp_private_dir(dir, sizeof(dir), "worker") != 0) {
+    fprintf(stderr, "tack worker: cannot create a temp dir\n");
+    return 202;
+  }
+  rc = worker_compile(dir, argc, argv);
+  if (rm_rf(dir) != 0) fprintf(stderr, "tack worker: warning: cannot remove %s\n", dir);
+  return rc;
+}
+
+static int cmd_cache(const char *sub) {
+  long hits, misses, size;
+
+  g_cache_cli = 1;
+  if (!cache_enabled()) return 1;
+
+  if (sub && streq(sub, "clear")) {
+    if (file_exists(g_cache.dir) && rm_rf_contents(g_cache.dir) != 0) {
+      fprintf(stderr, "tack: cache clear: failed\n");
+      return 1;
+    }
+    printf("tack: cache clear: done\n");
+    return 0;
+  }
+  if (sub && !streq(sub, "stats")) {
+    fprintf(stderr, "tack: cache: unknown arg: %s\n", sub);
+    return 2;
+  }
+
+  cache_read_stats(&hits, &misses, &size);
+  printf("Cache dir : %s\n", g_cache.dir);
+  printf("Size      : %ld KiB (cap %ld MiB)\n", size / 1024L, cache_cap_bytes() / (1024L * 1024L));
+  printf("Hits      : %ld\n", hits);
+  printf("Misses    : %ld\n", misses);
+  if (hits + misses > 0) printf("Hit rate  : %ld%%\n", hits * 100 / (hits + misses));
+  if (remote_enabled()) printf("Remote    : %s (%s)\n", g_remote.url, g_remote.write ? "write" : "read");
+  return 0;
+}
+
 static int cmd_list_targets(TargetVec *tv) {
   int i;
   printf("Targets:\n");
@@ -2623,8 +9003,10 @@ static int cmd_list_targets(TargetVec *tv) {
 
 static Profile parse_profile(int *argi, int argc, char **argv) {
   if (*argi < argc) {
-    if (streq(argv[*argi], "release")) { (*argi)++; return PROF_RELEASE; }
-    if (streq(argv[*argi], "debug"))   { (*argi)++; return PROF_DEBUG; }
+    if (streq(argv[*argi], "release"))     { (*argi)++; return PROF_RELEASE; }
+    if (streq(argv[*argi], "release-lto")) { (*argi)++; return PROF_RELEASE_LTO; }
+    if (streq(argv[*argi], "release-pgo")) { (*argi)++; return PROF_RELEASE_PGO; }
+    if (streq(argv[*argi], "debug"))       { (*argi)++; return PROF_DEBUG; }
   }
   return PROF_DEBUG;
 }
@@ -2643,11 +9025,99 @@ static int parse_int(const char *s) {
   return v;
 }
 
+/* available RAM in KiB, 0 = unknown */
+static long mem_avail_kb(void) {
+#ifdef _WIN32
+  MEMORYSTATUSEX ms;
+  ms.dwLength = sizeof(ms);
+  if (!GlobalMemoryStatusEx(&ms)) return 0;
+  return (long)(ms.ullAvailPhys / 1024 > (DWORDLONG)LONG_MAX ? LONG_MAX : ms.ullAvailPhys / 1024);
+#else
+  FILE *f = fopen("/proc/meminfo", "r");
+  char line[256];
+  long kb = 0;
+  if (f) {
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1) break;
+      kb = 0;
+    }
+    fclose(f);
+  }
+#ifdef _SC_AVPHYS_PAGES
+  if (kb <= 0) {
+    long pages = sysconf(_SC_AVPHYS_PAGES), psz = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && psz > 0) kb = (long)((double)pages * (double)psz / 1024.0);
+  }
+#endif
+  return kb > 0 ? kb : 0;
+#endif
+}
+
+static int cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* -j auto: online CPUs, capped so the largest recorded job (peak RSS from the build
+ * DB) fits into available RAM that many times. No history -> CPUs only. */
+static int jobs_auto(void) {
+  int jobs = cpu_count(), i;
+  long peak = 0, avail;
+  db_load();
+  for (i = 0; i < g_db.nrecs; i++) {
+    if (g_db.recs[i].peak_kb > peak) peak = g_db.recs[i].peak_kb;
+  }
+  avail = peak > 0 ? mem_avail_kb() : 0;
+  if (avail > 0 && avail / peak < (long)jobs) jobs = (int)(avail / peak);
+  return jobs < 1 ? 1 : jobs;
+}
+
+/* N or auto; -1 = invalid */
+static int parse_jobs(const char *s) {
+  int v;
+  if (s && streq(s, "auto")) return jobs_auto();
+  v = parse_int(s);
+  return v < 1 ? -1 : v;
+}
+
+/* default when no -j is given: TACK_JOBS, else all CPUs under an outer jobserver (its
+ * tokens are the limit), else 1 */
+static int default_jobs(void) {
+  const char *e = getenv("TACK_JOBS");
+  if (e && *e) {
+    int v = parse_jobs(e);
+    if (v > 0) return v;
+    fprintf(stderr, "tack: warning: ignoring TACK_JOBS=%s\n", e);
+  }
+  return g_js.active ? cpu_count() : 1;
+}
+
+/* -j of a build/run/test/watch command line (or a bare tack), read before the project
+ * loads so the jobserver already serves the tackfile.c generator; the option parser
+ * proper rejects a bad -j later */
+static int cli_jobs(int argi, int argc, char **argv) {
+  int jobs = 0;
+  if (argi < argc) {
+    const char *cmd = argv[argi];
+    if (!streq(cmd, "build") && !streq(cmd, "run") && !streq(cmd, "test") && !streq(cmd, "watch")) return 0;
+    for (argi++; argi < argc; argi++) {
+      if (streq(argv[argi], "--")) break;
+      if ((streq(argv[argi], "-j") || streq(argv[argi], "--jobs")) && argi + 1 < argc) jobs = parse_jobs(argv[++argi]);
+    }
+  }
+  return jobs > 0 ? jobs : default_jobs();
+}
+
 int main(int argc, char **argv) {
   TargetVec tv;
   const char *cmd;
   int argi;
-  int disable_auto_tools;
 
   /* parse global options (must precede command) */
   argi = 1;
@@ -2664,36 +9134,33 @@ int main(int argc, char **argv) {
     break;
   }
 
-  /* load config (tack.ini) unless disabled */
-  if (config_auto_load() != 0) {
-    fprintf(stderr, "tack: config: failed to load\n");
-    config_free();
-    return 2;
-  }
-
-  disable_auto_tools = 0;
-#ifdef TACKFILE_DISABLE_AUTO_TOOLS
-  disable_auto_tools = 1;
-#else
-  if (g_no_auto_tools_cli) disable_auto_tools = 1;
-  else if (g_config_loaded && g_config_disable_auto_tools) disable_auto_tools = 1;
-#endif
+  stats_init();
 
-  tv_init(&tv);
-  discover_targets(&tv, disable_auto_tools);
+  /* remote end of a distributed compile: no project here */
+  if (argi < argc && streq(argv[argi], "worker")) return cmd_worker(argc - argi - 1, argv + argi + 1);
 
-  /* tackfile.c may add/modify/remove/disable targets (compile-time) */
-  apply_tackfile_targets(&tv);
+  /* an outer make/tack jobserver limits everything we spawn, the generator included;
+   * otherwise -j N > 1 serves one for everything below us, the generator included */
+  js_client_init();
+  if (!g_js.active) {
+    int jobs = cli_jobs(argi, argc, argv);
+    if (jobs > 1) js_serve(jobs);
+  }
 
-  /* tack.ini may add/modify/remove/disable targets (runtime) */
-  apply_ini_targets(&tv);
+  /* load config (tack.ini) unless disabled, then the target graph */
+  if (load_project(&tv) != 0) {
+    config_free();
+    return 2;
+  }
+  g_pgo.tv = &tv;
 
   /* no command -> default build debug default target */
   if (argi >= argc) {
     const Target *t = find_target(&tv, default_target_name());
-    int rc;
+    int rc, jobs;
     if (!t) { fprintf(stderr, "tack: default target missing\n"); tv_free(&tv); config_free(); return 2; }
-    rc = build_one_target(t, PROF_DEBUG, 0, 0, 1, 0, 0);
+    jobs = default_jobs();
+    rc = build_one_target(t, PROF_DEBUG, 0, 0, jobs, 0, 0, 0);
     tv_free(&tv);
     config_free();
     return rc;
@@ -2707,6 +9174,8 @@ int main(int argc, char **argv) {
   if (streq(cmd, "init"))    { int rc = cmd_init(); tv_free(&tv); config_free(); return rc; }
   if (streq(cmd, "clean"))   { int rc = cmd_clean(); tv_free(&tv); config_free(); return rc; }
   if (streq(cmd, "clobber")) { int rc = cmd_clobber(); tv_free(&tv); config_free(); return rc; }
+  if (streq(cmd, "bench"))   { int rc = cmd_bench(argv[0], argi, argc, argv); tv_free(&tv); config_free(); return rc; }
+  if (streq(cmd, "cache"))   { int rc = cmd_cache(argi < argc ? argv[argi] : 0); tv_free(&tv); config_free(); return rc; }
   if (streq(cmd, "list"))    {
     if (g_no_config) printf("config: disabled (legacy mode)\n");
     else if (g_config_loaded) printf("config: %s\n", g_config_path);
@@ -2714,51 +9183,204 @@ int main(int argc, char **argv) {
     { int rc = cmd_list_targets(&tv); tv_free(&tv); config_free(); return rc; }
   }
 
-  if (streq(cmd, "build") || streq(cmd, "run") || streq(cmd, "test")) {
+  if (streq(cmd, "why") || streq(cmd, "affected")) {
+    Profile p = parse_profile(&argi, argc, argv);
+    int strict = 0, rc;
+    char **files;
+    int nfiles = 0;
+
+    files = (char**)xmalloc((size_t)(argc - argi + 1) * sizeof(char*));
+    for (; argi < argc; argi++) {
+      if (streq(argv[argi], "--strict")) strict = 1;
+      else if (streq(argv[argi], "--hash-deps")) g_hash_deps = 1;
+      else if (argv[argi][0] == '-' && argv[argi][1]) {
+        fprintf(stderr, "tack: %s: unknown arg: %s\n", cmd, argv[argi]);
+        free(files); tv_free(&tv); config_free();
+        return 2;
+      } else files[nfiles++] = argv[argi];
+    }
+    if (!nfiles) {
+      fprintf(stderr, "tack: %s: needs at least one %s\n", cmd, streq(cmd, "why") ? "output or source" : "file");
+      free(files); tv_free(&tv); config_free();
+      return 2;
+    }
+    rc = streq(cmd, "why") ? cmd_why(&tv, p, strict, files, nfiles) : cmd_affected(&tv, p, strict, files, nfiles);
+    free(files);
+    tv_free(&tv);
+    config_free();
+    return rc;
+  }
+
+  if (streq(cmd, "build") || streq(cmd, "run") || streq(cmd, "test") || streq(cmd, "watch")) {
     int verbose = 0;
     int force = 0;
-    int jobs = 1;
+    int jobs = 0;
     int strict = 0;
     int no_core = 0;
+    int keep_going = 0;
+    int all_targets = 0;
+    int test_cache = 1;
+    int compdb = g_config_compdb;
+    int watch_mode = WATCH_BUILD;
+    TestSel sel;
+    StrVec target_names;
 
     Profile p = parse_profile(&argi, argc, argv);
 
     const char *target_name = default_target_name();
     const Target *t = 0;
 
+    sv_init(&target_names);
+    memset(&sel, 0, sizeof(sel));
+
     /* parse options; for run, args may follow '--' */
     for (; argi < argc; argi++) {
       if (streq(argv[argi], "--")) break;
       if (streq(argv[argi], "-v") || streq(argv[argi], "--verbose")) verbose = 1;
       else if (streq(argv[argi], "--rebuild")) force = 1;
+      else if (streq(argv[argi], "--hash-deps")) g_hash_deps = 1;
+      else if (streq(argv[argi], "--cache")) g_cache_cli = 1;
+      else if (streq(argv[argi], "--no-test-cache")) test_cache = 0;
+      else if (streq(argv[argi], "--direct")) g_direct_cli = 1;
+      else if (streq(argv[argi], "--compdb")) compdb = 1;
+      else if (streq(argv[argi], "--trace")) {
+        if (argi + 1 >= argc) { fprintf(stderr, "tack: --trace needs FILE\n"); sv_free(&target_names); tv_free(&tv); config_free(); return 2; }
+        g_trace_path = argv[++argi];
+      }
       else if (streq(argv[argi], "--strict")) strict = 1;
       else if (streq(argv[argi], "--no-core")) no_core = 1;
+      else if (streq(argv[argi], "-k") || streq(argv[argi], "--keep-going")) keep_going = 1;
+      else if (streq(argv[argi], "--all")) all_targets = 1;
+      else if (streq(cmd, "watch") && streq(argv[argi], "--run")) watch_mode = WATCH_RUN;
+      else if (streq(cmd, "watch") && streq(argv[argi], "--test")) watch_mode = WATCH_TEST;
+      else if (streq(cmd, "test") && (streq(argv[argi], "--shard") || streq(argv[argi], "--filter") ||
+                                      streq(argv[argi], "--shard-timings") ||
+                                      streq(argv[argi], "--junit") || streq(argv[argi], "--json"))) {
+        const char *opt = argv[argi];
+        if (argi + 1 >= argc) { fprintf(stderr, "tack: %s needs a value\n", opt); sv_free(&target_names); tv_free(&tv); config_free(); return 2; }
+        argi++;
+        if (streq(opt, "--filter")) sel.filter = argv[argi];
+        else if (streq(opt, "--junit")) sel.junit = argv[argi];
+        else if (streq(opt, "--json")) sel.json = argv[argi];
+        else if (streq(opt, "--shard-timings")) {
+          if (sel.ntimings == TACK_MAX_TIMINGS) {
+            fprintf(stderr, "tack: at most %d --shard-timings files\n", TACK_MAX_TIMINGS);
+            sv_free(&target_names); tv_free(&tv); config_free();
+            return 2;
+          }
+          sel.timings[sel.ntimings++] = argv[argi];
+        }
+        else if (!parse_shard(argv[argi], &sel.shard, &sel.shards)) {
+          fprintf(stderr, "tack: invalid --shard %s (expected I/N, 1 <= I <= N)\n", argv[argi]);
+          sv_free(&target_names); tv_free(&tv); config_free();
+          return 2;
+        }
+      }
       else if (streq(argv[argi], "--target")) {
-        if (argi + 1 >= argc) { fprintf(stderr, "tack: --target needs NAME\n"); tv_free(&tv); config_free(); return 2; }
+        if (argi + 1 >= argc) { fprintf(stderr, "tack: --target needs NAME\n"); sv_free(&target_names); tv_free(&tv); config_free(); return 2; }
         target_name = argv[++argi];
+        sv_push(&target_names, target_name);
       } else if (streq(argv[argi], "-j") || streq(argv[argi], "--jobs")) {
         int v;
-        if (argi + 1 >= argc) { fprintf(stderr, "tack: -j needs N\n"); tv_free(&tv); config_free(); return 2; }
-        v = parse_int(argv[++argi]);
-        if (v < 1) { fprintf(stderr, "tack: invalid -j %s\n", argv[argi]); tv_free(&tv); config_free(); return 2; }
+        if (argi + 1 >= argc) { fprintf(stderr, "tack: -j needs N or auto\n"); sv_free(&target_names); tv_free(&tv); config_free(); return 2; }
+        v = parse_jobs(argv[++argi]);
+        if (v < 1) { fprintf(stderr, "tack: invalid -j %s\n", argv[argi]); sv_free(&target_names); tv_free(&tv); config_free(); return 2; }
         jobs = v;
       } else {
         /* run: allow args without -- (best effort) */
-        if (streq(cmd, "run")) break;
+        if (streq(cmd, "run") || (streq(cmd, "watch") && watch_mode == WATCH_RUN)) break;
         fprintf(stderr, "tack: %s: unknown arg: %s\n", cmd, argv[argi]);
+        sv_free(&target_names);
         tv_free(&tv);
         config_free();
         return 2;
       }
     }
 
+    if (g_trace_path) atexit(trace_flush);
+    else { g_trace_on = 0; trace_reset(); }
+
+    if (jobs < 1) jobs = default_jobs();
+
+    if (compdb && compdb_write(&tv, p, strict) != 0) {
+      sv_free(&target_names);
+      tv_free(&tv);
+      config_free();
+      return 1;
+    }
+
+    if (streq(cmd, "watch")) {
+      WatchOpts wo;
+      if (all_targets || target_names.count > 1) {
+        fprintf(stderr, "tack: watch: needs exactly one target (no --all)\n");
+        sv_free(&target_names); tv_free(&tv); config_free();
+        return 2;
+      }
+      if (argi < argc && streq(argv[argi], "--")) argi++;
+      wo.p = p;
+      wo.verbose = verbose;
+      wo.jobs = jobs;
+      wo.strict = strict;
+      wo.keep_going = keep_going;
+      wo.no_core = no_core;
+      wo.test_cache = test_cache;
+      wo.mode = watch_mode;
+      wo.target = target_name;
+      wo.run_args = argv + argi;
+      wo.run_argc = argc - argi;
+      sv_free(&target_names);
+      watch_loop(&tv, &wo);
+      tv_free(&tv);
+      config_free();
+      return 0;
+    }
+
     if (streq(cmd, "test")) {
-      int rc = build_and_run_tests(p, verbose, force, strict);
+      int rc = build_and_run_tests(p, verbose, force, jobs, strict, keep_going, test_cache && !force, &sel);
+      sv_free(&target_names);
+      tv_free(&tv);
+      config_free();
+      return rc;
+    }
+
+    /* build: --all or several --target -> one DAG with a shared job pool */
+    if (streq(cmd, "build") && (all_targets || target_names.count > 1)) {
+      const Target **ts;
+      int n = 0, k, rc;
+
+      ts = (const Target**)xmalloc((size_t)(tv.count + target_names.count + 1) * sizeof(Target*));
+      if (all_targets) {
+        for (k = 0; k < tv.count; k++) if (tv.items[k].enabled) ts[n++] = &tv.items[k];
+      } else {
+        for (k = 0; k < target_names.count; k++) {
+          const Target *tk = find_target(&tv, target_names.items[k]);
+          int m, dup = 0;
+          if (!tk) {
+            fprintf(stderr, "tack: unknown or disabled target: %s\n", target_names.items[k]);
+            fprintf(stderr, "tack: hint: use 'tack list'\n");
+            free((void*)ts); sv_free(&target_names); tv_free(&tv); config_free();
+            return 2;
+          }
+          for (m = 0; m < n; m++) if (ts[m] == tk) dup = 1;
+          if (!dup) ts[n++] = tk;
+        }
+      }
+
+      rc = build_targets(ts, n, p, verbose, force, jobs, strict, keep_going, no_core);
+      free((void*)ts);
+      sv_free(&target_names);
       tv_free(&tv);
       config_free();
       return rc;
     }
 
+    if (all_targets || target_names.count > 1) {
+      fprintf(stderr, "tack: %s: needs exactly one target (no --all)\n", cmd);
+      sv_free(&target_names); tv_free(&tv); config_free();
+      return 2;
+    }
+    sv_free(&target_names);
+
     t = find_target(&tv, target_name);
     if (!t) {
       fprintf(stderr, "tack: unknown or disabled target: %s\n", target_name);
@@ -2769,7 +9391,7 @@ int main(int argc, char **argv) {
     }
 
     if (streq(cmd, "build")) {
-      int rc = build_one_target(t, p, verbose, force, jobs, strict, no_core);
+      int rc = build_one_target(t, p, verbose, force, jobs, strict, keep_going, no_core);
       tv_free(&tv);
       config_free();
       return rc;
@@ -2782,7 +9404,7 @@ int main(int argc, char **argv) {
 
       if (run_argi < argc && streq(argv[run_argi], "--")) run_argi++;
 
-      if (build_one_target(t, p, verbose, force, jobs, strict, no_core) != 0) { tv_free(&tv); config_free(); return 1; }
+      if (build_one_target(t, p, verbose, force, jobs, strict, keep_going, no_core) != 0) { tv_free(&tv); config_free(); return 1; }
       exe_path(exe, sizeof(exe), t->id, p, t->bin_base);
 
       /* build argv: exe + rest args */
@@ -2796,7 +9418,7 @@ int main(int argc, char **argv) {
         for (k = run_argi; k < argc; k++) av_push(&av, argv[k]);
         av_terminate(&av);
 
-        rc = run_argv_wait(av.a, verbose);
+        rc = run_argv_wait(av.a, verbose, 0);
         av_free(&av);
         tv_free(&tv);
         config_free();